@@ -98,6 +98,15 @@ class PJON {
     #if(PJON_INCLUDE_ASYNC_ACK)
       PJON_Packet_Record recent_packet_ids[PJON_MAX_RECENT_PACKET_IDS];
     #endif
+    #if(PJON_INCLUDE_ASYNC_ACK_RTT)
+      PJON_RTT_Estimate rtt_estimates[PJON_RTT_RECIPIENTS];
+    #endif
+    #if(PJON_INCLUDE_STATS)
+      PJON_Stats stats;
+    #endif
+    #if(PJON_INCLUDE_ADAPTIVE_BACK_OFF)
+      uint16_t contention_window = PJON_CONTENTION_UNIT;
+    #endif
 
     uint8_t random_seed = A0;
 
@@ -157,6 +166,7 @@ class PJON {
       uint16_t header = PJON_NOT_ASSIGNED,
       uint16_t p_id = 0
     ) {
+      PJON_TRACE_START(trace_start);
       if(header == PJON_NOT_ASSIGNED) header = config;
       if(header > 255) header |= PJON_EXT_HEAD_BIT;
       if(length > 255) header |= PJON_EXT_LEN_BIT;
@@ -184,6 +194,7 @@ class PJON {
 
       if(new_length >= PJON_PACKET_MAX_LENGTH) {
         _error(PJON_CONTENT_TOO_LONG, new_length);
+        PJON_TRACE(this, PJON_TRACE_COMPOSE, trace_start, PJON_MICROS(), 0);
         return 0;
       }
 
@@ -248,6 +259,9 @@ class PJON {
         destination[new_length - 1] = (uint32_t)(computed_crc);
       } else destination[new_length - 1] =
         PJON_crc8::compute((uint8_t *)destination, new_length - 1);
+      PJON_TRACE(
+        this, PJON_TRACE_COMPOSE, trace_start, PJON_MICROS(), new_length
+      );
       return new_length;
     };
 
@@ -281,9 +295,19 @@ class PJON {
           packets[i].state = PJON_TO_BE_SENT;
           packets[i].registration = PJON_MICROS();
           packets[i].timing = timing;
+          #if(PJON_INCLUDE_PACKET_TIME)
+            packets[i].dispatch_time = packets[i].registration;
+          #endif
+          #if(PJON_INCLUDE_STATS)
+            uint16_t count = get_packets_count();
+            if(count > stats.queue_high_water) stats.queue_high_water = count;
+          #endif
           return i;
         }
 
+      #if(PJON_INCLUDE_STATS)
+        stats.buffer_full++;
+      #endif
       _error(PJON_PACKETS_BUFFER_FULL, PJON_MAX_PACKETS);
       return PJON_FAIL;
     };
@@ -368,6 +392,9 @@ class PJON {
       bool extended_length = packet[1] & PJON_EXT_LEN_BIT;
       packet_info.header =
         (extended_header) ? packet[2] << 8 | packet[1] : packet[1];
+      packet_info.length = (extended_length) ?
+        packet[2 + extended_header] << 8 | packet[3 + extended_header] :
+        packet[2 + extended_header];
       uint8_t offset = extended_header + extended_length + 1;
       if((packet_info.header & PJON_MODE_BIT) != 0) {
         copy_bus_id(packet_info.receiver_bus_id, packet + 3 + offset);
@@ -391,132 +418,13 @@ class PJON {
     };
 
 
-    uint16_t receive() {
-      uint16_t length = PJON_PACKET_MAX_LENGTH;
-      uint16_t batch_length = 0;
-      uint8_t  overhead = 0;
-      bool computed_crc = 0;
-      bool extended_header = false;
-      bool extended_length = false;
-      bool async_ack = false;
-      for(uint16_t i = 0; i < length; i++) {
-        if(!batch_length) {
-          batch_length = strategy.receive_string(data + i, length - i);
-          if(batch_length == PJON_FAIL || batch_length == 0)
-            return PJON_FAIL;
-        }
-        batch_length--;
-
-        if(i == 0)
-          if(data[i] != _device_id && data[i] != PJON_BROADCAST && !_router)
-            return PJON_BUSY;
-
-        if(i == 1) {
-          if(
-            (
-              !_router &&
-              ((data[1] & PJON_MODE_BIT) != (config & PJON_MODE_BIT))
-            ) || (
-              data[0] == PJON_BROADCAST &&
-              ((data[1] & PJON_ACK_MODE_BIT) || (data[1] & PJON_ACK_REQ_BIT))
-            ) || (
-              (data[1] & PJON_ACK_MODE_BIT) && !(data[1] & PJON_TX_INFO_BIT)
-            ) || (
-              (data[1] & PJON_EXT_LEN_BIT) && !(data[1] & PJON_CRC_BIT)
-            ) || (
-              !PJON_INCLUDE_ASYNC_ACK && (data[1] & PJON_ACK_MODE_BIT)
-            ) || (
-              ((data[1] & PJON_ADDRESS_BIT) && !(data[1] & PJON_CRC_BIT)) ||
-              ((data[1] & PJON_ADDRESS_BIT) && !(data[1] & PJON_TX_INFO_BIT))
-            )
-          ) return PJON_BUSY;
-          extended_length = data[i] & PJON_EXT_LEN_BIT;
-          extended_header = data[i] & PJON_EXT_HEAD_BIT;
-          overhead = packet_overhead(data[i]);
-          async_ack = (
-            PJON_INCLUDE_ASYNC_ACK &&
-            (data[1] & PJON_ACK_MODE_BIT) &&
-            (data[1] & PJON_TX_INFO_BIT)
-          );
-        }
-
-        if((i == (2 + extended_header)) && !extended_length) {
-          length = data[i];
-          if(
-            length < (overhead + !async_ack) ||
-            length >= PJON_PACKET_MAX_LENGTH
-          ) return PJON_BUSY;
-          if(length > 15 && !(data[1] & PJON_CRC_BIT)) return PJON_BUSY;
-        }
-
-        if((i == (3 + extended_header)) && extended_length) {
-          length = (data[i - 1] << 8) | (data[i] & 0xFF);
-          if(
-            length < (overhead + !async_ack) ||
-            length >= PJON_PACKET_MAX_LENGTH
-          ) return PJON_BUSY;
-          if(length > 15 && !(data[1] & PJON_CRC_BIT)) return PJON_BUSY;
-        }
-
-        if((config & PJON_MODE_BIT) && (data[1] & PJON_MODE_BIT) && !_router)
-          if((i > (3 + extended_header + extended_length)))
-            if((i < (8 + extended_header + extended_length)))
-              if(bus_id[i - 4 - extended_header - extended_length] != data[i])
-                return PJON_BUSY;
-      }
-
-      if(
-        PJON_crc8::compute(data, 3 + extended_header + extended_length) !=
-        data[3 + extended_header + extended_length]
-      ) return PJON_NAK;
-
-      if(data[1] & PJON_CRC_BIT)
-        computed_crc = PJON_crc32::compare(
-          PJON_crc32::compute(data, length - 4), data + (length - 4)
-        );
-      else computed_crc =
-        (PJON_crc8::compute(data, length - 1) == data[length - 1]);
-
-      if(data[1] & PJON_ACK_REQ_BIT && data[0] != PJON_BROADCAST)
-        if((_mode != PJON_SIMPLEX) && !_router)
-          if(computed_crc) strategy.send_response(PJON_ACK);
-
-      if(!computed_crc) return PJON_NAK;
-      parse(data, last_packet_info);
-
-      #if(PJON_INCLUDE_ASYNC_ACK)
-        /* If a packet requesting asynchronous acknowledgement is received
-           send the acknowledgement packet back to the packet's transmitter */
-        if(async_ack && !_router) {
-          if(_auto_delete && length == overhead)
-            if(handle_asynchronous_acknowledgment(last_packet_info))
-              return PJON_ACK;
-          if(length > overhead) {
-            if(!dispatched(last_packet_info)) {
-              dispatch(
-                last_packet_info.sender_id,
-                (uint8_t *)last_packet_info.sender_bus_id,
-                NULL,
-                0,
-                0,
-                config | PJON_ACK_MODE_BIT | PJON_TX_INFO_BIT,
-                last_packet_info.id
-              );
-              update();
-            }
-            if(known_packet_id(last_packet_info))
-              return PJON_ACK;
-          }
-        }
-      #endif
-
-      _receiver(
-        data + (overhead - (data[1] & PJON_CRC_BIT ? 4 : 1)),
-        length - overhead,
-        last_packet_info
-      );
+    /* Try to receive a packet: */
 
-      return PJON_ACK;
+    uint16_t receive() {
+      PJON_TRACE_START(trace_start);
+      uint16_t result = receive_packet();
+      PJON_TRACE(this, PJON_TRACE_RECEIVE, trace_start, PJON_MICROS(), result);
+      return result;
     };
 
 
@@ -561,6 +469,19 @@ class PJON {
                 packet_info.sender_bus_id
               )
           )) {
+            #if(PJON_INCLUDE_PACKET_TIME)
+              complete(i, PJON_ACK);
+            #endif
+            #if(PJON_INCLUDE_ASYNC_ACK_RTT)
+              /* Karn's algorithm: the round trip time is sampled only from
+                 packets transmitted once, otherwise it is not known which
+                 transmission is acknowledged */
+              if(packets[i].attempts == 1)
+                add_rtt_sample(
+                  actual_info,
+                  (uint32_t)(PJON_MICROS() - packets[i].transmission)
+                );
+            #endif
             if(packets[i].timing) {
               uint8_t offset = packet_overhead(actual_info.header);
               uint8_t crc_offset =
@@ -643,6 +564,21 @@ class PJON {
     };
 
 
+    /* Back-off before the attempt passed: the one suggested by the strategy
+       scaled by the contention window if PJON_INCLUDE_ADAPTIVE_BACK_OFF is
+       true */
+
+    uint32_t back_off(uint8_t attempts) {
+      #if(PJON_INCLUDE_ADAPTIVE_BACK_OFF)
+        return (
+          (uint64_t)strategy.back_off(attempts) * contention_window
+        ) / PJON_CONTENTION_UNIT;
+      #else
+        return strategy.back_off(attempts);
+      #endif
+    };
+
+
     /* Send a packet and configure its sender info: */
 
     uint16_t send_from_id(
@@ -658,11 +594,11 @@ class PJON {
       uint8_t original_device_id = _device_id;
       uint8_t original_bus_id[4];
       copy_bus_id(original_bus_id, bus_id);
-      set_id(sender_id);
+      _device_id = sender_id; // Only composition, the strategy is not changed
       copy_bus_id(bus_id, sender_bus_id);
       uint16_t result = dispatch(id, b_id, string, length, 0, header, p_id);
       copy_bus_id(bus_id, original_bus_id);
-      set_id(original_device_id);
+      _device_id = original_device_id;
       return result;
     };
 
@@ -700,19 +636,84 @@ class PJON {
 
     uint16_t send_packet(const char *string, uint16_t length) {
       if(!string) return PJON_FAIL;
-      if(_mode != PJON_SIMPLEX && !strategy.can_start()) return PJON_BUSY;
+      PJON_TRACE_START(trace_start);
+      if(_mode != PJON_SIMPLEX && !strategy.can_start()) {
+        #if(PJON_INCLUDE_STATS)
+          stats.busy++;
+        #endif
+        #if(PJON_INCLUDE_ADAPTIVE_BACK_OFF)
+          adapt_contention(PJON_BUSY);
+        #endif
+        PJON_TRACE(
+          this, PJON_TRACE_SEND, trace_start, PJON_MICROS(), PJON_BUSY
+        );
+        return PJON_BUSY;
+      }
+      #if(PJON_INCLUDE_STATS)
+        uint32_t time = PJON_MICROS();
+        stats.packets_sent++;
+        stats.bytes_sent += length;
+      #endif
+      PJON_TRACE_START(send_start);
       strategy.send_string((uint8_t *)string, length);
+      PJON_TRACE_START(response_start);
+      PJON_TRACE(
+        this, PJON_TRACE_SEND_STRING, send_start, response_start, length
+      );
       if(
         string[0] == PJON_BROADCAST ||
         !(string[1] & PJON_ACK_REQ_BIT) ||
         _mode == PJON_SIMPLEX
-      ) return PJON_ACK;
+      ) { // Without response only an aborted transmission is reported
+        uint16_t result =
+          strategy_collision(strategy, 0) ? PJON_BUSY : PJON_ACK;
+        #if(PJON_INCLUDE_STATS)
+          if(result == PJON_BUSY) stats.busy++;
+        #endif
+        #if(PJON_INCLUDE_ADAPTIVE_BACK_OFF)
+          if(result == PJON_BUSY) adapt_contention(result);
+        #endif
+        PJON_CAPTURE(this, PJON_CAPTURE_TX, string, length, result);
+        PJON_TRACE(
+          this, PJON_TRACE_SEND, trace_start, response_start, result
+        );
+        return result;
+      }
       uint16_t response = strategy.receive_response();
-      if(
-        response == PJON_ACK ||
-        response == PJON_FAIL
-      ) return response;
-      else return PJON_BUSY;
+      PJON_CAPTURE(this, PJON_CAPTURE_TX, string, length, response);
+      PJON_TRACE_START(response_end);
+      PJON_TRACE(
+        this, PJON_TRACE_RESPONSE, response_start, response_end, response
+      );
+      #if(PJON_INCLUDE_STATS)
+        if(response == PJON_ACK) {
+          stats.acks++;
+          record_latency((uint32_t)(PJON_MICROS() - time));
+        } else if(response == PJON_FAIL) stats.fails++;
+        else if(response == PJON_NAK) stats.naks++;
+        else stats.busy++;
+      #endif
+      #if(PJON_INCLUDE_ADAPTIVE_BACK_OFF)
+        adapt_contention(response);
+      #endif
+      if(response != PJON_ACK && response != PJON_FAIL) response = PJON_BUSY;
+      PJON_TRACE(this, PJON_TRACE_SEND, trace_start, response_end, response);
+      return response;
+    };
+
+
+    /* Strategies able to detect collisions while transmitting define
+       get_collision, returning true if the last frame was aborted: */
+
+    template<typename S>
+    static auto strategy_collision(S &s, int) ->
+      decltype((bool)s.get_collision()) {
+      return s.get_collision();
+    };
+
+    template<typename S>
+    static bool strategy_collision(S &s, long) {
+      return false;
     };
 
 
@@ -775,13 +776,30 @@ class PJON {
           old_length,
           header
         ))) return PJON_FAIL;
+        #if(PJON_INCLUDE_STATS)
+          if(attempts) stats.retries++;
+        #endif
         state = send_packet((char*)data, length);
-        if(state == PJON_ACK) return state;
+        if(state == PJON_ACK) {
+          #if(PJON_INCLUDE_STATS)
+            record_attempts(attempts + 1);
+          #endif
+          return state;
+        }
         attempts++;
         if(state != PJON_FAIL) strategy.handle_collision();
-        receive(
-          (uint32_t)(PJON_MICROS() - time) < strategy.back_off(attempts)
+        #if(PJON_INCLUDE_STATS)
+          uint32_t back_off_start = PJON_MICROS();
+        #endif
+        PJON_TRACE_START(trace_start);
+        while((uint32_t)(PJON_MICROS() - time) < back_off(attempts))
+          receive();
+        PJON_TRACE(
+          this, PJON_TRACE_BACK_OFF, trace_start, PJON_MICROS(), attempts
         );
+        #if(PJON_INCLUDE_STATS)
+          stats.back_off_time += (uint32_t)(PJON_MICROS() - back_off_start);
+        #endif
         time = PJON_MICROS();
       }
       return state;
@@ -854,11 +872,17 @@ class PJON {
       if(!bus_id_equality(bus_id, localhost)) set_shared_network(true);
       set_error(PJON_dummy_error_handler);
       set_receiver(PJON_dummy_receiver_handler);
+      #if(PJON_INCLUDE_PACKET_TIME)
+        set_completion(PJON_dummy_completion_handler);
+      #endif
       for(uint16_t i = 0; i < PJON_MAX_PACKETS; i++) {
         packets[i].state = 0;
         packets[i].timing = 0;
         packets[i].attempts = 0;
       }
+      #if(PJON_INCLUDE_STATS)
+        reset_stats();
+      #endif
     };
 
 
@@ -878,13 +902,49 @@ class PJON {
     };
 
 
-    /* Set the device id, passing a single byte (watch out to id collision): */
+    #if(PJON_INCLUDE_PACKET_TIME)
+      /* Pass a void function called when a packet of the send list is
+         delivered (PJON_ACK) or dropped after the maximum number of attempts
+         (PJON_FAIL), receiving its info and times (packets sent repeatedly
+         are reported at each delivery):
+
+      void completion_handler(
+        uint16_t result,
+        const PJON_Packet_Info &packet_info,
+        const PJON_Packet_Time &packet_time
+      ) {
+        Serial.print(packet_time.first_attempt - packet_time.dispatch);
+        Serial.print(" queued, delivered in ");
+        Serial.println(packet_time.completion - packet_time.first_attempt);
+      };
+
+      bus.set_completion(completion_handler); */
+
+      void set_completion(PJON_Completion c) {
+        _completion = c;
+      };
+    #endif
+
+
+    /* Set the device id, passing a single byte (watch out to id collision),
+       strategies filtering frames by recipient define set_id to follow it: */
 
     void set_id(uint8_t id) {
       _device_id = id;
+      strategy_set_id(strategy, id, 0);
     };
 
 
+    template<typename S>
+    static auto strategy_set_id(S &s, uint8_t id, int) ->
+      decltype(s.set_id(id)) {
+      return s.set_id(id);
+    };
+
+    template<typename S>
+    static void strategy_set_id(S &s, uint8_t id, long) { };
+
+
     /* Configure sender's information inclusion in the packet.
        TRUE: +1 byte (device id) local, +5 bytes (bus id + device id) shared
        FALSE: No inclusion -1 byte overhead in local, -5 in shared
@@ -950,6 +1010,50 @@ class PJON {
 
     void set_router(bool state) {
       _router = state;
+      strategy_set_router(strategy, state, 0);
+    };
+
+
+    /* Strategies filtering frames by recipient define set_router to receive
+       also the frames addressed to other devices: */
+
+    template<typename S>
+    static auto strategy_set_router(S &s, bool state, int) ->
+      decltype(s.set_router(state)) {
+      return s.set_router(state);
+    };
+
+    template<typename S>
+    static void strategy_set_router(S &s, bool state, long) { };
+
+
+    /* Timeout after which a packet in the send list is attempted again,
+       counted from start: the back-off since its registration or, when the
+       round trip is estimated, the retransmission timeout since the last
+       transmission. */
+
+    uint32_t attempt_timeout(const PJON_Packet &packet, uint32_t &start) {
+      start = packet.registration;
+      #if(PJON_INCLUDE_ASYNC_ACK_RTT)
+        if(
+          packet.attempts && packet.rto &&
+          (packet.content[1] & PJON_ACK_MODE_BIT) &&
+          (packet.content[1] & PJON_TX_INFO_BIT)
+        ) {
+          start = packet.transmission;
+          return packet.rto;
+        }
+      #endif
+      return packet.timing + back_off(packet.attempts);
+    };
+
+
+    /* Time the next attempt of a packet in the send list is due: */
+
+    uint32_t next_attempt(const PJON_Packet &packet) {
+      uint32_t start;
+      uint32_t timeout = attempt_timeout(packet, start);
+      return start + timeout;
     };
 
 
@@ -958,6 +1062,7 @@ class PJON {
        delivered. Returns the actual number of packets to be sent. */
 
     uint16_t update() {
+      PJON_TRACE_START(trace_start);
       uint16_t packets_count = 0;
       for(uint16_t i = 0; i < PJON_MAX_PACKETS; i++) {
         if(packets[i].state == 0) continue;
@@ -966,21 +1071,46 @@ class PJON {
           (packets[i].content[1] & PJON_TX_INFO_BIT);
         bool sync_ack = (packets[i].content[1] & PJON_ACK_REQ_BIT);
 
-        if(
-          (uint32_t)(PJON_MICROS() - packets[i].registration) >
-          (uint32_t)(
-            packets[i].timing +
-            strategy.back_off(packets[i].attempts)
-          )
-        ) {
-          if(!(sync_ack && async_ack && packets[i].state == PJON_ACK))
+        uint32_t start;
+        uint32_t timeout = attempt_timeout(packets[i], start);
+        uint32_t elapsed = PJON_MICROS() - start;
+        #if(PJON_INCLUDE_TDMA) // Wait the next slot if it does not fit
+          if((elapsed > timeout) && !fits_slot(packets[i].length)) continue;
+        #endif
+        if(elapsed > timeout) {
+          if(!(sync_ack && async_ack && packets[i].state == PJON_ACK)) {
+            #if(PJON_INCLUDE_STATS)
+              if(packets[i].attempts) {
+                stats.retries++;
+                stats.back_off_time +=
+                  (uint32_t)(PJON_MICROS() - packets[i].attempt_end);
+              }
+            #endif
+            #if(PJON_INCLUDE_PACKET_TIME)
+              if(!packets[i].attempts) packets[i].first_attempt = PJON_MICROS();
+            #endif
+            #if(PJON_INCLUDE_ASYNC_ACK_RTT)
+              packets[i].transmission = PJON_MICROS();
+            #endif
             packets[i].state = // Avoid resending sync-acked async ack packets
               send_packet(packets[i].content, packets[i].length);
+            #if(PJON_INCLUDE_STATS) // The wait is counted at the next attempt
+              if(packets[i].state == PJON_ACK)
+                record_attempts(packets[i].attempts + 1);
+              else packets[i].attempt_end = PJON_MICROS();
+            #endif
+          }
         } else continue;
 
         packets[i].attempts++;
+        #if(PJON_INCLUDE_ASYNC_ACK_RTT) // Computed once for each attempt
+          if(async_ack) packets[i].rto = retransmission_timeout(packets[i]);
+        #endif
 
         if(packets[i].state == PJON_ACK) {
+          #if(PJON_INCLUDE_PACKET_TIME)
+            if(!async_ack) complete(i, PJON_ACK);
+          #endif
           if(!packets[i].timing) {
             if(
               _auto_delete && (
@@ -995,6 +1125,9 @@ class PJON {
               packets[i].attempts = 0;
               packets[i].registration = PJON_MICROS();
               packets[i].state = PJON_TO_BE_SENT;
+              #if(PJON_INCLUDE_PACKET_TIME)
+                packets[i].dispatch_time = packets[i].registration;
+              #endif
             }
           }
           if(!async_ack) continue;
@@ -1004,7 +1137,13 @@ class PJON {
           strategy.handle_collision();
 
         if(packets[i].attempts > strategy.get_max_attempts()) {
+          #if(PJON_INCLUDE_STATS)
+            stats.connection_lost++;
+          #endif
           _error(PJON_CONNECTION_LOST, i);
+          #if(PJON_INCLUDE_PACKET_TIME)
+            complete(i, PJON_FAIL);
+          #endif
           if(!packets[i].timing) {
             if(_auto_delete) {
               remove(i);
@@ -1014,9 +1153,23 @@ class PJON {
             packets[i].attempts = 0;
             packets[i].registration = PJON_MICROS();
             packets[i].state = PJON_TO_BE_SENT;
+            #if(PJON_INCLUDE_PACKET_TIME)
+              packets[i].dispatch_time = packets[i].registration;
+            #endif
           }
+        } else { // Trace the wait until the next attempt is due
+          PJON_TRACE(
+            this,
+            PJON_TRACE_BACK_OFF,
+            PJON_MICROS(),
+            next_attempt(packets[i]),
+            packets[i].attempts
+          );
         }
       }
+      PJON_TRACE(
+        this, PJON_TRACE_UPDATE, trace_start, PJON_MICROS(), packets_count
+      );
       return packets_count;
     };
 
@@ -1062,6 +1215,190 @@ class PJON {
     };
 
 
+    #if(PJON_INCLUDE_ASYNC_ACK_RTT)
+      /* Round trip time estimation of the recipient of the packet whose info
+         is passed, NULL if unknown: */
+
+      PJON_RTT_Estimate *find_rtt(const PJON_Packet_Info &info) {
+        const uint8_t *b_id =
+          (info.header & PJON_MODE_BIT) ? info.receiver_bus_id : localhost;
+        for(uint8_t i = 0; i < PJON_RTT_RECIPIENTS; i++)
+          if(
+            rtt_estimates[i].id == info.receiver_id &&
+            bus_id_equality(rtt_estimates[i].bus_id, b_id)
+          ) return &rtt_estimates[i];
+        return NULL;
+      };
+
+
+      /* Update the estimation of the recipient of the packet whose info is
+         passed with a round trip time sample (Jacobson's algorithm), if not
+         present it replaces the least recently added recipient: */
+
+      void add_rtt_sample(const PJON_Packet_Info &info, uint32_t sample) {
+        PJON_RTT_Estimate *estimate = find_rtt(info);
+        if(!estimate) {
+          estimate = &rtt_estimates[_rtt_next];
+          _rtt_next = (_rtt_next + 1) % PJON_RTT_RECIPIENTS;
+          estimate->id = info.receiver_id;
+          copy_bus_id(
+            estimate->bus_id,
+            (info.header & PJON_MODE_BIT) ? info.receiver_bus_id : localhost
+          );
+          estimate->srtt = sample;
+          estimate->rttvar = sample / 2;
+          return;
+        }
+        int32_t error = (int32_t)(sample - estimate->srtt);
+        int32_t deviation = ((error < 0) ? -error : error) - estimate->rttvar;
+        estimate->rttvar += deviation / 4;
+        estimate->srtt += error / 8;
+      };
+
+
+      /* Time to wait after the last transmission of a packet before sending
+         it again, doubled at each attempt, PJON_RTO_INITIAL if the round trip
+         time of the recipient is not estimated yet (RFC 6298): */
+
+      uint32_t retransmission_timeout(const PJON_Packet &packet) {
+        PJON_Packet_Info info;
+        parse((const uint8_t *)packet.content, info);
+        PJON_RTT_Estimate *estimate = find_rtt(info);
+        uint32_t rto = PJON_RTO_INITIAL;
+        if(estimate) rto = estimate->srtt + 4 * estimate->rttvar;
+        if(rto < PJON_RTO_MIN) rto = PJON_RTO_MIN;
+        for(uint8_t i = 1; (i < packet.attempts) && (rto < PJON_RTO_MAX); i++)
+          rto *= 2;
+        return (rto < PJON_RTO_MAX) ? rto : PJON_RTO_MAX;
+      };
+    #endif
+
+
+    #if(PJON_INCLUDE_ADAPTIVE_BACK_OFF)
+      /* Adapt the contention window to the result of a transmission:
+         multiplicative increase if the medium was busy, the frame collided
+         or the packet was not acknowledged, additive decrease if it was.
+         Only the responses to a synchronous acknowledgement request can
+         decrease it, a frame sent without response does not tell if the
+         packet was received. */
+
+      void adapt_contention(uint16_t result) {
+        if(result == PJON_ACK) {
+          if(
+            contention_window >= PJON_CONTENTION_MIN + PJON_CONTENTION_DECREASE
+          ) contention_window -= PJON_CONTENTION_DECREASE;
+          else contention_window = PJON_CONTENTION_MIN;
+        } else if(contention_window <= PJON_CONTENTION_MAX / 2)
+          contention_window *= 2;
+        else contention_window = PJON_CONTENTION_MAX;
+      };
+    #endif
+
+
+    #if(PJON_INCLUDE_PACKET_TIME)
+      /* Call the completion handler for the packet present at index, the
+         asynchronous acknowledgements sent on behalf of the application are
+         not reported: */
+
+      void complete(uint16_t index, uint16_t result) {
+        PJON_Packet &packet = packets[index];
+        if(
+          (packet.content[1] & PJON_ACK_MODE_BIT) &&
+          (packet.length == packet_overhead(packet.content[1]))
+        ) return;
+        PJON_Packet_Info info;
+        parse((uint8_t *)packet.content, info);
+        PJON_Packet_Time time;
+        time.dispatch = packet.dispatch_time;
+        time.first_attempt = packet.first_attempt;
+        time.completion = PJON_MICROS();
+        _completion(result, info, time);
+      };
+    #endif
+
+
+    #if(PJON_INCLUDE_TDMA)
+      /* Time in microseconds a frame of length bytes and its response occupy
+         the medium (frame initializer and response counted as 4 bytes), 0 if
+         the strategy does not define get_byte_time: */
+
+      uint32_t transmission_time(uint16_t length) {
+        return (uint32_t)(length + 4) * strategy_byte_time(strategy, 0);
+      };
+
+
+      /* Check if the transmission of a frame of length bytes ends before the
+         end of the slot update is confined in (see PJONSlave::update): */
+
+      bool fits_slot(uint16_t length) {
+        if(!_slot_confined) return true;
+        return
+          (int32_t)(_slot_end - PJON_MICROS() - transmission_time(length)) > 0;
+      };
+
+
+      /* Duration of a byte: strategies with a known transfer speed define
+         get_byte_time, for the others 0 is returned */
+
+      template<typename S>
+      static auto strategy_byte_time(S &s, int) ->
+        decltype((uint32_t)s.get_byte_time()) {
+        return s.get_byte_time();
+      };
+
+      template<typename S>
+      static uint32_t strategy_byte_time(S &s, long) {
+        return 0;
+      };
+    #endif
+
+
+    #if(PJON_INCLUDE_PACKET_TIME || PJON_INCLUDE_TIME_SYNC)
+      /* Time the last frame received started to arrive: strategies able to
+         timestamp frames define get_receive_time, for the others the actual
+         time is used, so it should be called as soon as the frame is read */
+
+      template<typename S>
+      static auto strategy_receive_time(S &s, int) ->
+        decltype((uint32_t)s.get_receive_time()) {
+        return s.get_receive_time();
+      };
+
+      template<typename S>
+      static uint32_t strategy_receive_time(S &s, long) {
+        return PJON_MICROS();
+      };
+    #endif
+
+
+    #if(PJON_INCLUDE_STATS)
+      /* Reset the bus statistics: */
+
+      void reset_stats() {
+        memset(&stats, 0, sizeof(stats));
+      };
+
+
+      /* Count a packet delivered after the attempts passed: */
+
+      void record_attempts(uint32_t attempts) {
+        if(!attempts) return;
+        if(attempts > PJON_STATS_ATTEMPTS) attempts = PJON_STATS_ATTEMPTS;
+        stats.attempts[attempts - 1]++;
+      };
+
+
+      /* Count a transmission acknowledged after latency microseconds: */
+
+      void record_latency(uint32_t latency) {
+        uint8_t bucket = 0;
+        while((latency >>= 1) && (bucket < (PJON_STATS_LATENCY_BUCKETS - 1)))
+          bucket++;
+        stats.latency[bucket]++;
+      };
+    #endif
+
+
     /* Check equality between two bus ids */
 
     static bool bus_id_equality(const uint8_t *n_one, const uint8_t *n_two) {
@@ -1080,11 +1417,187 @@ class PJON {
 
   private:
     bool          _auto_delete = true;
+    #if(PJON_INCLUDE_PACKET_TIME)
+      PJON_Completion _completion;
+    #endif
     PJON_Error    _error;
     uint8_t       _mode;
     uint16_t      _packet_id_seed = 0;
     PJON_Receiver _receiver;
-    bool          _router = false;
+    #if(PJON_INCLUDE_ASYNC_ACK_RTT)
+      uint8_t     _rtt_next = 0;
+    #endif
   protected:
+
+    /* Receive a packet, receive() traces the result: */
+
+    uint16_t receive_packet() {
+      uint16_t length = PJON_PACKET_MAX_LENGTH;
+      uint16_t batch_length = 0;
+      uint8_t  overhead = 0;
+      bool computed_crc = 0;
+      bool extended_header = false;
+      bool extended_length = false;
+      bool async_ack = false;
+      #if(PJON_INCLUDE_PACKET_TIME)
+        uint32_t receive_time = 0;
+      #endif
+      for(uint16_t i = 0; i < length; i++) {
+        if(!batch_length) {
+          batch_length = strategy.receive_string(data + i, length - i);
+          if(batch_length == PJON_FAIL || batch_length == 0)
+            return PJON_FAIL;
+          #if(PJON_INCLUDE_PACKET_TIME)
+            if(!i) receive_time = strategy_receive_time(strategy, 0);
+          #endif
+        }
+        batch_length--;
+
+        if(i == 0)
+          if(data[i] != _device_id && data[i] != PJON_BROADCAST && !_router)
+            return PJON_BUSY;
+
+        if(i == 1) {
+          if(
+            (
+              !_router &&
+              ((data[1] & PJON_MODE_BIT) != (config & PJON_MODE_BIT))
+            ) || (
+              data[0] == PJON_BROADCAST &&
+              ((data[1] & PJON_ACK_MODE_BIT) || (data[1] & PJON_ACK_REQ_BIT))
+            ) || (
+              (data[1] & PJON_ACK_MODE_BIT) && !(data[1] & PJON_TX_INFO_BIT)
+            ) || (
+              (data[1] & PJON_EXT_LEN_BIT) && !(data[1] & PJON_CRC_BIT)
+            ) || (
+              !PJON_INCLUDE_ASYNC_ACK && (data[1] & PJON_ACK_MODE_BIT)
+            ) || (
+              ((data[1] & PJON_ADDRESS_BIT) && !(data[1] & PJON_CRC_BIT)) ||
+              ((data[1] & PJON_ADDRESS_BIT) && !(data[1] & PJON_TX_INFO_BIT))
+            )
+          ) return PJON_BUSY;
+          extended_length = data[i] & PJON_EXT_LEN_BIT;
+          extended_header = data[i] & PJON_EXT_HEAD_BIT;
+          overhead = packet_overhead(data[i]);
+          async_ack = (
+            PJON_INCLUDE_ASYNC_ACK &&
+            (data[1] & PJON_ACK_MODE_BIT) &&
+            (data[1] & PJON_TX_INFO_BIT)
+          );
+        }
+
+        if((i == (2 + extended_header)) && !extended_length) {
+          length = data[i];
+          if(
+            length < (overhead + !async_ack) ||
+            length >= PJON_PACKET_MAX_LENGTH
+          ) return PJON_BUSY;
+          if(length > 15 && !(data[1] & PJON_CRC_BIT)) return PJON_BUSY;
+        }
+
+        if((i == (3 + extended_header)) && extended_length) {
+          length = (data[i - 1] << 8) | (data[i] & 0xFF);
+          if(
+            length < (overhead + !async_ack) ||
+            length >= PJON_PACKET_MAX_LENGTH
+          ) return PJON_BUSY;
+          if(length > 15 && !(data[1] & PJON_CRC_BIT)) return PJON_BUSY;
+        }
+
+        if((config & PJON_MODE_BIT) && (data[1] & PJON_MODE_BIT) && !_router)
+          if((i > (3 + extended_header + extended_length)))
+            if((i < (8 + extended_header + extended_length)))
+              if(bus_id[i - 4 - extended_header - extended_length] != data[i])
+                return PJON_BUSY;
+      }
+
+      if(
+        PJON_crc8::compute(data, 3 + extended_header + extended_length) !=
+        data[3 + extended_header + extended_length]
+      ) {
+        #if(PJON_INCLUDE_STATS)
+          stats.crc8_errors++;
+        #endif
+        PJON_CAPTURE(
+          this,
+          PJON_CAPTURE_RX,
+          data,
+          4 + extended_header + extended_length,
+          PJON_NAK
+        );
+        return PJON_NAK;
+      }
+
+      if(data[1] & PJON_CRC_BIT)
+        computed_crc = PJON_crc32::compare(
+          PJON_crc32::compute(data, length - 4), data + (length - 4)
+        );
+      else computed_crc =
+        (PJON_crc8::compute(data, length - 1) == data[length - 1]);
+
+      if(data[1] & PJON_ACK_REQ_BIT && data[0] != PJON_BROADCAST)
+        if((_mode != PJON_SIMPLEX) && !_router)
+          if(computed_crc) strategy.send_response(PJON_ACK);
+
+      PJON_CAPTURE(
+        this, PJON_CAPTURE_RX, data, length, computed_crc ? PJON_ACK : PJON_NAK
+      );
+
+      #if(PJON_INCLUDE_STATS)
+        if(!computed_crc) {
+          if(data[1] & PJON_CRC_BIT) stats.crc32_errors++;
+          else stats.crc8_errors++;
+        } else {
+          stats.packets_received++;
+          stats.bytes_received += length;
+        }
+      #endif
+
+      if(!computed_crc) return PJON_NAK;
+      parse(data, last_packet_info);
+      #if(PJON_INCLUDE_PACKET_TIME)
+        last_packet_info.receive_time = receive_time;
+      #endif
+
+      #if(PJON_INCLUDE_ASYNC_ACK)
+        /* If a packet requesting asynchronous acknowledgement is received
+           send the acknowledgement packet back to the packet's transmitter */
+        if(async_ack && !_router) {
+          if(_auto_delete && length == overhead)
+            if(handle_asynchronous_acknowledgment(last_packet_info))
+              return PJON_ACK;
+          if(length > overhead) {
+            if(!dispatched(last_packet_info)) {
+              dispatch(
+                last_packet_info.sender_id,
+                (uint8_t *)last_packet_info.sender_bus_id,
+                NULL,
+                0,
+                0,
+                config | PJON_ACK_MODE_BIT | PJON_TX_INFO_BIT,
+                last_packet_info.id
+              );
+              update();
+            }
+            if(known_packet_id(last_packet_info))
+              return PJON_ACK;
+          }
+        }
+      #endif
+
+      _receiver(
+        data + (overhead - (data[1] & PJON_CRC_BIT ? 4 : 1)),
+        length - overhead,
+        last_packet_info
+      );
+
+      return PJON_ACK;
+    };
+
     uint8_t       _device_id;
+    bool          _router = false;
+    #if(PJON_INCLUDE_TDMA)
+      bool        _slot_confined = false;
+      uint32_t    _slot_end = 0;
+    #endif
 };
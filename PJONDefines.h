@@ -58,11 +58,25 @@ limitations under the License. */
 /* Device id of still unindexed devices */
 #define PJON_NOT_ASSIGNED   255
 
-/* Maximum devices handled by master */
+/* Maximum devices handled by master (up to 253) */
 #ifndef PJON_MAX_DEVICES
   #define PJON_MAX_DEVICES   25
 #endif
 
+/* Length of the index used by master to find a device id from its rid,
+   a power of 2 at least the double of PJON_MAX_DEVICES */
+#ifndef PJON_RID_INDEX_LENGTH
+  #if PJON_MAX_DEVICES <= 32
+    #define PJON_RID_INDEX_LENGTH  64
+  #elif PJON_MAX_DEVICES <= 64
+    #define PJON_RID_INDEX_LENGTH 128
+  #elif PJON_MAX_DEVICES <= 128
+    #define PJON_RID_INDEX_LENGTH 256
+  #else
+    #define PJON_RID_INDEX_LENGTH 512
+  #endif
+#endif
+
 /* Communication modes */
 #define PJON_SIMPLEX        150
 #define PJON_HALF_DUPLEX    151
@@ -79,6 +93,15 @@ limitations under the License. */
 #define PJON_ID_NEGATE      203
 #define PJON_ID_LIST        204
 #define PJON_ID_REFRESH     205
+#define PJON_TDMA_BEACON    206
+#define PJON_ID_GRANTS      210
+#define PJON_ID_CLAIM       211
+#define PJON_ID_DEFEND      212
+
+/* Time synchronization */
+#define PJON_TIME_SYNC      207
+#define PJON_TIME_REQUEST   208
+#define PJON_TIME_RESPONSE  209
 
 /* INTERNAL CONSTANTS */
 #define PJON_FAIL         65535
@@ -165,6 +188,137 @@ limitations under the License. */
   #define PJON_INCLUDE_ASYNC_ACK false
 #endif
 
+/* If set to true (and PJON_INCLUDE_ASYNC_ACK is true) the round trip time
+   of asynchronous acknowledgements is estimated for each recipient and used
+   to schedule retransmissions, instead of the strategy's back-off */
+#ifndef PJON_INCLUDE_ASYNC_ACK_RTT
+  #define PJON_INCLUDE_ASYNC_ACK_RTT false
+#endif
+
+#if(!PJON_INCLUDE_ASYNC_ACK)
+  #undef  PJON_INCLUDE_ASYNC_ACK_RTT
+  #define PJON_INCLUDE_ASYNC_ACK_RTT false
+#endif
+
+/* Recipients whose round trip time estimation is kept */
+#ifndef PJON_RTT_RECIPIENTS
+  #define PJON_RTT_RECIPIENTS 4
+#endif
+
+/* Retransmission timeout limits (microseconds), PJON_RTO_INITIAL is used
+   for recipients whose round trip time is not estimated yet */
+#ifndef PJON_RTO_INITIAL
+  #define PJON_RTO_INITIAL 1000000
+#endif
+#ifndef PJON_RTO_MIN
+  #define PJON_RTO_MIN     1000
+#endif
+#ifndef PJON_RTO_MAX
+  #define PJON_RTO_MAX  5000000
+#endif
+
+/* If set to true per bus statistics are collected in PJON::stats,
+   if false the code is not compiled and no memory is used */
+#ifndef PJON_INCLUDE_STATS
+  #define PJON_INCLUDE_STATS false
+#endif
+
+/* Statistics latency histogram length: bucket n counts transmissions
+   acknowledged in 2^n to 2^(n + 1) - 1 microseconds, the last bucket
+   counts also longer latencies */
+#ifndef PJON_STATS_LATENCY_BUCKETS
+  #define PJON_STATS_LATENCY_BUCKETS 20
+#endif
+
+/* Statistics attempts histogram length: bucket n counts packets delivered
+   after n + 1 transmissions, the last bucket counts also more attempts */
+#ifndef PJON_STATS_ATTEMPTS
+  #define PJON_STATS_ATTEMPTS         8
+#endif
+
+/* If set to true PJON_Packet_Info contains the time a packet started to be
+   received and the completion handler is called with the times of the
+   packets of the send list (see PJON_Packet_Time) */
+#ifndef PJON_INCLUDE_PACKET_TIME
+  #define PJON_INCLUDE_PACKET_TIME false
+#endif
+
+/* If set to true the back-off suggested by the strategy is scaled by a
+   contention window adapting to the bus load (AIMD): it is doubled if the
+   medium is busy, a frame collides or a synchronous acknowledgement request
+   is answered with PJON_NAK or not answered, it is decreased by
+   PJON_CONTENTION_DECREASE after each synchronous acknowledgement received */
+#ifndef PJON_INCLUDE_ADAPTIVE_BACK_OFF
+  #define PJON_INCLUDE_ADAPTIVE_BACK_OFF false
+#endif
+
+/* Contention window limits, PJON_CONTENTION_UNIT is the back-off
+   suggested by the strategy (PJON_CONTENTION_MIN 4 is a quarter of it) */
+#define PJON_CONTENTION_UNIT         16
+#ifndef PJON_CONTENTION_MIN
+  #define PJON_CONTENTION_MIN         4
+#endif
+#ifndef PJON_CONTENTION_MAX
+  #define PJON_CONTENTION_MAX       512
+#endif
+#ifndef PJON_CONTENTION_DECREASE
+  #define PJON_CONTENTION_DECREASE    1
+#endif
+
+/* Tracing hooks, by default empty so no code is generated.
+   PJON_TRACE_START(T) declares T and saves in it the PJON_MICROS time a
+   stage starts, PJON_TRACE(BUS, EVENT, START, END, RESULT) is called by the
+   PJON instance BUS when the stage EVENT, lasted from START to END, returns
+   RESULT. Define both before including PJON.h to use a custom sink, or
+   include interfaces/LINUX/PJON_Trace_LINUX.h */
+#ifndef PJON_TRACE
+  #define PJON_TRACE_START(T)
+  #define PJON_TRACE(BUS, EVENT, START, END, RESULT)
+#endif
+
+/* Traced stages: */
+#define PJON_TRACE_COMPOSE     0 // compose_packet
+#define PJON_TRACE_SEND        1 // send_packet
+#define PJON_TRACE_SEND_STRING 2 // strategy.send_string
+#define PJON_TRACE_RESPONSE    3 // strategy.receive_response (ACK wait)
+#define PJON_TRACE_RECEIVE     4 // receive
+#define PJON_TRACE_UPDATE      5 // update
+#define PJON_TRACE_BACK_OFF    6 // Wait before the next attempt
+
+/* Capture hook, by default empty so no code is generated.
+   PJON_CAPTURE(BUS, DIRECTION, FRAME, LENGTH, RESULT) is called by the PJON
+   instance BUS for each frame received (with PJON_ACK or PJON_NAK if its CRC
+   is wrong) and for each frame transmitted once its response is known.
+   Define it before including PJON.h to use a custom sink, or include
+   interfaces/LINUX/PJON_Capture_LINUX.h to save pcap-ng files */
+#ifndef PJON_CAPTURE
+  #define PJON_CAPTURE(BUS, DIRECTION, FRAME, LENGTH, RESULT)
+#endif
+
+/* Captured frames direction (as pcap-ng epb_flags): */
+#define PJON_CAPTURE_RX 1
+#define PJON_CAPTURE_TX 2
+
+/* Device registry hooks of PJONMaster, by default empty so no code is
+   generated. PJON_REGISTRY_LOAD(MASTER) is called by begin and returns true
+   if the device table is restored, PJON_REGISTRY_STORE(MASTER, ID) is called
+   each time the entry of ID changes (0 if the whole table is emptied) and
+   PJON_REGISTRY_SEEN(MASTER, ID) each time a packet of an active ID is
+   received. Define them and PJON_INCLUDE_REGISTRY before including
+   PJONMaster.h to use a custom storage, or include
+   interfaces/LINUX/PJON_Registry_LINUX.h to save the table in a file */
+#ifndef PJON_INCLUDE_REGISTRY
+  #define PJON_INCLUDE_REGISTRY false
+  #define PJON_REGISTRY_LOAD(MASTER) false
+  #define PJON_REGISTRY_STORE(MASTER, ID)
+  #define PJON_REGISTRY_SEEN(MASTER, ID)
+#endif
+
+/* Interval between the probes of the ids restored (microseconds) */
+#ifndef PJON_REGISTRY_PROBE_INTERVAL
+  #define PJON_REGISTRY_PROBE_INTERVAL 100000
+#endif
+
 /* Maximum packet ids record kept in memory (to avoid duplicated exchanges) */
 #ifndef PJON_MAX_RECENT_PACKET_IDS
   #define PJON_MAX_RECENT_PACKET_IDS 10
@@ -184,6 +338,101 @@ limitations under the License. */
 /* Master reception time during LIST_ID broadcast (75 milliseconds) */
 #define PJON_LIST_IDS_TIME          75000
 
+/* If set to true PJONSlave::acquire_id_multi_master listens to the traffic
+   for PJON_ID_LISTEN_TIME to learn the ids in use, probes only the ids not
+   observed and broadcasts a PJON_ID_CLAIM before taking one: the device
+   owning it answers with a PJON_ID_DEFEND, of two devices claiming the same
+   id the one with the higher rid takes it */
+#ifndef PJON_INCLUDE_ID_CLAIM
+  #define PJON_INCLUDE_ID_CLAIM false
+#endif
+
+/* Passive listening duration (microseconds) */
+#ifndef PJON_ID_LISTEN_TIME
+  #define PJON_ID_LISTEN_TIME   1000000
+#endif
+
+/* Maximum time a PJON_ID_DEFEND is waited after a PJON_ID_CLAIM
+   (microseconds) */
+#ifndef PJON_ID_CLAIM_TIME
+  #define PJON_ID_CLAIM_TIME     100000
+#endif
+
+/* PJON_ID_CLAIM broadcasts sent before taking an id, each followed by a
+   random wait between PJON_ID_CLAIM_TIME / 2 and PJON_ID_CLAIM_TIME, so a
+   claim lost in a collision with another one is repeated */
+#ifndef PJON_ID_CLAIM_ATTEMPTS
+  #define PJON_ID_CLAIM_ATTEMPTS      2
+#endif
+
+/* Transmissions of each probe not acknowledged before the id is claimed */
+#ifndef PJON_ID_PROBE_ATTEMPTS
+  #define PJON_ID_PROBE_ATTEMPTS      2
+#endif
+
+/* If set to true PJONMaster does not answer each PJON_ID_REQUEST with its
+   own repeated broadcast, it aggregates the pending assignments in a single
+   PJON_ID_GRANTS broadcast sent every PJON_ID_REQUEST_INTERVAL. PJONSlave
+   instances send their request after a random delay within a window that
+   grows with collisions and with the assignments pending in the master */
+#ifndef PJON_INCLUDE_ID_BATCH
+  #define PJON_INCLUDE_ID_BATCH false
+#endif
+
+/* Initial and maximum id request window (microseconds) */
+#ifndef PJON_ID_REQUEST_WINDOW
+  #define PJON_ID_REQUEST_WINDOW     100000
+#endif
+#ifndef PJON_ID_REQUEST_WINDOW_MAX
+  #define PJON_ID_REQUEST_WINDOW_MAX 5000000
+#endif
+
+/* If set to true PJONMaster can coordinate a TDMA schedule: it broadcasts
+   periodically a PJON_TDMA_BEACON assigning a time slot to each of its
+   active devices, PJONSlave instances transmit only in their own slot or in
+   the contention slot closing each superframe (see PJONMaster::set_tdma) */
+#ifndef PJON_INCLUDE_TDMA
+  #define PJON_INCLUDE_TDMA false
+#endif
+
+/* Time left unused at the end of each slot (microseconds) */
+#ifndef PJON_TDMA_GUARD
+  #define PJON_TDMA_GUARD          1000
+#endif
+
+/* Time a slave waits a beacon before requesting an id (microseconds) */
+#ifndef PJON_TDMA_JOIN_TIME
+  #define PJON_TDMA_JOIN_TIME   1000000
+#endif
+
+/* Superframes a slave follows the schedule without receiving a beacon */
+#ifndef PJON_TDMA_BEACON_LOSS
+  #define PJON_TDMA_BEACON_LOSS       3
+#endif
+
+/* If set to true PJONMaster can broadcast its time periodically and
+   PJONSlave instances estimate offset and drift of their clock, providing
+   the master's time with PJONSlave::sync_micros (see PJONMaster::set_time_sync
+   and PJONSlave::set_time_request) */
+#ifndef PJON_INCLUDE_TIME_SYNC
+  #define PJON_INCLUDE_TIME_SYNC false
+#endif
+
+/* Offset error over which the slave's clock is set instead of corrected
+   (microseconds) */
+#ifndef PJON_TIME_SYNC_STEP
+  #define PJON_TIME_SYNC_STEP     10000
+#endif
+
+/* Each offset error is divided by PJON_TIME_SYNC_GAIN to correct the offset
+   and the path delay, and by PJON_TIME_SYNC_DRIFT_GAIN to correct the drift */
+#ifndef PJON_TIME_SYNC_GAIN
+  #define PJON_TIME_SYNC_GAIN         4
+#endif
+#ifndef PJON_TIME_SYNC_DRIFT_GAIN
+  #define PJON_TIME_SYNC_DRIFT_GAIN  16
+#endif
+
 struct PJON_Packet {
   uint8_t  attempts;
   char     content[PJON_PACKET_MAX_LENGTH];
@@ -191,6 +440,17 @@ struct PJON_Packet {
   uint32_t registration;
   uint16_t state;
   uint32_t timing;
+  #if(PJON_INCLUDE_PACKET_TIME)
+    uint32_t dispatch_time;
+    uint32_t first_attempt;
+  #endif
+  #if(PJON_INCLUDE_ASYNC_ACK_RTT)
+    uint32_t rto;          // Retransmission timeout, 0 if not estimated
+    uint32_t transmission; // Time of the last transmission
+  #endif
+  #if(PJON_INCLUDE_STATS)
+    uint32_t attempt_end;  // Time the last unsuccessful attempt ended
+  #endif
 };
 
 struct PJON_Packet_Record {
@@ -200,16 +460,73 @@ struct PJON_Packet_Record {
   uint8_t  sender_bus_id[4];
 };
 
+/* Asynchronous acknowledgement round trip time estimation of a recipient
+   (see PJON_INCLUDE_ASYNC_ACK_RTT), microseconds */
+struct PJON_RTT_Estimate {
+  uint8_t  id = PJON_NOT_ASSIGNED; // Recipient, PJON_NOT_ASSIGNED if unused
+  uint8_t  bus_id[4];
+  uint32_t srtt = 0;               // Smoothed round trip time
+  uint32_t rttvar = 0;             // Round trip time variation
+};
+
+/* Bus statistics (see PJON_INCLUDE_STATS) */
+struct PJON_Stats {
+  uint32_t packets_sent;      // Transmissions, retries included
+  uint32_t bytes_sent;
+  uint32_t packets_received;  // Packets received with a valid CRC
+  uint32_t bytes_received;
+  uint32_t crc8_errors;       // Header or CRC8 check failures
+  uint32_t crc32_errors;
+  uint32_t acks;              // Transmissions acknowledged
+  uint32_t naks;              // Transmissions negatively acknowledged
+  uint32_t busy;              // Transmissions avoided or collided
+  uint32_t fails;             // Transmissions without response
+  uint32_t retries;           // Transmissions after the first of a packet
+  uint32_t back_off_time;     // Microseconds spent in back-off by packets
+  uint32_t connection_lost;   // Packets dropped after max attempts
+  uint32_t buffer_full;       // Packets refused because the buffer was full
+  uint16_t queue_high_water;  // Maximum number of packets in buffer
+  uint32_t attempts[PJON_STATS_ATTEMPTS];
+  uint32_t latency[PJON_STATS_LATENCY_BUCKETS];
+};
+
 /* Last received packet Metainfo */
 struct PJON_Packet_Info {
   uint16_t header = 0;
   uint16_t id = 0;
+  uint16_t length = 0; // Length of the whole packet, overhead included
   uint8_t receiver_id = 0;
   uint8_t receiver_bus_id[4];
   uint8_t sender_id = 0;
   uint8_t sender_bus_id[4];
+  #if(PJON_INCLUDE_PACKET_TIME)
+    /* PJON_MICROS time the packet started to arrive, the kernel timestamp
+       if the strategy supports it or the time its first bytes were read */
+    uint32_t receive_time = 0;
+  #endif
 };
 
+#if(PJON_INCLUDE_PACKET_TIME)
+  /* Times of a packet of the send list (PJON_MICROS): */
+  struct PJON_Packet_Time {
+    uint32_t dispatch;      // Added to the send list (or rescheduled)
+    uint32_t first_attempt; // First transmission started
+    uint32_t completion;    // Acknowledged or given up
+  };
+
+  typedef void (* PJON_Completion)(
+    uint16_t result,
+    const PJON_Packet_Info &packet_info,
+    const PJON_Packet_Time &packet_time
+  );
+
+  static void PJON_dummy_completion_handler(
+    uint16_t result,
+    const PJON_Packet_Info &packet_info,
+    const PJON_Packet_Time &packet_time
+  ) {};
+#endif
+
 typedef void (* PJON_Receiver)(
   uint8_t *payload,
   uint16_t length,
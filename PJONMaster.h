@@ -47,15 +47,18 @@ limitations under the License. */
 
 /* Reference to device */
 struct Device_reference {
-  uint8_t  packet_index = 0;
-  uint32_t registration = 0;
   uint32_t rid          = 0;
+  uint32_t registration = 0;
+  uint8_t  packet_index = 0;
   bool     state        = 0;
 };
 
 template<typename Strategy = SoftwareBitBang>
 class PJONMaster : public PJON<Strategy> {
   public:
+    /* Device table, ids[id - 1] refers to id, to be modified only with
+       add_id, reserve_id, confirm_id and delete_id_reference that keep the
+       rid index and the free ids bitmap updated */
     Device_reference ids[PJON_MAX_DEVICES];
     uint8_t required_config =
       PJON_ADDRESS_BIT | PJON_TX_INFO_BIT | PJON_CRC_BIT;
@@ -90,19 +93,39 @@ class PJONMaster : public PJON<Strategy> {
     /* Add a device reference: */
 
     bool add_id(uint8_t id, uint32_t rid, bool state) {
-      if(!ids[id - 1].state && !ids[id - 1].rid) {
-        ids[id - 1].rid = rid;
-        ids[id - 1].state = state;
-        return true;
-      }
-      return false;
+      if(!id || id > PJON_MAX_DEVICES) return false;
+      if(ids[id - 1].state || ids[id - 1].rid) return false;
+      if(rid && (get_id_from_rid(rid) != PJON_NOT_ASSIGNED)) return false;
+      ids[id - 1].rid = rid;
+      ids[id - 1].state = state;
+      use_id(id, rid);
+      PJON_REGISTRY_STORE(this, id);
+      return true;
     };
 
 
     /* Confirm a device id sending a repeated broadcast containing:
-    PJON_ID_REQUEST - RID (4 byte random id) - DEVICE ID (the new assigned) */
+    PJON_ID_REQUEST - RID (4 byte random id) - DEVICE ID (the new assigned)
+    If PJON_INCLUDE_ID_BATCH is true the id is only reserved, the assignment
+    is broadcasted by update along with the other pending ones: */
 
     void approve_id(uint8_t id, uint8_t *b_id, uint32_t rid) {
+    #if(PJON_INCLUDE_ID_BATCH)
+      /* A request from a rid already registered means its device has not
+         received or confirmed the assignment, it is granted again */
+      uint8_t known = get_id_from_rid(rid);
+      if(known == PJON_NOT_ASSIGNED) {
+        reserve_id(rid);
+        return;
+      }
+      ids[known - 1].registration = PJON_MICROS();
+      if(ids[known - 1].state) {
+        ids[known - 1].state = false;
+        _active_count--;
+        if(!_reserved_count++) _oldest_reservation = PJON_MICROS();
+        PJON_REGISTRY_STORE(this, known);
+      }
+    #else
       char response[6];
       uint16_t state = reserve_id(rid);
       if(state == PJON_DEVICES_BUFFER_FULL) return;
@@ -115,7 +138,7 @@ class PJONMaster : public PJON<Strategy> {
       response[4] = (uint32_t)(rid);
       response[5] = state;
 
-      ids[response[5] - 1].packet_index = PJON<Strategy>::send_repeatedly(
+      ids[state - 1].packet_index = PJON<Strategy>::send_repeatedly(
         PJON_BROADCAST,
         b_id,
         response,
@@ -123,27 +146,44 @@ class PJONMaster : public PJON<Strategy> {
         PJON_ID_REQUEST_INTERVAL,
         PJON<Strategy>::config | required_config
       );
+    #endif
     };
 
 
-    /* Master begin function: */
+    /* Master begin function, it returns immediately, the ids are listed
+       by the following update calls (see list_ids). If the device table is
+       restored from the registry the ids are probed instead: */
 
     void begin() {
       PJON<Strategy>::begin();
+      #if(PJON_INCLUDE_REGISTRY)
+        if(PJON_REGISTRY_LOAD(this)) {
+          _probe_id = 1;
+          return;
+        }
+      #endif
       list_ids();
     };
 
 
-    /* Confirm device ID insertion in list: */
+    /* Confirm device ID insertion in list (a repeated confirmation of an
+       active id is accepted): */
 
     bool confirm_id(uint32_t rid, uint8_t id) {
+      if(!id || id > PJON_MAX_DEVICES) return false;
+      if(ids[id - 1].rid == rid && ids[id - 1].state) return true;
       if(ids[id - 1].rid == rid && !ids[id - 1].state) {
         if(
           (uint32_t)(PJON_MICROS() - ids[id - 1].registration) <
           PJON_ADDRESSING_TIMEOUT
         ) {
           ids[id - 1].state = true;
-          PJON<Strategy>::remove(ids[id - 1].packet_index);
+          _reserved_count--;
+          _active_count++;
+          #if(!PJON_INCLUDE_ID_BATCH)
+            PJON<Strategy>::remove(ids[id - 1].packet_index);
+          #endif
+          PJON_REGISTRY_STORE(this, id);
           return true;
         }
       }
@@ -154,10 +194,7 @@ class PJONMaster : public PJON<Strategy> {
     /* Count active devices: */
 
     uint8_t count_active_ids() {
-      uint8_t result = 0;
-      for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
-        if(ids[i].state) result++;
-      return result;
+      return _active_count;
     };
 
 
@@ -166,20 +203,31 @@ class PJONMaster : public PJON<Strategy> {
     void delete_id_reference(uint8_t id = 0) {
       if(!id) {
         for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++) {
-          if(!ids[i].state && ids[i].rid)
-            this->remove(ids[i].packet_index);
+          #if(!PJON_INCLUDE_ID_BATCH)
+            if(!ids[i].state && ids[i].rid)
+              this->remove(ids[i].packet_index);
+          #endif
           ids[i].packet_index = 0;
           ids[i].registration = 0;
           ids[i].rid = 0;
           ids[i].state = false;
         }
-      } else if(id > 0 && id < PJON_MAX_DEVICES) {
-        if(!ids[id - 1].state && ids[id - 1].rid)
-          this->remove(ids[id - 1].packet_index);
+        memset(_rid_index, 0, sizeof(_rid_index));
+        memset(_used_ids, 0, sizeof(_used_ids));
+        _active_count = 0;
+        _reserved_count = 0;
+        PJON_REGISTRY_STORE(this, 0);
+      } else if(id <= PJON_MAX_DEVICES) {
+        #if(!PJON_INCLUDE_ID_BATCH)
+          if(!ids[id - 1].state && ids[id - 1].rid)
+            this->remove(ids[id - 1].packet_index);
+        #endif
+        if(ids[id - 1].state || ids[id - 1].rid) free_id(id);
         ids[id - 1].packet_index = 0;
         ids[id - 1].registration = 0;
         ids[id - 1].rid   = 0;
         ids[id - 1].state = false;
+        PJON_REGISTRY_STORE(this, id);
       }
     };
 
@@ -198,24 +246,33 @@ class PJONMaster : public PJON<Strategy> {
     };
 
 
-    /* Remove reserved id which expired (Remove never confirmed ids): */
+    /* Remove reserved id which expired (Remove never confirmed ids),
+       the table is scanned only when the oldest reservation expires: */
 
     void free_reserved_ids_expired() {
+      if(!_reserved_count) return;
+      uint32_t now = PJON_MICROS();
+      if((uint32_t)(now - _oldest_reservation) < PJON_ADDRESSING_TIMEOUT)
+        return;
+      uint32_t oldest = 0;
       for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
-        if(!ids[i].state && ids[i].rid)
-          if(
-            (uint32_t)(PJON_MICROS() - ids[i].registration) <
-            PJON_ADDRESSING_TIMEOUT
-          ) continue;
-          else delete_id_reference(i + 1);
+        if(!ids[i].state && ids[i].rid) {
+          uint32_t elapsed = now - ids[i].registration;
+          if(elapsed >= PJON_ADDRESSING_TIMEOUT) delete_id_reference(i + 1);
+          else if(elapsed >= oldest) {
+            oldest = elapsed;
+            _oldest_reservation = ids[i].registration;
+          }
+        }
     };
 
 
     /* Get DEVICE ID from RID: */
 
     uint8_t get_id_from_rid(uint32_t rid) {
-      for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
-        if(rid == ids[i].rid) return i + 1;
+      if(!rid) return PJON_NOT_ASSIGNED;
+      for(uint16_t i = rid_hash(rid); _rid_index[i]; i = rid_next(i))
+        if(ids[_rid_index[i] - 1].rid == rid) return _rid_index[i];
       return PJON_NOT_ASSIGNED;
     };
 
@@ -223,36 +280,65 @@ class PJONMaster : public PJON<Strategy> {
     /* Check for device rid uniqueness in the reference buffer: */
 
     bool unique_rid(uint32_t rid) {
-      for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
-        if(ids[i].rid == rid) return false;
-      return true;
+      return get_id_from_rid(rid) == PJON_NOT_ASSIGNED;
     };
 
 
-    /* Broadcast a PJON_ID_LIST request to all devices: */
+    /* Start listing the ids, update broadcasts a PJON_ID_LIST request
+       every PJON_LIST_IDS_TIME for PJON_ADDRESSING_TIMEOUT, the active
+       devices answer with a PJON_ID_REFRESH handled by receive: */
 
     void list_ids() {
-      uint32_t time = PJON_MICROS();
+      _list_start = PJON_MICROS();
+      _list_time = _list_start - PJON_LIST_IDS_TIME; // Sent by next update
+      _listing = true;
+    };
+
+
+    /* Check if the ids are being listed: */
+
+    bool listing_ids() {
+      return _listing;
+    };
+
+
+    /* Broadcast a PJON_ID_LIST request if PJON_LIST_IDS_TIME elapsed since
+       the previous one, end the listing after PJON_ADDRESSING_TIMEOUT: */
+
+    void update_list_ids() {
+      uint32_t now = PJON_MICROS();
+      if((uint32_t)(now - _list_start) >= PJON_ADDRESSING_TIMEOUT) {
+        _listing = false;
+        return;
+      }
+      if((uint32_t)(now - _list_time) < PJON_LIST_IDS_TIME) return;
       char request = PJON_ID_LIST;
-      while((uint32_t)(PJON_MICROS() - time) < PJON_ADDRESSING_TIMEOUT) {
+      uint16_t header = PJON<Strategy>::config | required_config;
+      #if(PJON_INCLUDE_TDMA)
+        if(!this->fits_slot(1 + this->packet_overhead(header))) return;
+      #endif
+      if(
         PJON<Strategy>::send_packet(
           PJON_BROADCAST,
           this->bus_id,
           &request,
           1,
-          PJON<Strategy>::config | required_config
-        );
-        receive(PJON_LIST_IDS_TIME);
-      }
+          header
+        ) == PJON_ACK
+      ) _list_time = PJON_MICROS(); // Retried by the next update if failed
     };
 
 
     /* Negate a device id request sending a packet to the device containing
-       ID_NEGATE forcing the slave to make a new request. */
+       ID_NEGATE forcing the slave to make a new request. The packet is
+       dispatched by update. */
 
     void negate_id(uint8_t id, uint8_t *b_id, uint32_t rid) {
-      char response[5] = { PJON_ID_NEGATE, rid >> 24, rid >> 16, rid >> 8, rid};
-      PJON<Strategy>::send_packet_blocking(
+      char response[5] = {
+        (char)PJON_ID_NEGATE,
+        (char)(rid >> 24), (char)(rid >> 16), (char)(rid >> 8), (char)rid
+      };
+      PJON<Strategy>::send(
         id,
         b_id,
         response,
@@ -265,16 +351,18 @@ class PJONMaster : public PJON<Strategy> {
     /* Reserve a device id and wait for its confirmation: */
 
     uint16_t reserve_id(uint32_t rid) {
-      if(!unique_rid(rid)) return PJON_FAIL;
-      for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
-        if(!ids[i].state && !ids[i].rid) {
-          ids[i].registration = PJON_MICROS();
-          ids[i].rid = rid;
-          ids[i].state = false;
-          return i + 1;
-        }
-      _master_error(PJON_DEVICES_BUFFER_FULL, PJON_MAX_DEVICES);
-      return PJON_DEVICES_BUFFER_FULL;
+      if(!rid || !unique_rid(rid)) return PJON_FAIL;
+      uint8_t id = first_free_id();
+      if(id == PJON_NOT_ASSIGNED) {
+        _master_error(PJON_DEVICES_BUFFER_FULL, PJON_MAX_DEVICES);
+        return PJON_DEVICES_BUFFER_FULL;
+      }
+      ids[id - 1].registration = PJON_MICROS();
+      ids[id - 1].rid = rid;
+      ids[id - 1].state = false;
+      use_id(id, rid);
+      PJON_REGISTRY_STORE(this, id);
+      return id;
     };
 
 
@@ -284,10 +372,22 @@ class PJONMaster : public PJON<Strategy> {
       _current_pjon_master = this;
       uint16_t received_data = PJON<Strategy>::receive();
       if(received_data != PJON_ACK) return received_data;
+      #if(PJON_INCLUDE_TIME_SYNC)
+        uint32_t time = this->strategy_receive_time(this->strategy, 0);
+      #endif
 
       uint8_t overhead = PJON<Strategy>::packet_overhead(this->data[1]);
       uint8_t CRC_overhead = (this->data[1] & PJON_CRC_BIT) ? 4 : 1;
 
+      #if(PJON_INCLUDE_REGISTRY)
+        if(
+          (this->last_packet_info.header & PJON_TX_INFO_BIT) &&
+          this->last_packet_info.sender_id &&
+          (this->last_packet_info.sender_id <= PJON_MAX_DEVICES) &&
+          ids[this->last_packet_info.sender_id - 1].state
+        ) PJON_REGISTRY_SEEN(this, this->last_packet_info.sender_id);
+      #endif
+
       if(
         (this->last_packet_info.header & PJON_ADDRESS_BIT) &&
         (this->last_packet_info.header & PJON_TX_INFO_BIT) &&
@@ -315,8 +415,11 @@ class PJONMaster : public PJON<Strategy> {
               rid
             );
 
-        if(request == PJON_ID_REFRESH)
-          if(!add_id(this->data[(overhead - CRC_overhead) + 5], rid, 1))
+        if(request == PJON_ID_REFRESH) // Accepted if already registered
+          if(
+            !add_id(this->data[(overhead - CRC_overhead) + 5], rid, 1) &&
+            !confirm_id(rid, this->data[(overhead - CRC_overhead) + 5])
+          )
             negate_id(
               this->last_packet_info.sender_id,
               this->last_packet_info.sender_bus_id,
@@ -328,13 +431,23 @@ class PJONMaster : public PJON<Strategy> {
             this->data[(overhead - CRC_overhead) + 5] ==
             this->last_packet_info.sender_id
           )
-            if(rid == ids[this->last_packet_info.sender_id - 1].rid)
+            if(get_id_from_rid(rid) == this->last_packet_info.sender_id)
               if(
                 this->bus_id_equality(
                   this->last_packet_info.sender_bus_id,
                   this->bus_id
                 )
               ) delete_id_reference(this->last_packet_info.sender_id);
+
+        #if(PJON_INCLUDE_TIME_SYNC)
+          if(request == PJON_TIME_REQUEST)
+            respond_time(
+              this->last_packet_info.sender_id,
+              this->last_packet_info.sender_bus_id,
+              this->data[(overhead - CRC_overhead) + 1],
+              time
+            );
+        #endif
       }
 
       _master_receiver(
@@ -375,12 +488,332 @@ class PJONMaster : public PJON<Strategy> {
     uint8_t update() {
       free_reserved_ids_expired();
       _current_pjon_master = this;
+      #if(PJON_INCLUDE_TDMA)
+        this->_slot_confined = _tdma_length;
+        if(_tdma_length) {
+          if(
+            (uint32_t)(PJON_MICROS() - _tdma_start) >=
+            _tdma_length * _tdma_slots
+          ) send_beacon();
+          this->_slot_end = _tdma_start + _tdma_length - PJON_TDMA_GUARD;
+        }
+      #endif
+      if(_listing) update_list_ids();
+      #if(PJON_INCLUDE_REGISTRY)
+        if(_probe_id) update_probes();
+      #endif
+      #if(PJON_INCLUDE_ID_BATCH)
+        if(
+          _reserved_count &&
+          ((uint32_t)(PJON_MICROS() - _grants_time) >= PJON_ID_REQUEST_INTERVAL)
+        ) send_grants();
+      #endif
+      #if(PJON_INCLUDE_TIME_SYNC)
+        if(
+          _sync_interval &&
+          ((uint32_t)(PJON_MICROS() - _sync_time) >= _sync_interval)
+        ) send_time_sync();
+      #endif
       return PJON<Strategy>::update();
     };
 
+  #if(PJON_INCLUDE_REGISTRY)
+    /* Probe the next id restored from the registry if
+       PJON_REGISTRY_PROBE_INTERVAL elapsed since the previous probe. The
+       probe is a PJON_ID_LIST sent to the device requesting acknowledgement,
+       if it is never acknowledged the id is removed by error_handler: */
+
+    void update_probes() {
+      if((uint32_t)(PJON_MICROS() - _probe_time) < PJON_REGISTRY_PROBE_INTERVAL)
+        return;
+      while((_probe_id <= PJON_MAX_DEVICES) && !ids[_probe_id - 1].state)
+        _probe_id++;
+      if(_probe_id > PJON_MAX_DEVICES) {
+        _probe_id = 0; // All probed
+        return;
+      }
+      char request = PJON_ID_LIST;
+      if(
+        PJON<Strategy>::send(
+          _probe_id,
+          this->bus_id,
+          &request,
+          1,
+          PJON<Strategy>::config | PJON_ACK_REQ_BIT | required_config
+        ) == PJON_FAIL
+      ) return; // Retried by the next update if the buffer is full
+      _probe_id++;
+      _probe_time = PJON_MICROS();
+    };
+  #endif
+
+  #if(PJON_INCLUDE_ID_BATCH)
+    /* Broadcast a PJON_ID_GRANTS containing:
+       PENDING (reserved ids count) - RID (4 bytes) - DEVICE ID, repeated
+       If the reserved ids do not fit in a packet the following broadcasts
+       list the ones left out: */
+
+    void send_grants() {
+      char grants[PJON_PACKET_MAX_LENGTH];
+      uint16_t header =
+        (PJON<Strategy>::config | required_config) & ~PJON_ACK_MODE_BIT;
+      uint16_t max = PJON_PACKET_MAX_LENGTH - this->packet_overhead(header);
+      uint16_t length = 2;
+      uint8_t next = 0;
+      grants[0] = PJON_ID_GRANTS;
+      grants[1] = _reserved_count;
+      for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++) {
+        uint8_t id = (_grants_first + i) % PJON_MAX_DEVICES;
+        if(ids[id].state || !ids[id].rid) continue;
+        if(length + 5 > max) {
+          next = id;
+          break;
+        }
+        grants[length++] = ids[id].rid >> 24;
+        grants[length++] = ids[id].rid >> 16;
+        grants[length++] = ids[id].rid >>  8;
+        grants[length++] = ids[id].rid;
+        grants[length++] = id + 1;
+      }
+      #if(PJON_INCLUDE_TDMA)
+        if(!this->fits_slot(length + this->packet_overhead(header))) return;
+      #endif
+      if(
+        PJON<Strategy>::send_packet(
+          PJON_BROADCAST,
+          this->bus_id,
+          grants,
+          length,
+          header
+        ) != PJON_ACK
+      ) return; // Retried by the next update
+      _grants_first = next;
+      _grants_time = PJON_MICROS();
+    };
+  #endif
+
+  #if(PJON_INCLUDE_TIME_SYNC)
+    /* Broadcast a PJON_TIME_SYNC every interval microseconds (0 to stop),
+       slaves use them to synchronize their clock with the master's: */
+
+    void set_time_sync(uint32_t interval) {
+      _sync_interval = interval;
+      _sync_time = PJON_MICROS() - interval; // Sent by the next update
+    };
+
+
+    /* Broadcast a PJON_TIME_SYNC containing:
+       SEQUENCE - TIME (4 bytes, end of the transmission of the previous one)
+       The time a frame is transmitted is known only after it is sent, so each
+       sync carries the time of the previous (as PTP two-step clocks do) */
+
+    void send_time_sync() {
+      char sync[6] = {
+        (char)PJON_TIME_SYNC,
+        (char)(_sync_seq + 1),
+        (char)(_sync_time >> 24),
+        (char)(_sync_time >> 16),
+        (char)(_sync_time >>  8),
+        (char)(_sync_time)
+      };
+      uint16_t header =
+        (PJON<Strategy>::config | required_config) & ~PJON_ACK_MODE_BIT;
+      #if(PJON_INCLUDE_TDMA)
+        if(!this->fits_slot(6 + this->packet_overhead(header))) return;
+      #endif
+      if(
+        PJON<Strategy>::send_packet(
+          PJON_BROADCAST,
+          this->bus_id,
+          sync,
+          6,
+          header
+        ) != PJON_ACK
+      ) return; // Retried by the next update
+      _sync_time = PJON_MICROS();
+      _sync_seq++;
+    };
+
+
+    /* Respond to a PJON_TIME_REQUEST with a PJON_TIME_RESPONSE containing:
+       SEQUENCE (the request's) - TIME (4 bytes, end of the request) */
+
+    void respond_time(
+      uint8_t id,
+      const uint8_t *b_id,
+      uint8_t seq,
+      uint32_t t
+    ) {
+      char response[6] = {
+        (char)PJON_TIME_RESPONSE,
+        (char)seq,
+        (char)(t >> 24),
+        (char)(t >> 16),
+        (char)(t >>  8),
+        (char)(t)
+      };
+      PJON<Strategy>::send(
+        id,
+        b_id,
+        response,
+        6,
+        PJON<Strategy>::config | required_config
+      );
+    };
+  #endif
+
+  #if(PJON_INCLUDE_TDMA)
+    /* Enable or disable the TDMA schedule passing the slot length in
+       microseconds, if 0 it is derived from the strategy's byte time to
+       contain a frame of PJON_PACKET_MAX_LENGTH bytes and its response.
+       Returns false if the slot length is not known: */
+
+    bool set_tdma(bool state, uint32_t slot_length = 0) {
+      if(!slot_length && this->transmission_time(PJON_PACKET_MAX_LENGTH))
+        slot_length =
+          this->transmission_time(PJON_PACKET_MAX_LENGTH) + PJON_TDMA_GUARD;
+      if(state && !slot_length) return false;
+      _tdma_length = state ? slot_length : 0;
+      _tdma_slots = 0; // The first beacon is sent by the next update
+      return true;
+    };
+
+
+    /* Broadcast a PJON_TDMA_BEACON containing:
+       SLOT LENGTH (4 bytes) - COUNT - IDS (count bytes, one per slot)
+       A slot is assigned to each active device, if the ids do not fit in a
+       packet the following beacons list the ones left out: */
+
+    void send_beacon() {
+      char beacon[PJON_PACKET_MAX_LENGTH];
+      uint16_t header = PJON<Strategy>::config | required_config;
+      uint16_t max =
+        PJON_PACKET_MAX_LENGTH - 6 - this->packet_overhead(header);
+      uint8_t count = 0, next = 0;
+      beacon[0] = PJON_TDMA_BEACON;
+      beacon[1] = _tdma_length >> 24;
+      beacon[2] = _tdma_length >> 16;
+      beacon[3] = _tdma_length >>  8;
+      beacon[4] = _tdma_length;
+      for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++) {
+        uint8_t id = (_tdma_first + i) % PJON_MAX_DEVICES;
+        if(!ids[id].state) continue;
+        if(count == max) {
+          next = id;
+          break;
+        }
+        beacon[6 + count++] = id + 1;
+      }
+      beacon[5] = count;
+      if(
+        PJON<Strategy>::send_packet(
+          PJON_BROADCAST,
+          this->bus_id,
+          beacon,
+          count + 6,
+          header
+        ) != PJON_ACK
+      ) return; // Retried by the next update
+      _tdma_first = next;
+      _tdma_slots = count + 2;
+      _tdma_start = PJON_MICROS();
+    };
+  #endif
+
   private:
+    uint8_t         _active_count = 0;
+    bool            _listing = false;
+    uint32_t        _list_start = 0;
+    uint32_t        _list_time = 0;
     PJON_Receiver   _master_receiver;
     PJON_Error      _master_error;
+    uint32_t        _oldest_reservation = 0;
+    uint8_t         _reserved_count = 0;
+    uint8_t         _rid_index[PJON_RID_INDEX_LENGTH]; // Id, 0 if empty
+    uint8_t         _used_ids[(PJON_MAX_DEVICES + 7) / 8]; // Bit per id
+
+    /* The rid index is an open addressing hash table with linear probing: */
+
+    static uint16_t rid_hash(uint32_t rid) {
+      return ((uint32_t)(rid * 2654435761UL) >> 16) &
+        (PJON_RID_INDEX_LENGTH - 1);
+    };
+
+    static uint16_t rid_next(uint16_t i) {
+      return (i + 1) & (PJON_RID_INDEX_LENGTH - 1);
+    };
+
+
+    /* Find the lowest id neither reserved nor active in the bitmap: */
+
+    uint8_t first_free_id() {
+      for(uint8_t b = 0; b < sizeof(_used_ids); b++)
+        if(_used_ids[b] != 0xFF)
+          for(uint8_t i = 0; i < 8; i++)
+            if(!(_used_ids[b] & (1 << i))) {
+              uint16_t id = (b * 8) + i + 1;
+              return (id <= PJON_MAX_DEVICES) ? id : PJON_NOT_ASSIGNED;
+            }
+      return PJON_NOT_ASSIGNED;
+    };
+
+
+    /* Register an id just filled in the table in bitmap, index and
+       counters: */
+
+    void use_id(uint8_t id, uint32_t rid) {
+      _used_ids[(id - 1) / 8] |= 1 << ((id - 1) % 8);
+      if(ids[id - 1].state) _active_count++;
+      else if(!_reserved_count++)
+        _oldest_reservation = ids[id - 1].registration;
+      if(!rid) return;
+      uint16_t i = rid_hash(rid);
+      while(_rid_index[i]) i = rid_next(i);
+      _rid_index[i] = id;
+    };
+
+
+    /* Remove an id still present in the table from bitmap, index and
+       counters, the following entries of the index are shifted back to
+       avoid tombstones: */
+
+    void free_id(uint8_t id) {
+      _used_ids[(id - 1) / 8] &= ~(1 << ((id - 1) % 8));
+      if(ids[id - 1].state) _active_count--;
+      else _reserved_count--;
+      if(!ids[id - 1].rid) return;
+      uint16_t i = rid_hash(ids[id - 1].rid);
+      while(_rid_index[i] && _rid_index[i] != id) i = rid_next(i);
+      if(!_rid_index[i]) return;
+      for(uint16_t j = rid_next(i); _rid_index[j]; j = rid_next(j)) {
+        uint16_t home = rid_hash(ids[_rid_index[j] - 1].rid);
+        if(((j - home) & (PJON_RID_INDEX_LENGTH - 1)) >=
+           ((j - i) & (PJON_RID_INDEX_LENGTH - 1))) {
+          _rid_index[i] = _rid_index[j];
+          i = j;
+        }
+      }
+      _rid_index[i] = 0;
+    };
+  #if(PJON_INCLUDE_REGISTRY)
+    uint16_t        _probe_id = 0; // Next id to probe, 0 if none
+    uint32_t        _probe_time = 0;
+  #endif
+  #if(PJON_INCLUDE_ID_BATCH)
+    uint8_t         _grants_first = 0;
+    uint32_t        _grants_time = 0;
+  #endif
+  #if(PJON_INCLUDE_TIME_SYNC)
+    uint32_t        _sync_interval = 0;
+    uint8_t         _sync_seq = 0;
+    uint32_t        _sync_time = 0;
+  #endif
+  #if(PJON_INCLUDE_TDMA)
+    uint8_t         _tdma_first = 0;
+    uint32_t        _tdma_length = 0;
+    uint8_t         _tdma_slots = 0;
+    uint32_t        _tdma_start = 0;
+  #endif
     static PJONMaster<Strategy> *_current_pjon_master;
 };
 
@@ -101,6 +101,9 @@ class PJONSlave : public PJON<Strategy> {
     /* Acquire an id in multi-master configuration: */
 
     void acquire_id_multi_master(uint8_t limit = 0) {
+    #if(PJON_INCLUDE_ID_CLAIM)
+      if(!claim_id()) _slave_error(PJON_ID_ACQUISITION_FAIL, PJON_FAIL);
+    #else
       if(limit >= PJON_MAX_ACQUIRE_ID_COLLISIONS)
         return _slave_error(PJON_ID_ACQUISITION_FAIL, PJON_FAIL);
 
@@ -108,12 +111,12 @@ class PJONSlave : public PJON<Strategy> {
       uint32_t time = PJON_MICROS();
       char msg = PJON_ID_ACQUIRE;
       char head = this->config | required_config | PJON_ACK_REQ_BIT;
-      this->_device_id = PJON_NOT_ASSIGNED;
+      this->set_id(PJON_NOT_ASSIGNED);
       for(
         uint8_t id;
         ((uint32_t)(PJON_MICROS() - time) < PJON_ID_SCAN_TIME);
       ) {
-        id = PJON_RANDOM(1, PJON_MAX_DEVICES);
+        id = random_below(PJON_MAX_DEVICES) + 1;
         if(
           id == PJON_NOT_ASSIGNED ||
           id == PJON_MASTER_ID ||
@@ -128,7 +131,7 @@ class PJONSlave : public PJON<Strategy> {
             head
           ) == PJON_FAIL
         ) {
-          this->_device_id = id;
+          this->set_id(id);
           break;
         }
       }
@@ -141,14 +144,41 @@ class PJONSlave : public PJON<Strategy> {
           1,
           head
         ) == PJON_ACK
-      ) acquire_id_multi_master(limit++);
+      ) acquire_id_multi_master(limit + 1);
+    #endif
     };
 
 
     /* Acquire id in master-slave configuration: */
 
     bool acquire_id_master_slave() {
+    #if(PJON_INCLUDE_ID_BATCH)
+      /* The request is sent after a random delay within the request window,
+         if it is acknowledged the id is received with a PJON_ID_GRANTS */
+      this->set_id(PJON_NOT_ASSIGNED);
       generate_rid();
+      for(uint8_t i = 0; i < PJON_MAX_ACQUIRE_ID_COLLISIONS; i++) {
+        if(wait_id(PJON_RANDOM(_id_window))) return true;
+        if(send_id_request() == PJON_ACK) {
+          if(wait_id(PJON_ADDRESSING_TIMEOUT)) return true;
+        } else if(_id_window < (PJON_ID_REQUEST_WINDOW_MAX / 2))
+          _id_window *= 2;
+        else _id_window = PJON_ID_REQUEST_WINDOW_MAX;
+      }
+      return false;
+    #else
+      generate_rid();
+      return send_id_request() == PJON_ACK;
+    #endif
+    };
+
+
+    /* Send a PJON_ID_REQUEST containing: RID (4 bytes) */
+
+    uint16_t send_id_request() {
+      #if(PJON_INCLUDE_TDMA)
+        wait_contention_slot();
+      #endif
       char response[5];
       response[0] = PJON_ID_REQUEST;
       response[1] = (uint32_t)(_rid) >> 24;
@@ -156,15 +186,13 @@ class PJONSlave : public PJON<Strategy> {
       response[3] = (uint32_t)(_rid) >>  8;
       response[4] = (uint32_t)(_rid);
 
-      if(this->send_packet_blocking(
+      return this->send_packet_blocking(
         PJON_MASTER_ID,
         this->bus_id,
         response,
         5,
         this->config | PJON_ACK_REQ_BIT | required_config
-      ) == PJON_ACK) return true;
-
-      return false;
+      );
     };
 
 
@@ -181,7 +209,7 @@ class PJONSlave : public PJON<Strategy> {
 
     bool discard_device_id() {
       char request[6] = {
-        PJON_ID_NEGATE,
+        (char)PJON_ID_NEGATE,
         _rid >> 24,
         _rid >> 16,
         _rid >> 8,
@@ -196,7 +224,7 @@ class PJONSlave : public PJON<Strategy> {
         6,
         this->config | PJON_ACK_REQ_BIT | required_config
       ) == PJON_ACK) {
-        this->_device_id = PJON_NOT_ASSIGNED;
+        this->set_id(PJON_NOT_ASSIGNED);
         return true;
       }
       return false;
@@ -218,7 +246,7 @@ class PJONSlave : public PJON<Strategy> {
     /* Generate a new device rid: */
     void generate_rid() {
       _rid = (
-        (uint32_t)(PJON_RANDOM()) ^
+        (uint32_t)(PJON_RANDOM(0x7FFFFFFF)) ^
         (uint32_t)(PJON_ANALOG_READ(this->random_seed)) ^
         (uint32_t)(PJON_MICROS())
       ) ^ _rid ^ _last_request_time;
@@ -231,6 +259,30 @@ class PJONSlave : public PJON<Strategy> {
 
 
     bool handle_addressing() {
+      #if(PJON_INCLUDE_ID_CLAIM)
+        if( // Defend the device id if claimed by another device
+          (this->last_packet_info.header & PJON_ADDRESS_BIT) &&
+          (this->last_packet_info.header & PJON_TX_INFO_BIT) &&
+          (this->last_packet_info.header & PJON_CRC_BIT)
+        ) {
+          const uint8_t *payload = this->data +
+            this->packet_overhead(this->last_packet_info.header) - 4;
+          if(payload[0] == PJON_ID_CLAIM || payload[0] == PJON_ID_DEFEND) {
+            if(
+              (payload[0] == PJON_ID_CLAIM) &&
+              (payload[1] == this->_device_id) &&
+              (this->_device_id != PJON_NOT_ASSIGNED)
+            ) {
+              uint32_t time = PJON_MICROS();
+              while(
+                (send_claim(PJON_ID_DEFEND, this->_device_id) == PJON_BUSY) &&
+                ((uint32_t)(PJON_MICROS() - time) < PJON_ID_CLAIM_TIME)
+              ) PJON_DELAY_MICROSECONDS(PJON_RANDOM(PJON_ACQUIRE_ID_DELAY));
+            }
+            return true;
+          }
+        }
+      #endif
       if( // Detect mult-master dynamic addressing
         (this->last_packet_info.header & PJON_ADDRESS_BIT) &&
         (this->last_packet_info.header & PJON_TX_INFO_BIT) &&
@@ -289,6 +341,29 @@ class PJONSlave : public PJON<Strategy> {
             ) && this->_device_id == this->data[0]
           ) acquire_id();
 
+        #if(PJON_INCLUDE_ID_BATCH)
+          if(this->data[overhead - CRC_overhead] == PJON_ID_GRANTS)
+            handle_grants(
+              this->data + (overhead - CRC_overhead) + 1,
+              this->last_packet_info.length - overhead - 1
+            );
+        #endif
+
+        #if(PJON_INCLUDE_TDMA)
+          if(this->data[overhead - CRC_overhead] == PJON_TDMA_BEACON)
+            handle_beacon(
+              this->data + (overhead - CRC_overhead) + 1,
+              this->last_packet_info.length - overhead - 1
+            );
+        #endif
+
+        #if(PJON_INCLUDE_TIME_SYNC)
+          if(this->data[overhead - CRC_overhead] == PJON_TIME_SYNC)
+            handle_time_sync(this->data + (overhead - CRC_overhead) + 1);
+          if(this->data[overhead - CRC_overhead] == PJON_TIME_RESPONSE)
+            handle_time_response(this->data + (overhead - CRC_overhead) + 1);
+        #endif
+
         if(this->data[overhead - CRC_overhead] == PJON_ID_LIST)
           if(this->_device_id != PJON_NOT_ASSIGNED)
             if(
@@ -319,13 +394,16 @@ class PJONSlave : public PJON<Strategy> {
       _current_pjon_slave = this;
       uint16_t received_data = PJON<Strategy>::receive();
       if(received_data != PJON_ACK) return received_data;
+      #if(PJON_INCLUDE_TIME_SYNC)
+        _receive_time = this->strategy_receive_time(this->strategy, 0);
+      #endif
 
       uint8_t overhead = this->packet_overhead(this->data[1]);
 
       if(!handle_addressing())
         _slave_receiver(
           this->data + (overhead - (this->data[1] & PJON_CRC_BIT ? 4 : 1)),
-          this->data[this->data[1] & PJON_EXT_HEAD_BIT ? 3 : 2] - overhead,
+          this->last_packet_info.length - overhead,
           this->last_packet_info
         );
 
@@ -361,15 +439,464 @@ class PJONSlave : public PJON<Strategy> {
 
     uint8_t update() {
       _current_pjon_slave = this;
+      #if(PJON_INCLUDE_TDMA)
+        update_slot();
+      #endif
+      #if(PJON_INCLUDE_TIME_SYNC)
+        if(
+          _request_interval && time_synchronized() &&
+          ((uint32_t)(PJON_MICROS() - _request_time) >= _request_interval)
+        ) send_time_request();
+      #endif
       return PJON<Strategy>::update();
     };
 
+  #if(PJON_INCLUDE_ID_CLAIM)
+    /* Acquire an id in multi-master configuration listening to the traffic
+       for PJON_ID_LISTEN_TIME to know the ids in use, then claiming a random
+       id not observed: if no device acknowledges its probe, and no device
+       answers to the PJON_ID_CLAIM_ATTEMPTS claims with a PJON_ID_DEFEND or
+       claims the same id, the id is taken: */
+
+    bool claim_id() {
+      uint8_t occupied[32];
+      memset(occupied, 0, sizeof(occupied));
+      this->set_id(PJON_NOT_ASSIGNED);
+      generate_rid();
+      listen_ids(occupied, PJON_ID_LISTEN_TIME, PJON_NOT_ASSIGNED);
+      for(uint8_t i = 0; i < PJON_MAX_ACQUIRE_ID_COLLISIONS; i++) {
+        uint8_t id = random_free_id(occupied);
+        if(id == PJON_NOT_ASSIGNED) return false;
+        if(probe_id(occupied, id)) occupied[id / 8] |= 1 << (id % 8);
+        bool taken = !(occupied[id / 8] & (1 << (id % 8)));
+        for(uint8_t c = 0; taken && (c < PJON_ID_CLAIM_ATTEMPTS); c++)
+          taken = listen_ids(
+            occupied,
+            PJON_ID_CLAIM_TIME / 2 + PJON_RANDOM(PJON_ID_CLAIM_TIME / 2),
+            id
+          ) && !(occupied[id / 8] & (1 << (id % 8)));
+        if(!taken) continue;
+        this->set_id(id);
+        return true;
+      }
+      return false;
+    };
+
+
+    /* Receive all the packets of the bus for duration marking as occupied
+       the ids of their senders and the ids claimed or defended. If claimed
+       is not PJON_NOT_ASSIGNED a PJON_ID_CLAIM for it is sent first and
+       duration starts when it is transmitted, if the same id is claimed
+       also by a device with a lower rid it is defended instead. Claims and
+       defences are retried while the medium is busy without missing the
+       packets received in the meantime. Returns false if the claim could
+       not be transmitted within duration: */
+
+    bool listen_ids(uint8_t *occupied, uint32_t duration, uint8_t claimed) {
+      bool router = this->_router;
+      uint8_t pending =
+        (claimed != PJON_NOT_ASSIGNED) ? PJON_ID_CLAIM : PJON_NOT_ASSIGNED;
+      uint32_t time = PJON_MICROS();
+      this->set_router(true);
+      while((uint32_t)(PJON_MICROS() - time) < duration) {
+        if(
+          (pending != PJON_NOT_ASSIGNED) &&
+          (send_claim(pending, claimed) != PJON_BUSY)
+        ) {
+          if(pending == PJON_ID_CLAIM) time = PJON_MICROS();
+          pending = PJON_NOT_ASSIGNED;
+        }
+        if(PJON<Strategy>::receive() != PJON_ACK) continue;
+        const PJON_Packet_Info &info = this->last_packet_info;
+        if(!(info.header & PJON_TX_INFO_BIT)) continue;
+        if(
+          (info.header & PJON_MODE_BIT) &&
+          !this->bus_id_equality(info.sender_bus_id, this->bus_id)
+        ) continue;
+        uint8_t id = info.sender_id;
+        if((info.header & PJON_ADDRESS_BIT) && (info.header & PJON_CRC_BIT)) {
+          const uint8_t *payload =
+            this->data + this->packet_overhead(info.header) - 4;
+          if(payload[0] == PJON_ID_CLAIM || payload[0] == PJON_ID_DEFEND) {
+            id = payload[1];
+            if(
+              (payload[0] == PJON_ID_CLAIM) && (id == claimed) &&
+              (read_rid(payload + 2) < _rid)
+            ) {
+              if(pending == PJON_NOT_ASSIGNED) pending = PJON_ID_DEFEND;
+              continue;
+            }
+          }
+        }
+        if(id && id <= PJON_MAX_DEVICES) occupied[id / 8] |= 1 << (id % 8);
+      }
+      this->set_router(router);
+      return pending != PJON_ID_CLAIM;
+    };
+
+
+    /* Pick a random id not marked as occupied, PJON_NOT_ASSIGNED if none: */
+
+    uint8_t random_free_id(const uint8_t *occupied) {
+      uint8_t count = 0;
+      for(uint8_t id = 1; id <= PJON_MAX_DEVICES; id++)
+        if(!(occupied[id / 8] & (1 << (id % 8)))) count++;
+      if(!count) return PJON_NOT_ASSIGNED;
+      uint8_t n = random_below(count);
+      for(uint8_t id = 1; id <= PJON_MAX_DEVICES; id++)
+        if(!(occupied[id / 8] & (1 << (id % 8))) && !n--) return id;
+      return PJON_NOT_ASSIGNED;
+    };
+
+
+    /* Send a PJON_ID_ACQUIRE to id PJON_ID_PROBE_ATTEMPTS times (listening
+       while the medium is busy for up to PJON_ID_CLAIM_TIME), returns true
+       if acknowledged (the id is in use): */
+
+    bool probe_id(uint8_t *occupied, uint8_t id) {
+      char msg = PJON_ID_ACQUIRE;
+      uint32_t time = PJON_MICROS();
+      for(uint8_t attempts = 0; attempts < PJON_ID_PROBE_ATTEMPTS; ) {
+        uint16_t result = this->send_packet(
+          id,
+          this->bus_id,
+          &msg,
+          1,
+          this->config | required_config | PJON_ACK_REQ_BIT
+        );
+        if(result == PJON_ACK) return true;
+        if(result != PJON_BUSY) attempts++;
+        else if((uint32_t)(PJON_MICROS() - time) >= PJON_ID_CLAIM_TIME)
+          return false;
+        else listen_ids(
+          occupied,
+          PJON_RANDOM(PJON_ACQUIRE_ID_DELAY),
+          PJON_NOT_ASSIGNED
+        );
+      }
+      return false;
+    };
+
+
+    /* Broadcast a PJON_ID_CLAIM or a PJON_ID_DEFEND containing:
+       DEVICE ID - RID (4 bytes), returns PJON_BUSY if the medium is busy */
+
+    uint16_t send_claim(uint8_t symbol, uint8_t id) {
+      char claim[6] = {
+        (char)symbol,
+        (char)id,
+        (char)(_rid >> 24),
+        (char)(_rid >> 16),
+        (char)(_rid >>  8),
+        (char)(_rid)
+      };
+      return this->send_packet(
+        PJON_BROADCAST,
+        this->bus_id,
+        claim,
+        6,
+        (this->config | required_config) &
+        ~(PJON_ACK_REQ_BIT | PJON_ACK_MODE_BIT)
+      );
+    };
+
+
+    static uint32_t read_rid(const uint8_t *b) {
+      return
+        (uint32_t)(b[0]) << 24 |
+        (uint32_t)(b[1]) << 16 |
+        (uint32_t)(b[2]) <<  8 |
+        (uint32_t)(b[3]);
+    };
+  #endif
+
+  #if(PJON_INCLUDE_ID_BATCH)
+    /* Handle a PJON_ID_GRANTS payload (symbol excluded) containing:
+       PENDING (reserved ids count) - RID (4 bytes) - DEVICE ID, repeated
+       The request window is scaled with the assignments pending, if the rid
+       is listed the id is confirmed, if the confirmation fails the id is
+       dropped and confirmed again with the next grants: */
+
+    void handle_grants(const uint8_t *payload, uint16_t length) {
+      if(!length || this->_device_id != PJON_NOT_ASSIGNED) return;
+      uint32_t window = (uint32_t)PJON_ID_REQUEST_WINDOW * (payload[0] + 1);
+      _id_window = (window < PJON_ID_REQUEST_WINDOW_MAX) ?
+        window : PJON_ID_REQUEST_WINDOW_MAX;
+      uint8_t rid[4] = {
+        (uint8_t)(_rid >> 24), (uint8_t)(_rid >> 16),
+        (uint8_t)(_rid >>  8), (uint8_t)(_rid)
+      };
+      for(uint16_t i = 1; (uint16_t)(i + 5) <= length; i += 5)
+        if(this->bus_id_equality(payload + i, rid)) {
+          char response[6] = {
+            (char)PJON_ID_CONFIRM,
+            (char)rid[0], (char)rid[1], (char)rid[2], (char)rid[3],
+            (char)payload[i + 4]
+          };
+          this->set_id(payload[i + 4]);
+          if(this->send_packet_blocking(
+            PJON_MASTER_ID,
+            this->bus_id,
+            response,
+            6,
+            this->config | PJON_ACK_REQ_BIT | required_config
+          ) != PJON_ACK) this->set_id(PJON_NOT_ASSIGNED);
+          return;
+        }
+    };
+
+
+    /* Receive until an id is assigned or duration elapses: */
+
+    bool wait_id(uint32_t duration) {
+      uint32_t time = PJON_MICROS();
+      while(
+        (this->_device_id == PJON_NOT_ASSIGNED) &&
+        ((uint32_t)(PJON_MICROS() - time) < duration)
+      ) receive();
+      return this->_device_id != PJON_NOT_ASSIGNED;
+    };
+  #endif
+
+  #if(PJON_INCLUDE_TIME_SYNC)
+    /* Master's time estimated from the PJON_TIME_SYNC broadcasts received,
+       if not synchronized PJON_MICROS() is returned: */
+
+    uint32_t sync_micros() {
+      uint32_t time = PJON_MICROS();
+      if(!time_synchronized()) return time;
+      return time + time_offset(time) + _path_delay;
+    };
+
+
+    /* Check if at least an offset sample has been received: */
+
+    bool time_synchronized() {
+      return _time_samples;
+    };
+
+
+    /* Clock drift relative to the master's in parts per million: */
+
+    int32_t get_time_drift() {
+      return ((int64_t)_time_drift * 1000000) >> 24;
+    };
+
+
+    /* Path delay (end of transmission to reception) in microseconds, 0 if
+       time requests are not sent. It can be negative if the transmitter
+       returns after the frame is already received (as on loopback): */
+
+    int32_t get_path_delay() {
+      return _path_delay;
+    };
+
+
+    /* Send a PJON_TIME_REQUEST every interval microseconds (0 to stop) to
+       measure the path delay, the master's time otherwise lags behind it: */
+
+    void set_time_request(uint32_t interval) {
+      _request_interval = interval;
+      _request_time = PJON_MICROS() - PJON_RANDOM(interval);
+    };
+
+
+    /* Send a PJON_TIME_REQUEST containing: SEQUENCE */
+
+    void send_time_request() {
+      if(this->_device_id == PJON_NOT_ASSIGNED) return;
+      char request[2] = { (char)PJON_TIME_REQUEST, (char)(_request_seq + 1) };
+      uint16_t header = (this->config | required_config) &
+        ~(PJON_ACK_REQ_BIT | PJON_ACK_MODE_BIT);
+      #if(PJON_INCLUDE_TDMA)
+        if(!this->fits_slot(2 + this->packet_overhead(header))) return;
+      #endif
+      if(
+        this->send_packet(PJON_MASTER_ID, this->bus_id, request, 2, header) !=
+        PJON_ACK
+      ) return; // Retried by the next update
+      _request_time = PJON_MICROS();
+      _request_seq++;
+    };
+
+
+    /* Handle a PJON_TIME_SYNC payload (symbol excluded) containing:
+       SEQUENCE - TIME (4 bytes, end of the transmission of the previous one)
+       If the previous sync was received its reception time is compared with
+       the master's time of its transmission: */
+
+    void handle_time_sync(const uint8_t *payload) {
+      if(_sync_received && ((uint8_t)(_sync_seq + 1) == payload[0]))
+        add_time_sample(read_time(payload + 1) - _sync_time, _sync_time);
+      _sync_received = true;
+      _sync_seq = payload[0];
+      _sync_time = _receive_time;
+    };
+
+
+    /* Handle a PJON_TIME_RESPONSE payload (symbol excluded) containing:
+       SEQUENCE - TIME (4 bytes, reception of the request)
+       The master's time measured at the reception of the request exceeds
+       the one estimated from the syncs by twice the path delay: */
+
+    void handle_time_response(const uint8_t *payload) {
+      if(payload[0] != _request_seq || !time_synchronized()) return;
+      int32_t sample = (int32_t)(
+        read_time(payload + 1) - _request_time - time_offset(_request_time)
+      ) / 2;
+      _path_delay += (sample - _path_delay) / PJON_TIME_SYNC_GAIN;
+    };
+
+
+    /* Offset of the master's clock at a certain time, the path delay
+       excluded: */
+
+    uint32_t time_offset(uint32_t time) {
+      return _time_offset + (uint32_t)(
+        ((int64_t)_time_drift * (int32_t)(time - _time_reference)) >> 24
+      );
+    };
+
+
+    /* Correct offset and drift with an offset sample measured at time,
+       if the error is higher than PJON_TIME_SYNC_STEP the offset is set: */
+
+    void add_time_sample(uint32_t offset, uint32_t time) {
+      int32_t error = (int32_t)(offset - time_offset(time));
+      if(
+        !_time_samples ||
+        (error > PJON_TIME_SYNC_STEP) ||
+        (error < -PJON_TIME_SYNC_STEP)
+      ) {
+        _time_offset = offset;
+        _time_reference = time;
+        _time_samples = 1;
+        return;
+      }
+      uint32_t elapsed = time - _time_reference;
+      _time_offset = time_offset(time) + error / PJON_TIME_SYNC_GAIN;
+      if(elapsed)
+        _time_drift +=
+          (((int64_t)error << 24) / elapsed) / PJON_TIME_SYNC_DRIFT_GAIN;
+      _time_reference = time;
+      if(_time_samples < 255) _time_samples++;
+    };
+
+
+    static uint32_t read_time(const uint8_t *b) {
+      return
+        (uint32_t)(b[0]) << 24 |
+        (uint32_t)(b[1]) << 16 |
+        (uint32_t)(b[2]) <<  8 |
+        (uint32_t)(b[3]);
+    };
+  #endif
+
+  #if(PJON_INCLUDE_TDMA)
+    /* Handle a PJON_TDMA_BEACON payload (symbol excluded) containing:
+       SLOT LENGTH (4 bytes) - COUNT - IDS (count bytes, one per slot)
+       Slot 0 is the master's, slots 1 to count belong to the ids listed,
+       the last one is the contention slot used by the devices not listed.
+       Slots start when the beacon is received. */
+
+    void handle_beacon(const uint8_t *payload, uint16_t length) {
+      if(length < 5 || length < (uint16_t)(payload[4] + 5)) return;
+      _tdma_length =
+        (uint32_t)(payload[0]) << 24 |
+        (uint32_t)(payload[1]) << 16 |
+        (uint32_t)(payload[2]) <<  8 |
+        (uint32_t)(payload[3]);
+      _tdma_slots = payload[4] + 2;
+      _tdma_slot = _tdma_slots - 1;
+      for(uint8_t i = 0; i < payload[4]; i++)
+        if(payload[5 + i] == this->_device_id) _tdma_slot = i + 1;
+      _tdma_start = PJON_MICROS();
+    };
+
+
+    /* Check if the schedule received with the last beacon is still valid: */
+
+    bool tdma_scheduled() {
+      return _tdma_length && (
+        (uint32_t)(PJON_MICROS() - _tdma_start) <
+        (uint32_t)_tdma_length * _tdma_slots * PJON_TDMA_BEACON_LOSS
+      );
+    };
+
+
+    /* Confine the transmissions of update in the slot of the device, or in
+       the contention slot if it is not listed, the others are skipped: */
+
+    void update_slot() {
+      this->_slot_confined = tdma_scheduled();
+      if(!this->_slot_confined) return;
+      uint32_t now = PJON_MICROS();
+      uint32_t offset =
+        (uint32_t)(now - _tdma_start) % (_tdma_length * _tdma_slots);
+      uint8_t slot = offset / _tdma_length;
+      if(slot == _tdma_slot)
+        this->_slot_end =
+          now - (offset % _tdma_length) + _tdma_length - PJON_TDMA_GUARD;
+      else this->_slot_end = now;
+    };
+
+
+    /* Receive until the contention slot starts, waiting a beacon up to
+       PJON_TDMA_JOIN_TIME if the schedule is not known: */
+
+    void wait_contention_slot() {
+      uint32_t time = PJON_MICROS();
+      while(
+        !tdma_scheduled() &&
+        ((uint32_t)(PJON_MICROS() - time) < PJON_TDMA_JOIN_TIME)
+      ) receive();
+      while(tdma_scheduled()) {
+        uint32_t offset = (uint32_t)(PJON_MICROS() - _tdma_start) %
+          (_tdma_length * _tdma_slots);
+        if((offset / _tdma_length) == (uint32_t)(_tdma_slots - 1)) return;
+        receive();
+      }
+    };
+  #endif
+
   private:
     uint32_t      _last_request_time;
     PJON_Receiver _slave_receiver;
     PJON_Error    _slave_error;
     uint32_t      _rid;
+  #if(PJON_INCLUDE_ID_BATCH)
+    uint32_t      _id_window = PJON_ID_REQUEST_WINDOW;
+  #endif
+  #if(PJON_INCLUDE_TIME_SYNC)
+    uint32_t      _receive_time = 0;
+    int32_t       _path_delay = 0;
+    uint32_t      _request_interval = 0;
+    uint8_t       _request_seq = 0;
+    uint32_t      _request_time = 0;
+    bool          _sync_received = false;
+    uint8_t       _sync_seq = 0;
+    uint32_t      _sync_time = 0;
+    int32_t       _time_drift = 0; // 2^-24 microseconds per microsecond
+    uint32_t      _time_offset = 0;
+    uint32_t      _time_reference = 0;
+    uint8_t       _time_samples = 0;
+  #endif
+  #if(PJON_INCLUDE_TDMA)
+    uint32_t      _tdma_length = 0;
+    uint8_t       _tdma_slot = 0;
+    uint8_t       _tdma_slots = 0;
+    uint32_t      _tdma_start = 0;
+  #endif
     static PJONSlave<Strategy> *_current_pjon_slave;
+
+    /* Random number from 0 to n - 1 on every platform, PJON_RANDOM(n)
+       excludes n on Arduino but includes it on Linux, RPI and WINX86: */
+
+    static uint16_t random_below(uint16_t n) {
+      uint16_t r;
+      do r = PJON_RANDOM(n); while(r >= n);
+      return r;
+    };
 };
 
 /* Shared callback function definition: */
@@ -0,0 +1,183 @@
+/* Measure the cost of the PJON hot paths on the host: compose_packet, parse,
+   receive of pre-built frames, CRC8 and CRC32 throughput and update with an
+   increasing number of packets in the send list. A strategy returning
+   pre-built frames is used so that no time is spent on a medium.
+   Results are printed as a table, or as JSON lines with -j, one object per
+   measurement, to compare them across versions.
+   Usage: ./Core [-j] [-t seconds per measurement] */
+
+#define PJON_MAX_PACKETS       64
+#define PJON_PACKET_MAX_LENGTH 1024
+#define PJON_INCLUDE_ASYNC_ACK true
+#define PJON_INCLUDE_NONE
+#include <PJON.h>
+
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+
+/* Strategy without medium: frames sent are discarded and acknowledged,
+   receive_string returns always the same frame */
+
+class FrameSource {
+  public:
+    uint8_t  frame[PJON_PACKET_MAX_LENGTH];
+    uint16_t length = 0;
+
+    uint32_t back_off(uint8_t attempts) { return 1000000ul * attempts; };
+    bool begin(uint8_t additional_randomness = 0) { return true; };
+    bool can_start() { return true; };
+    static uint8_t get_max_attempts() { return 10; };
+    void handle_collision() { };
+
+    uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+      if(!length || length > max_length) return PJON_FAIL;
+      memcpy(string, frame, length);
+      return length;
+    };
+
+    uint16_t receive_response() { return PJON_ACK; };
+    void send_response(uint8_t response) { };
+    void send_string(uint8_t *string, uint16_t length) { };
+};
+
+bool json = false;
+double seconds = 0.2;
+volatile uint32_t sink = 0; // Avoids the optimization of unused results
+
+void report(
+  const char *name,
+  const char *parameters,
+  double value,
+  const char *unit
+) {
+  if(json)
+    printf(
+      "{\"benchmark\":\"%s\",\"parameters\":\"%s\",\"value\":%.3f,"
+      "\"unit\":\"%s\"}\n", name, parameters, value, unit
+    );
+  else printf("%-16s %-32s %12.2f %s\n", name, parameters, value, unit);
+  fflush(stdout);
+};
+
+/* Run function in batches until the time set is elapsed, return the
+   nanoseconds per call of the fastest batch */
+
+template<typename F>
+double measure(F function) {
+  typedef std::chrono::steady_clock clock;
+  double best = 1e300;
+  uint32_t batch = 1;
+  auto end = clock::now() + std::chrono::duration<double>(seconds);
+  while(clock::now() < end) {
+    auto start = clock::now();
+    for(uint32_t i = 0; i < batch; i++) function();
+    double elapsed = std::chrono::duration<double, std::nano>(
+      clock::now() - start
+    ).count();
+    if(elapsed < 1000000) batch *= 2; // Batches of at least 1ms
+    else best = std::min(best, elapsed / batch);
+  }
+  return best;
+};
+
+struct Configuration {
+  const char *name;
+  uint16_t    header;
+  uint16_t    length;
+};
+
+const Configuration configurations[] = {
+  {"local 16B", PJON_TX_INFO_BIT, 16},
+  {"local no info 16B", 0, 16},
+  {"local crc32 16B", PJON_TX_INFO_BIT | PJON_CRC_BIT, 16},
+  {"local 200B", PJON_TX_INFO_BIT, 200},
+  {"local ext length 900B", PJON_TX_INFO_BIT, 900},
+  {"shared 16B", PJON_TX_INFO_BIT | PJON_MODE_BIT, 16},
+  {"shared async ack 16B",
+    PJON_TX_INFO_BIT | PJON_MODE_BIT | PJON_ACK_MODE_BIT, 16}
+};
+
+int main(int argc, char **argv) {
+  int option;
+  while((option = getopt(argc, argv, "jt:")) != -1) {
+    if(option == 'j') json = true;
+    else if(option == 't') seconds = atof(optarg);
+    else {
+      printf("Usage: %s [-j] [-t seconds per measurement]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  const uint8_t bus_id[4] = {0, 0, 0, 1};
+  static PJON<FrameSource> bus(bus_id, 44);
+  bus.set_receiver(
+    [](uint8_t *payload, uint16_t length, const PJON_Packet_Info &info) {
+      sink += length;
+    }
+  );
+  bus.begin();
+  char payload[PJON_PACKET_MAX_LENGTH];
+  for(uint16_t i = 0; i < sizeof(payload); i++) payload[i] = i;
+  char frame[PJON_PACKET_MAX_LENGTH];
+
+  for(const Configuration &c : configurations) {
+    report("compose_packet", c.name, measure([&]() {
+      sink +=
+        bus.compose_packet(45, bus_id, frame, payload, c.length, c.header);
+    }), "ns/op");
+  }
+
+  for(const Configuration &c : configurations) {
+    uint16_t length =
+      bus.compose_packet(44, bus_id, frame, payload, c.length, c.header);
+    PJON_Packet_Info info;
+    report("parse", c.name, measure([&]() {
+      bus.parse((uint8_t *)frame, info);
+      sink += info.header;
+    }), "ns/op");
+    if(c.header & PJON_ACK_MODE_BIT) continue; // Would dispatch the ack
+    memcpy(bus.strategy.frame, frame, length);
+    bus.strategy.length = length;
+    bus.set_shared_network(c.header & PJON_MODE_BIT);
+    report("receive", c.name, measure([&]() {
+      sink += bus.receive();
+    }), "ns/op");
+  }
+  bus.strategy.length = 0;
+  bus.set_shared_network(false);
+
+  const uint16_t lengths[] = {16, 64, 256, 1024};
+  for(uint16_t length : lengths) {
+    char parameters[32];
+    snprintf(parameters, sizeof(parameters), "%uB", length);
+    double ns = measure([&]() {
+      sink += PJON_crc8::compute((uint8_t *)payload, length);
+    });
+    report("crc8", parameters, length * 1000.0 / ns, "MB/s");
+    ns = measure([&]() {
+      sink += PJON_crc32::compute((uint8_t *)payload, length);
+    });
+    report("crc32", parameters, length * 1000.0 / ns, "MB/s");
+  }
+
+  /* update with packets waiting their turn (only the send list scan) and
+     with packets sent at each call */
+  const uint16_t depths[] = {0, 1, 4, 16, 64};
+  for(uint8_t due = 0; due < 2; due++)
+    for(uint16_t depth : depths) {
+      bus.remove_all_packets();
+      for(uint16_t i = 0; i < depth; i++)
+        bus.send_repeatedly(45, payload, 16, due ? 1 : 4000000000ul);
+      char parameters[32];
+      snprintf(
+        parameters, sizeof(parameters), "%s %u packets",
+        due ? "sending" : "waiting", depth
+      );
+      report("update", parameters, measure([&]() {
+        sink += bus.update();
+      }), "ns/op");
+    }
+  bus.remove_all_packets();
+  return 0;
+};
@@ -0,0 +1,145 @@
+/* Measure end-to-end throughput and round-trip latency of LocalUDP,
+   GlobalUDP and EthernetTCP over the loopback interface. A receiver runs in
+   a separate thread, the transmitter sends packets requesting synchronous
+   acknowledgement with send_packet_blocking, one after the other, and
+   measures the time each one takes to be acknowledged.
+   Two LocalUDP instances cannot bind the same port on a host, so they share
+   a LocalUDPHost in the same thread and frames are delivered in memory: the
+   result is the cost of the LocalUDP and PJON code, without the network.
+   Results are printed as a table, or as JSON lines with -j, one object per
+   measurement, to compare them across versions.
+   Usage: ./Network [-j] [-t seconds per strategy] [-l payload length] */
+
+#define PJON_PACKET_MAX_LENGTH 1024
+#define PJON_INCLUDE_LUDP
+#define PJON_INCLUDE_GUDP
+#define PJON_INCLUDE_ETCP
+#include <PJON.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+bool json = false;
+double seconds = 2;
+uint16_t payload_length = 16;
+std::atomic<uint32_t> received(0);
+
+void report(
+  const char *name,
+  const char *parameters,
+  double value,
+  const char *unit
+) {
+  if(json)
+    printf(
+      "{\"benchmark\":\"%s\",\"parameters\":\"%s\",\"value\":%.3f,"
+      "\"unit\":\"%s\"}\n", name, parameters, value, unit
+    );
+  else printf("%-16s %-32s %12.2f %s\n", name, parameters, value, unit);
+  fflush(stdout);
+};
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+template<typename Strategy>
+void run(
+  const char *name,
+  PJON<Strategy> &tx,
+  PJON<Strategy> &rx,
+  bool threaded = true
+) {
+  std::atomic<bool> running(true);
+  received = 0;
+  rx.set_receiver(receiver_function);
+  rx.begin();
+  tx.begin();
+  std::thread receiver([&]() { while(running && threaded) rx.receive(1000); });
+
+  char payload[PJON_PACKET_MAX_LENGTH];
+  memset(payload, 'x', payload_length);
+  std::vector<uint32_t> latencies;
+  uint32_t fails = 0;
+  uint32_t start = PJON_MICROS();
+  uint32_t duration = seconds * 1000000;
+  while((uint32_t)(PJON_MICROS() - start) < duration) {
+    uint32_t time = PJON_MICROS();
+    if(
+      tx.send_packet_blocking(rx.device_id(), payload, payload_length) ==
+      PJON_ACK
+    ) latencies.push_back(PJON_MICROS() - time);
+    else fails++;
+    if(!threaded) rx.receive();
+  }
+  double elapsed = (uint32_t)(PJON_MICROS() - start) / 1000000.0;
+  running = false;
+  receiver.join();
+
+  char parameters[48];
+  snprintf(parameters, sizeof(parameters), "%s %uB", name, payload_length);
+  report("packets", parameters, latencies.size() / elapsed, "packets/s");
+  report("received", parameters, received / elapsed, "packets/s");
+  report("fails", parameters, fails, "packets");
+  if(latencies.empty()) return;
+  std::sort(latencies.begin(), latencies.end());
+  const double percentiles[] = {50, 90, 99, 99.9};
+  for(double p : percentiles) {
+    char label[64];
+    snprintf(label, sizeof(label), "%s p%g", parameters, p);
+    size_t i = (size_t)(p / 100 * (latencies.size() - 1) + 0.5);
+    report("latency", label, latencies[i], "us");
+  }
+};
+
+int main(int argc, char **argv) {
+  int option;
+  while((option = getopt(argc, argv, "jt:l:")) != -1) {
+    if(option == 'j') json = true;
+    else if(option == 't') seconds = atof(optarg);
+    else if(option == 'l') payload_length = atoi(optarg);
+    else {
+      printf(
+        "Usage: %s [-j] [-t seconds per strategy] [-l payload length]\n",
+        argv[0]
+      );
+      return 1;
+    }
+  }
+  if(payload_length > PJON_PACKET_MAX_LENGTH - 20) payload_length = 16;
+  const uint8_t localhost[] = {127, 0, 0, 1};
+
+  { // Only one LocalUDP socket per port can be open on a host
+    LocalUDPHost host;
+    PJON<LocalUDP> tx(44), rx(45);
+    tx.strategy.set_host(&host);
+    rx.strategy.set_host(&host);
+    run("LocalUDP hosted", tx, rx, false); // LocalUDPHost is not thread safe
+  }
+  {
+    PJON<GlobalUDP> tx(44), rx(45);
+    tx.strategy.set_port(16100);
+    tx.strategy.add_node(45, localhost, 16101);
+    rx.strategy.set_port(16101);
+    rx.strategy.add_node(44, localhost, 16100);
+    run("GlobalUDP", tx, rx);
+  }
+  {
+    PJON<EthernetTCP> tx(44), rx(45);
+    tx.strategy.link.set_id(44);
+    tx.strategy.link.add_node(45, localhost, 16201);
+    tx.strategy.link.start_listening(16200);
+    rx.strategy.link.set_id(45);
+    rx.strategy.link.add_node(44, localhost, 16200);
+    rx.strategy.link.start_listening(16201);
+    run("EthernetTCP", tx, rx);
+  }
+  return 0;
+};
@@ -0,0 +1,44 @@
+/* 200 PJON devices (ids 1-200) hosted in the same process share a single UDP
+   socket through LocalUDPHost: incoming frames are read once and passed only
+   to the device they are addressed to. Each device replies to 'P' with 'P',
+   so it can be tested with the Transmitter of the PingPong example. */
+
+#define PJON_INCLUDE_LUDP
+#include <PJON.h>
+
+#define DEVICES 200
+
+LocalUDPHost host;
+PJON<LocalUDP> devices[DEVICES];
+
+uint32_t cnt = 0;
+uint32_t start = millis();
+
+void receiver_function(uint8_t *payload, uint16_t length, const PJON_Packet_Info &packet_info) {
+  if(payload[0] == 'P') {
+    cnt++;
+    devices[packet_info.receiver_id - 1].reply("P", 1);
+  }
+}
+
+int main() {
+  for(uint16_t i = 0; i < DEVICES; i++) {
+    devices[i].set_id(i + 1);
+    devices[i].strategy.set_host(&host);
+    devices[i].set_receiver(receiver_function);
+    devices[i].begin();
+  }
+
+  while(true) {
+    host.receive(1000); // Sleep up to 1ms if nothing is received
+    for(uint16_t i = 0; i < DEVICES; i++) {
+      devices[i].receive();
+      devices[i].update();
+    }
+    if(millis() - start > 1000) {
+      start = millis();
+      printf("PING/s: %d\n", cnt);
+      cnt = 0;
+    }
+  }
+}
@@ -0,0 +1,43 @@
+/* Two PJON instances hosted in the same process communicate through the
+   Loopback strategy. The transmitter sends packets requesting synchronous
+   acknowledgement, the receiver is polled in the same loop (it could also
+   run in another thread). Packets delivered each second are printed. */
+
+#define PJON_INCLUDE_LB
+#include <PJON.h>
+
+PJON<Loopback> transmitter(44);
+PJON<Loopback> receiver(45);
+
+uint32_t received = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+int main() {
+  receiver.set_receiver(receiver_function);
+  receiver.begin();
+  transmitter.begin();
+
+  uint32_t sent = 0, fail = 0;
+  uint32_t time = millis();
+  while(true) {
+    if(transmitter.send_packet(45, "Loopback speed test", 19) == PJON_ACK)
+      sent++;
+    else fail++;
+    receiver.receive();
+    if(millis() - time >= 1000) {
+      time = millis();
+      printf(
+        "Sent: %u packets/s, not accepted: %u, received: %u packets/s\n",
+        sent, fail, received
+      );
+      sent = fail = received = 0;
+    }
+  }
+};
@@ -0,0 +1,36 @@
+#define PJON_INCLUDE_SHM
+#include <PJON.h>
+
+// <Strategy name> bus(selected device id)
+PJON<SharedMemory> bus(45);
+
+uint32_t cnt = 0;
+uint32_t start = millis();
+
+void receiver_function(uint8_t *payload, uint16_t length, const PJON_Packet_Info &packet_info) {
+  if(payload[0] == 'P') {
+    cnt++;
+    /* Reply immediately, the frame is delivered to the transmitter's ring
+       buffer, waking it up if it is waiting for it */
+    bus.send_packet(packet_info.sender_id, (char *)"P", 1);
+  }
+}
+
+void loop() {
+  bus.update();
+  bus.receive(); // Sleeps up to SHM_RECEIVE_TIMEOUT if nothing is received
+
+  if(millis() - start > 1000) {
+    start = millis();
+    printf("PONG/s: %d\n", cnt);
+    cnt = 0;
+  }
+};
+
+int main() {
+  bus.set_receiver(receiver_function);
+  bus.begin();
+  bus.send(44, "P", 1); // The ping pong goes on replying to each P
+
+  do loop(); while(true);
+}
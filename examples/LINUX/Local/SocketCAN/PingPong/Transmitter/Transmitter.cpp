@@ -0,0 +1,40 @@
+#define PJON_INCLUDE_CAN
+#include <PJON.h>
+
+// <Strategy name> bus(selected device id)
+PJON<SocketCAN> bus(45);
+
+uint32_t cnt = 0;
+uint32_t start = millis();
+
+void receiver_function(uint8_t *payload, uint16_t length, const PJON_Packet_Info &packet_info) {
+  if(payload[0] == 'P') {
+    cnt++;
+    // Reply immediately, CAN arbitration avoids collisions
+    bus.send_packet(packet_info.sender_id, (char *)"P", 1);
+  }
+}
+
+void loop() {
+  bus.update();
+  bus.receive(); // Sleeps up to CAN_RECEIVE_TIMEOUT if nothing is received
+
+  if(millis() - start > 1000) {
+    start = millis();
+    printf("PONG/s: %d\n", cnt);
+    cnt = 0;
+  }
+};
+
+int main() {
+  bus.set_receiver(receiver_function);
+  bus.strategy.set_interface("vcan0");
+  bus.begin();
+  if(!bus.strategy.can_start()) {
+    printf("Unable to open vcan0, see strategies/SocketCAN/README.md\n");
+    return 1;
+  }
+  bus.send(44, "P", 1); // The ping pong goes on replying to each P
+
+  do loop(); while(true);
+}
@@ -0,0 +1,41 @@
+#define PJON_INCLUDE_UDS
+#include <PJON.h>
+
+// <Strategy name> bus(selected device id)
+PJON<UnixSocket> bus(44);
+
+uint32_t cnt = 0;
+uint32_t start = millis();
+
+void receiver_function(uint8_t *payload, uint16_t length, const PJON_Packet_Info &packet_info) {
+  /* Make use of the payload before sending something, the buffer where payload points to is
+     overwritten when a new message is dispatched */
+  if(payload[0] == 'P') {
+    cnt++;
+    // Reply immediately, the frame is written in the socket
+    bus.send_packet(packet_info.sender_id, (char *)"P", 1);
+  }
+}
+
+void loop() {
+  bus.receive(); // Sleeps up to UDS_RECEIVE_TIMEOUT if nothing is received
+  bus.update();
+
+  if(millis() - start > 1000) {
+    start = millis();
+    printf("PING/s: %d\n", cnt);
+    cnt = 0;
+  }
+}
+
+int main() {
+  bus.set_receiver(receiver_function);
+  bus.strategy.set_server(); // Listen on /tmp/pjon.sock
+  if(!bus.strategy.begin()) {
+    printf("Unable to listen on %s\n", UDS_DEFAULT_PATH);
+    return 1;
+  }
+  bus.begin();
+
+  do loop(); while(true);
+}
@@ -0,0 +1,90 @@
+/* Simulate a shared bus with many devices sending packets to each other and
+   print collision rate, throughput and delivery ratio.
+   Usage: ./BusLoad [devices] [seconds] [back-off degree] [max attempts]
+                    [interval milliseconds] [bit error rate] */
+
+#define PJON_INCLUDE_SM
+#include <PJON.h>
+
+#define MAX_DEVICES 250
+
+PJON<SimulatedMedium> *devices[MAX_DEVICES];
+uint32_t last_send[MAX_DEVICES];
+
+uint32_t dispatched = 0;
+uint32_t received = 0;
+uint32_t lost = 0;
+uint32_t buffer_full = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+void error_handler(uint8_t code, uint8_t data) {
+  if(code == PJON_CONNECTION_LOST) lost++;
+  if(code == PJON_PACKETS_BUFFER_FULL) buffer_full++;
+};
+
+int main(int argc, char **argv) {
+  uint16_t count = (argc > 1) ? atoi(argv[1]) : 50;
+  uint32_t seconds = (argc > 2) ? atoi(argv[2]) : 10;
+  uint8_t degree = (argc > 3) ? atoi(argv[3]) : SM_BACK_OFF_DEGREE;
+  uint8_t attempts = (argc > 4) ? atoi(argv[4]) : SM_MAX_ATTEMPTS;
+  uint32_t interval = ((argc > 5) ? atoi(argv[5]) : 1000) * 1000;
+  double bit_error_rate = (argc > 6) ? atof(argv[6]) : 0;
+  if(count < 2 || count > MAX_DEVICES) count = 50;
+
+  PJON_Simulator simulator;
+  SimulatedMedium::default_bus()->bit_error_rate = bit_error_rate;
+
+  for(uint16_t i = 0; i < count; i++) {
+    devices[i] = new PJON<SimulatedMedium>(i + 1);
+    devices[i]->strategy.set_back_off_degree(degree);
+    devices[i]->strategy.set_max_attempts(attempts);
+    devices[i]->set_receiver(receiver_function);
+    devices[i]->set_error(error_handler);
+    simulator.add_node(
+      [i, count, interval]() {
+        /* Send a packet to a random device every interval on average */
+        if((uint32_t)(PJON_MICROS() - last_send[i]) >= interval) {
+          last_send[i] = PJON_MICROS() - PJON_RANDOM(interval / 2);
+          uint8_t id = PJON_RANDOM(count - 1) + 1;
+          if(id == devices[i]->device_id()) return;
+          if(devices[i]->send(id, "Simulated payload", 17) != PJON_FAIL)
+            dispatched++;
+        }
+        devices[i]->update();
+        devices[i]->receive();
+      },
+      [i, interval]() {
+        devices[i]->begin();
+        last_send[i] = PJON_RANDOM(interval);
+      }
+    );
+  }
+
+  simulator.run((uint64_t)seconds * 1000000);
+
+  SimulatedBus *bus = SimulatedMedium::default_bus();
+  printf("Devices: %d, virtual time: %ds\n", count, seconds);
+  printf("Back-off degree: %d, max attempts: %d\n", degree, attempts);
+  printf("Dispatched: %d, received: %d, lost: %d, buffer full: %d\n",
+    dispatched, received, lost, buffer_full);
+  printf("Frames: %llu, responses: %llu, collisions: %llu\n",
+    (unsigned long long)bus->frames,
+    (unsigned long long)bus->responses,
+    (unsigned long long)bus->collisions);
+  printf("Collision rate: %.2f%%, bus utilization: %.2f%%\n",
+    bus->frames ? 100.0 * bus->collisions / (bus->frames + bus->responses) : 0,
+    100.0 * bus->airtime / ((double)seconds * 1000000));
+  printf("Throughput: %.2f packets/s, delivery ratio: %.2f%%\n",
+    (double)received / seconds,
+    dispatched ? 100.0 * received / dispatched : 0);
+  printf("Context switches: %llu\n",
+    (unsigned long long)simulator.switches());
+  return 0;
+};
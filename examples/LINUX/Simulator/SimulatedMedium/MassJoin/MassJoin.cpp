@@ -0,0 +1,76 @@
+/* Simulate many PJONSlave instances powered up at once requesting a device
+   id to a PJONMaster, print when the last one is registered and the
+   collisions occurred. Compile with -DPJON_INCLUDE_ID_BATCH=true to use the
+   batched id assignment.
+   Usage: ./MassJoin [devices] [seconds] */
+
+/* The random generator is shared by all the simulated devices, if each
+   begin seeded it with the same value they would generate the same rid: */
+#define PJON_RANDOM_SEED(seed)
+
+#define PJON_INCLUDE_SM
+#include <PJONMaster.h>
+#include <PJONSlave.h>
+
+PJONMaster<SimulatedMedium> *master;
+PJONSlave<SimulatedMedium> *slaves[PJON_MAX_DEVICES];
+
+uint32_t joined = 0;
+uint32_t last_join = 0;
+uint32_t failures = 0;
+
+void error_handler(uint8_t code, uint8_t data) {
+  if(code == PJON_ID_ACQUISITION_FAIL) failures++;
+};
+
+int main(int argc, char **argv) {
+  uint16_t count = (argc > 1) ? atoi(argv[1]) : 50;
+  uint32_t seconds = (argc > 2) ? atoi(argv[2]) : 60;
+  if(count < 1 || count > PJON_MAX_DEVICES) count = 50;
+
+  srand(time(NULL));
+  PJON_Simulator simulator;
+  master = new PJONMaster<SimulatedMedium>();
+  simulator.add_node(
+    [count]() {
+      master->update();
+      master->receive();
+      if(master->count_active_ids() > joined) {
+        joined = master->count_active_ids();
+        last_join = PJON_MICROS();
+      }
+    },
+    []() {
+      master->begin();
+    }
+  );
+
+  for(uint16_t i = 0; i < count; i++) {
+    slaves[i] = new PJONSlave<SimulatedMedium>();
+    slaves[i]->set_error(error_handler);
+    simulator.add_node(
+      [i]() {
+        slaves[i]->update();
+        slaves[i]->receive();
+      },
+      [i]() {
+        slaves[i]->begin();
+      }
+    );
+  }
+
+  simulator.run((uint64_t)seconds * 1000000);
+
+  SimulatedBus *bus = SimulatedMedium::default_bus();
+  uint16_t assigned = 0;
+  for(uint16_t i = 0; i < count; i++)
+    if(slaves[i]->device_id() != PJON_NOT_ASSIGNED) assigned++;
+  printf("Devices: %d, virtual time: %ds\n", count, seconds);
+  printf("Registered: %d, last at: %.2fs, with id: %d, failures: %d\n",
+    joined, last_join / 1000000.0, assigned, failures);
+  printf("Frames: %llu, responses: %llu, collisions: %llu\n",
+    (unsigned long long)bus->frames,
+    (unsigned long long)bus->responses,
+    (unsigned long long)bus->collisions);
+  return 0;
+};
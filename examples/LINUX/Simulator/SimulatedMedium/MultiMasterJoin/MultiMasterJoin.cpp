@@ -0,0 +1,90 @@
+/* Simulate PJONSlave instances acquiring an id in multi-master
+   configuration on a bus where other devices are exchanging packets, print
+   how long the acquisition lasted and the ids acquired twice. Compile with
+   -DPJON_INCLUDE_ID_CLAIM=true to listen to the traffic and claim the ids.
+   Usage: ./MultiMasterJoin [joining devices] [active devices] */
+
+/* The random generator is shared by all the simulated devices, if each
+   begin seeded it with the same value they would generate the same rid: */
+#define PJON_RANDOM_SEED(seed)
+
+#define PJON_INCLUDE_SM
+#include <PJONSlave.h>
+
+PJONSlave<SimulatedMedium> *devices[PJON_MAX_DEVICES];
+uint32_t last_send[PJON_MAX_DEVICES];
+uint32_t duration[PJON_MAX_DEVICES];
+
+int main(int argc, char **argv) {
+  uint16_t joining = (argc > 1) ? atoi(argv[1]) : 5;
+  uint16_t active = (argc > 2) ? atoi(argv[2]) : 10;
+  if(joining + active > PJON_MAX_DEVICES) {
+    joining = 5;
+    active = 10;
+  }
+  srand(time(NULL));
+  PJON_Simulator simulator;
+
+  /* Active devices send a packet to a random one every 200ms on average */
+  for(uint16_t i = 0; i < active; i++) {
+    devices[i] = new PJONSlave<SimulatedMedium>(i + 1);
+    simulator.add_node(
+      [i, active]() {
+        if((uint32_t)(PJON_MICROS() - last_send[i]) >= 200000) {
+          last_send[i] = PJON_MICROS() - PJON_RANDOM(100000);
+          devices[i]->send(PJON_RANDOM(active - 1) + 1, "Payload", 7);
+        }
+        devices[i]->update();
+        devices[i]->receive();
+      },
+      [i]() {
+        devices[i]->PJON<SimulatedMedium>::begin();
+        last_send[i] = PJON_RANDOM(200000);
+      }
+    );
+  }
+
+  /* Joining devices start within the first second */
+  for(uint16_t i = active; i < active + joining; i++) {
+    devices[i] = new PJONSlave<SimulatedMedium>();
+    simulator.add_node(
+      [i]() {
+        devices[i]->update();
+        devices[i]->receive();
+      },
+      [i]() {
+        PJON_DELAY_MICROSECONDS(PJON_RANDOM(1000000));
+        devices[i]->PJON<SimulatedMedium>::begin();
+        uint32_t time = PJON_MICROS();
+        devices[i]->acquire_id_multi_master();
+        duration[i] = PJON_MICROS() - time;
+      }
+    );
+  }
+
+  simulator.run(60000000);
+
+  uint32_t longest = 0, total = 0;
+  uint16_t acquired = 0, duplicated = 0;
+  for(uint16_t i = active; i < active + joining; i++) {
+    uint8_t id = devices[i]->device_id();
+    if(id == PJON_NOT_ASSIGNED) continue;
+    acquired++;
+    total += duration[i];
+    if(duration[i] > longest) longest = duration[i];
+    for(uint16_t j = 0; j < active + joining; j++)
+      if((j != i) && (devices[j]->device_id() == id)) {
+        duplicated++;
+        break;
+      }
+  }
+  printf("Active devices: %d, joining devices: %d\n", active, joining);
+  printf(
+    "Acquired: %d, average: %.2fs, longest: %.2fs, duplicated: %d\n",
+    acquired,
+    acquired ? total / (acquired * 1000000.0) : 0,
+    longest / 1000000.0,
+    duplicated
+  );
+  return 0;
+};
@@ -0,0 +1,88 @@
+/* Simulate the restart of a PJONMaster saving its device table in a
+   registry file: slaves join, the master is restarted while one of them is
+   powered off, the table is restored by begin and the device powered off is
+   removed once its probe is not acknowledged.
+   Usage: ./Registry [devices] */
+
+/* The random generator is shared by all the simulated devices, if each
+   begin seeded it with the same value they would generate the same rid: */
+#define PJON_RANDOM_SEED(seed)
+
+#define PJON_INCLUDE_SM
+#define PJON_INCLUDE_ID_BATCH true
+#include <interfaces/LINUX/PJON_Registry_LINUX.h>
+#include <PJONMaster.h>
+#include <PJONSlave.h>
+
+const char *path = "registry.pjr";
+PJONMaster<SimulatedMedium> *master;
+PJONSlave<SimulatedMedium> *slaves[PJON_MAX_DEVICES];
+bool powered[PJON_MAX_DEVICES];
+bool start = true;
+uint32_t begin_duration = 0;
+uint8_t restored = 0;
+
+void print_table(const char *title) {
+  printf("%s: %d active ids\n", title, master->count_active_ids());
+  for(uint8_t id = 1; id <= PJON_MAX_DEVICES; id++)
+    if(master->ids[id - 1].state)
+      printf("  id %3d rid %08x\n", id, master->ids[id - 1].rid);
+};
+
+int main(int argc, char **argv) {
+  uint16_t count = (argc > 1) ? atoi(argv[1]) : 10;
+  if(count < 2 || count > PJON_MAX_DEVICES) count = 10;
+  srand(time(NULL));
+  unlink(path);
+
+  PJON_Simulator simulator;
+  master = new PJONMaster<SimulatedMedium>();
+  PJON_Registry::open(master, path);
+  simulator.add_node([]() {
+    if(start) {
+      uint32_t time = PJON_MICROS();
+      master->begin();
+      begin_duration = PJON_MICROS() - time;
+      restored = master->count_active_ids();
+      start = false;
+    }
+    master->update();
+    master->receive();
+  });
+
+  for(uint16_t i = 0; i < count; i++) {
+    slaves[i] = new PJONSlave<SimulatedMedium>();
+    powered[i] = true;
+    simulator.add_node(
+      [i]() {
+        if(!powered[i]) return PJON_DELAY_MICROSECONDS(1000);
+        slaves[i]->update();
+        slaves[i]->receive();
+      },
+      [i]() {
+        slaves[i]->begin();
+      }
+    );
+  }
+
+  simulator.run(10000000);
+  print_table("Before the restart");
+
+  /* Restart the master while the first slave is powered off */
+  powered[0] = false;
+  PJON_Registry::close(master);
+  delete master;
+  master = new PJONMaster<SimulatedMedium>();
+  PJON_Registry::open(master, path);
+  start = true;
+  simulator.run(100000);
+  printf(
+    "Restarted, begin lasted %uus, %d ids restored\n",
+    begin_duration,
+    restored
+  );
+  simulator.run(5000000);
+  print_table("After the probes");
+  PJON_Registry::close(master);
+  return 0;
+};
@@ -0,0 +1,95 @@
+/* Simulate a bus with a PJONMaster and many PJONSlave instances sending
+   packets to each other, with and without the TDMA schedule coordinated by
+   the master, and print collision rate and delivery ratio.
+   Usage: ./TDMA [devices] [seconds] [interval milliseconds] [tdma 0 or 1] */
+
+#define PJON_INCLUDE_SM
+#define PJON_INCLUDE_TDMA true
+#include <PJONMaster.h>
+#include <PJONSlave.h>
+
+PJONMaster<SimulatedMedium> *master;
+PJONSlave<SimulatedMedium> *slaves[PJON_MAX_DEVICES];
+uint32_t last_send[PJON_MAX_DEVICES];
+
+uint32_t dispatched = 0;
+uint32_t received = 0;
+uint32_t lost = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  if(!(packet_info.header & PJON_ADDRESS_BIT)) received++;
+};
+
+void error_handler(uint8_t code, uint8_t data) {
+  if(code == PJON_CONNECTION_LOST) lost++;
+};
+
+int main(int argc, char **argv) {
+  uint16_t count = (argc > 1) ? atoi(argv[1]) : 20;
+  uint32_t seconds = (argc > 2) ? atoi(argv[2]) : 60;
+  uint32_t interval = ((argc > 3) ? atoi(argv[3]) : 1000) * 1000;
+  bool tdma = (argc > 4) ? atoi(argv[4]) : true;
+  if(count < 2 || count > PJON_MAX_DEVICES) count = 20;
+
+  PJON_Simulator simulator;
+  master = new PJONMaster<SimulatedMedium>();
+  master->set_receiver(receiver_function);
+  simulator.add_node(
+    []() {
+      master->update();
+      master->receive();
+    },
+    [count, tdma]() {
+      /* Devices are already registered, the id list is not requested */
+      for(uint16_t i = 0; i < count; i++) master->add_id(i + 1, i + 1, true);
+      master->PJON<SimulatedMedium>::begin();
+      master->set_tdma(tdma);
+    }
+  );
+
+  for(uint16_t i = 0; i < count; i++) {
+    slaves[i] = new PJONSlave<SimulatedMedium>(i + 1);
+    slaves[i]->set_receiver(receiver_function);
+    slaves[i]->set_error(error_handler);
+    simulator.add_node(
+      [i, count, interval]() {
+        /* Send a packet to a random device every interval on average */
+        if((uint32_t)(PJON_MICROS() - last_send[i]) >= interval) {
+          last_send[i] = PJON_MICROS() - PJON_RANDOM(interval / 2);
+          uint8_t id = PJON_RANDOM(count - 1) + 1;
+          if(id == slaves[i]->device_id()) return;
+          if(slaves[i]->send(id, "Simulated payload", 17) != PJON_FAIL)
+            dispatched++;
+        }
+        slaves[i]->update();
+        slaves[i]->receive();
+      },
+      [i, interval]() {
+        slaves[i]->begin();
+        last_send[i] = PJON_RANDOM(interval);
+      }
+    );
+  }
+
+  simulator.run((uint64_t)seconds * 1000000);
+
+  SimulatedBus *bus = SimulatedMedium::default_bus();
+  printf("Devices: %d, virtual time: %ds, TDMA: %s\n",
+    count, seconds, tdma ? "on" : "off");
+  printf("Dispatched: %d, received: %d, lost: %d\n",
+    dispatched, received, lost);
+  printf("Frames: %llu, responses: %llu, collisions: %llu\n",
+    (unsigned long long)bus->frames,
+    (unsigned long long)bus->responses,
+    (unsigned long long)bus->collisions);
+  printf("Collision rate: %.2f%%, bus utilization: %.2f%%\n",
+    bus->frames ? 100.0 * bus->collisions / (bus->frames + bus->responses) : 0,
+    100.0 * bus->airtime / ((double)seconds * 1000000));
+  printf("Delivery ratio: %.2f%%\n",
+    dispatched ? 100.0 * received / dispatched : 0);
+  return 0;
+};
@@ -0,0 +1,88 @@
+/* Run a PJONMaster and many PJONSlave instances with skewed clocks on a
+   simulated SoftwareBitBang wire, the master broadcasts its time and each
+   slave compares sync_micros with the master's clock. The error is measured
+   after the first half of the simulation, when the estimation has settled.
+   Usage: ./TimeSync [devices] [seconds] [clock skew ppm]
+                     [sync interval milliseconds]
+                     [time request interval milliseconds, 0 to disable] */
+
+#define PJON_INCLUDE_SWBB
+#define PJON_INCLUDE_TIME_SYNC true
+#include <PJONMaster.h>
+#include <PJONSlave.h>
+
+#define PIN 12
+
+PJONMaster<SoftwareBitBang> *master;
+PJONSlave<SoftwareBitBang> *slaves[PJON_MAX_DEVICES];
+uint32_t last_sample[PJON_MAX_DEVICES];
+
+double master_rate = 1;
+uint64_t samples = 0;
+double error_sum = 0;
+uint32_t error_max = 0;
+
+int main(int argc, char **argv) {
+  uint16_t count = (argc > 1) ? atoi(argv[1]) : 4;
+  uint32_t seconds = (argc > 2) ? atoi(argv[2]) : 60;
+  double skew = (argc > 3) ? atof(argv[3]) : 100;
+  uint32_t interval = ((argc > 4) ? atoi(argv[4]) : 1000) * 1000;
+  uint32_t request = ((argc > 5) ? atoi(argv[5]) : 5000) * 1000;
+  if(count < 1 || count > PJON_MAX_DEVICES) count = 4;
+
+  PJON_Simulator simulator;
+  master = new PJONMaster<SoftwareBitBang>();
+  master->strategy.set_pin(PIN);
+  simulator.add_node(
+    []() {
+      master->update();
+      master->receive(1000);
+    },
+    [interval]() {
+      master->PJON<SoftwareBitBang>::begin();
+      master->set_time_sync(interval);
+    }
+  );
+
+  for(uint16_t i = 0; i < count; i++) {
+    slaves[i] = new PJONSlave<SoftwareBitBang>(i + 1);
+    slaves[i]->strategy.set_pin(PIN);
+    uint16_t node = simulator.add_node(
+      [i, seconds]() {
+        slaves[i]->update();
+        slaves[i]->receive(1000);
+        if((uint32_t)(PJON_MICROS() - last_sample[i]) < 100000) return;
+        last_sample[i] = PJON_MICROS();
+        uint64_t now = PJON_Simulator::active()->now();
+        if(!slaves[i]->time_synchronized() || now < seconds * 500000ULL)
+          return;
+        int32_t error = (int32_t)(
+          slaves[i]->sync_micros() - (uint32_t)(now * master_rate)
+        );
+        uint32_t absolute = (error < 0) ? -error : error;
+        if(absolute > error_max) error_max = absolute;
+        error_sum += absolute;
+        samples++;
+      },
+      [i, request]() {
+        slaves[i]->begin();
+        slaves[i]->set_time_request(request);
+      }
+    );
+    /* Slaves alternately run faster and slower than the master */
+    simulator.set_clock_skew(node, (i % 2) ? skew : -skew);
+  }
+
+  simulator.run((uint64_t)seconds * 1000000);
+
+  printf("Slaves: %d, virtual time: %ds, clock skew: +-%.0fppm\n",
+    count, seconds, skew);
+  printf("Sync interval: %dms, time request interval: %dms\n",
+    interval / 1000, request / 1000);
+  for(uint16_t i = 0; i < count; i++)
+    printf("Slave %d drift: %dppm, path delay: %dus\n",
+      i + 1, slaves[i]->get_time_drift(), slaves[i]->get_path_delay());
+  printf("Samples: %llu, mean error: %.1fus, max error: %dus\n",
+    (unsigned long long)samples, samples ? error_sum / samples : 0, error_max);
+  return 0;
+};
@@ -0,0 +1,87 @@
+/* Run the SoftwareBitBang strategy on a simulated wire, each device sends a
+   packet to a random one every interval, then delivery statistics are printed.
+   Useful to evaluate changes of Timing.h without flashing any board.
+   Usage: ./WireTest [devices] [seconds] [clock skew ppm] [rise time us]
+                     [digital flip rate] [interval milliseconds]
+                     [collision detection 0/1] */
+
+#define PJON_INCLUDE_SWBB
+#include <PJON.h>
+
+#define MAX_DEVICES 50
+#define PIN         12
+
+PJON<SoftwareBitBang> *devices[MAX_DEVICES];
+uint32_t last_send[MAX_DEVICES];
+
+uint32_t dispatched = 0;
+uint32_t received = 0;
+uint32_t lost = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+void error_handler(uint8_t code, uint8_t data) {
+  if(code == PJON_CONNECTION_LOST) lost++;
+};
+
+int main(int argc, char **argv) {
+  uint16_t count = (argc > 1) ? atoi(argv[1]) : 2;
+  uint32_t seconds = (argc > 2) ? atoi(argv[2]) : 10;
+  double skew = (argc > 3) ? atof(argv[3]) : 0;
+  uint32_t rise_time = (argc > 4) ? atoi(argv[4]) : 0;
+  double flip_rate = (argc > 5) ? atof(argv[5]) : 0;
+  uint32_t interval = ((argc > 6) ? atoi(argv[6]) : 100) * 1000;
+  bool collision_detection = (argc > 7) ? atoi(argv[7]) : 0;
+  if(count < 2 || count > MAX_DEVICES) count = 2;
+
+  PJON_Simulator simulator;
+  PJON_Simulated_Wire *wire = simulator.wire(PIN);
+  wire->rise_time = rise_time;
+  wire->fall_time = rise_time;
+  wire->flip_rate = flip_rate;
+
+  for(uint16_t i = 0; i < count; i++) {
+    devices[i] = new PJON<SoftwareBitBang>(i + 1);
+    devices[i]->strategy.set_pin(PIN);
+    devices[i]->strategy.set_collision_detection(collision_detection);
+    devices[i]->set_receiver(receiver_function);
+    devices[i]->set_error(error_handler);
+    uint16_t node = simulator.add_node(
+      [i, count, interval]() {
+        if((uint32_t)(PJON_MICROS() - last_send[i]) >= interval) {
+          last_send[i] = PJON_MICROS() - PJON_RANDOM(interval / 2);
+          uint8_t id = PJON_RANDOM(count - 1) + 1;
+          if(id != devices[i]->device_id())
+            if(devices[i]->send(id, "Simulated payload", 17) != PJON_FAIL)
+              dispatched++;
+        }
+        devices[i]->update();
+        devices[i]->receive(1000);
+      },
+      [i]() {
+        devices[i]->begin();
+        last_send[i] = PJON_MICROS();
+      }
+    );
+    /* Devices alternately run faster and slower than nominal */
+    simulator.set_clock_skew(node, (i % 2) ? skew : -skew);
+  }
+
+  simulator.run((uint64_t)seconds * 1000000);
+
+  printf("Devices: %d, virtual time: %ds\n", count, seconds);
+  printf("Clock skew: +-%.0fppm, rise time: %dus, flip rate: %g\n",
+    skew, rise_time, flip_rate);
+  printf("Collision detection: %s\n", collision_detection ? "on" : "off");
+  printf("Dispatched: %d, received: %d, lost: %d\n",
+    dispatched, received, lost);
+  printf("Delivery ratio: %.2f%%\n",
+    dispatched ? (100.0 * received / dispatched) : 0);
+  return 0;
+};
@@ -0,0 +1,378 @@
+/* pjon-bench generates load on a PJON strategy and measures its performance.
+   N pairs of instances are created: each sender (device id 1 to N) sends
+   packets to its receiver (device id 101 to 100 + N) which sends them back.
+   The round-trip time is measured by the sender from the time written in
+   the payload. The instances are distributed among the threads (LocalUDP
+   instances share a LocalUDPHost and run in a single thread, frames
+   exchanged by instances of the same process are delivered in memory).
+   Senders and receivers can run on different machines with -m tx and -m rx
+   (GlobalUDP, EthernetTCP and LocalUDP) or in different processes with
+   SharedMemory and UnixSocket, using the same options on both sides.
+
+   Usage: ./pjon-bench [options]
+   -s strategy     ludp, gudp, etcp, lb (Loopback), shm (SharedMemory),
+                   uds (UnixSocket), default lb
+   -n pairs        Number of sender and receiver pairs (1 - 50), default 1
+   -r rate         Packets per second each sender sends, 0 (default) sends a
+                   packet when the previous one is returned (see -w)
+   -w window       Packets each sender can wait back at the same time if the
+                   rate is 0, default 1
+   -l length       Payload length (8 - 255), default 16
+   -a ack          none, sync (default) or async acknowledgement
+   -c              Use CRC32
+   -b              Shared network mode (bus id 0.0.0.1)
+   -i              Do not include the sender info (not with -a async)
+   -t seconds      Test duration, default 5
+   -m mode         both (default), tx (only senders) or rx (only receivers)
+   -p address      IP address of the other side (gudp, etcp), default
+                   127.0.0.1
+   -T threads      Threads polling the instances, default the number of
+                   processors
+   -j              Print the results as JSON */
+
+#define PJON_MAX_PACKETS       16
+#define PJON_PACKET_MAX_LENGTH 300
+#define PJON_INCLUDE_ASYNC_ACK true
+#define PJON_INCLUDE_STATS     true
+#define PJON_INCLUDE_NONE
+#include <PJON.h>
+#include <strategies/EthernetTCP/EthernetTCP.h>
+#include <strategies/GlobalUDP/GlobalUDP.h>
+#include <strategies/LocalUDP/LocalUDP.h>
+#include <strategies/Loopback/Loopback.h>
+#include <strategies/SharedMemory/SharedMemory.h>
+#include <strategies/UnixSocket/UnixSocket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define MAX_PAIRS     50
+#define RECEIVER_BASE 100
+#define GUDP_BASE     16300
+#define ETCP_BASE     16400
+#define DRAIN_TIME    1000000 // Time to wait the packets still traveling
+
+struct Options {
+  std::string strategy = "lb";
+  uint16_t    pairs = 1;
+  uint32_t    rate = 0;
+  uint16_t    window = 1;
+  uint16_t    length = 16;
+  std::string ack = "sync";
+  bool        crc32 = false;
+  bool        shared = false;
+  bool        no_info = false;
+  double      seconds = 5;
+  std::string mode = "both";
+  uint8_t     address[4] = {127, 0, 0, 1};
+  uint16_t    threads = std::thread::hardware_concurrency();
+  bool        json = false;
+} options;
+
+struct Node {
+  uint8_t               id = 0;
+  uint8_t               peer = 0;
+  bool                  sender = false;
+  uint32_t              sent = 0;       // Packets accepted in the send list
+  uint32_t              refused = 0;    // Packets refused, send list full
+  uint32_t              received = 0;   // Packets received
+  std::vector<uint32_t> round_trips;
+  PJON_Stats            stats;
+};
+
+Node nodes[256];
+std::atomic<bool> sending(true);
+std::atomic<bool> running(true);
+LocalUDPHost ludp_host;
+
+/* Configure each strategy, ports and socket paths depend on the pair: */
+
+void setup(PJON<LocalUDP> &bus, const Node &node) {
+  bus.strategy.set_host(&ludp_host);
+};
+
+void setup(PJON<GlobalUDP> &bus, const Node &node) {
+  uint16_t pair = node.sender ? node.id : node.peer;
+  bus.strategy.set_port(GUDP_BASE + (node.sender ? 0 : 100) + pair);
+  bus.strategy.add_node(
+    node.peer, options.address, GUDP_BASE + (node.sender ? 100 : 0) + pair
+  );
+};
+
+void setup(PJON<EthernetTCP> &bus, const Node &node) {
+  uint16_t pair = node.sender ? node.id : node.peer;
+  bus.strategy.link.set_id(node.id);
+  bus.strategy.link.add_node(
+    node.peer, options.address, ETCP_BASE + (node.sender ? 100 : 0) + pair
+  );
+  bus.strategy.link.start_listening(
+    ETCP_BASE + (node.sender ? 0 : 100) + pair
+  );
+};
+
+void setup(PJON<Loopback> &bus, const Node &node) {
+  bus.strategy.set_bus("pjon-bench");
+};
+
+void setup(PJON<SharedMemory> &bus, const Node &node) {
+  bus.strategy.set_bus("pjon-bench");
+  bus.strategy.set_receive_timeout(0); // Other instances share the thread
+};
+
+void setup(PJON<UnixSocket> &bus, const Node &node) {
+  char path[64];
+  snprintf(
+    path, sizeof(path), "/tmp/pjon-bench-%u.sock",
+    node.sender ? node.id : node.peer
+  );
+  if(node.sender) bus.strategy.set_client(path);
+  else bus.strategy.set_server(path);
+  bus.strategy.set_receive_timeout(0);
+};
+
+template<typename Strategy>
+struct Bench {
+  static PJON<Strategy> *buses[256];
+
+  static void receiver(
+    uint8_t *payload,
+    uint16_t length,
+    const PJON_Packet_Info &info
+  ) {
+    Node &node = nodes[info.receiver_id];
+    if(length < 8) return;
+    node.received++;
+    if(node.sender) {
+      uint32_t time;
+      memcpy(&time, payload + 4, 4);
+      node.round_trips.push_back(PJON_MICROS() - time);
+    } else buses[node.id]->send(node.peer, (char *)payload, length);
+  };
+
+  static void step(Node &node, uint32_t &next, uint32_t interval) {
+    PJON<Strategy> &bus = *buses[node.id];
+    if(node.sender && sending) {
+      bool due = options.rate ?
+        ((int32_t)(PJON_MICROS() - next) >= 0) :
+        (node.sent - node.received < options.window);
+      if(due) {
+        char payload[PJON_PACKET_MAX_LENGTH];
+        memset(payload, 0, options.length);
+        uint32_t time = PJON_MICROS();
+        memcpy(payload, &node.sent, 4);
+        memcpy(payload + 4, &time, 4);
+        if(bus.send(node.peer, payload, options.length) != PJON_FAIL)
+          node.sent++;
+        else node.refused++;
+        next += interval;
+        if((int32_t)(time - next) > 1000000) next = time; // Too late
+      }
+    }
+    bus.update();
+    bus.receive();
+  };
+
+  static int run() {
+    std::vector<Node *> local;
+    for(uint16_t i = 1; i <= options.pairs; i++) {
+      if(options.mode != "tx") local.push_back(&nodes[RECEIVER_BASE + i]);
+      if(options.mode != "rx") local.push_back(&nodes[i]);
+    }
+    const uint8_t bus_id[4] = {0, 0, 0, 1};
+    for(Node *node : local) {
+      buses[node->id] = options.shared ?
+        new PJON<Strategy>(bus_id, node->id) : new PJON<Strategy>(node->id);
+      PJON<Strategy> &bus = *buses[node->id];
+      setup(bus, *node);
+      bus.set_receiver(receiver);
+      bus.set_crc_32(options.crc32);
+      bus.include_sender_info(!options.no_info);
+      bus.set_synchronous_acknowledge(options.ack == "sync");
+      bus.set_asynchronous_acknowledge(options.ack == "async");
+      bus.begin();
+    }
+
+    uint32_t interval = options.rate ? 1000000 / options.rate : 0;
+    uint32_t start = PJON_MICROS();
+    uint32_t duration = options.seconds * 1000000;
+    auto loop = [&](std::vector<Node *> group) {
+      std::vector<uint32_t> next(group.size(), start);
+      while(running) {
+        for(uint16_t i = 0; i < group.size(); i++)
+          step(*group[i], next[i], interval);
+        std::this_thread::yield(); // Let the other threads run if cores are few
+      }
+    };
+    /* Instances are distributed among the threads, senders and receivers
+       in different ones because a sender waiting for the acknowledgement
+       blocks its thread. LocalUDPHost is not thread safe so LocalUDP
+       instances run in one thread (frames are delivered in memory) */
+    uint16_t count = std::min<size_t>(options.threads, local.size());
+    if(options.mode == "both") count = std::max<uint16_t>(count, 2);
+    if(options.strategy == "ludp") count = 1;
+    std::vector<std::vector<Node *> > groups(count);
+    uint16_t half = (count > 1 && options.mode == "both") ? count / 2 : 0;
+    for(uint16_t i = 0; i < local.size(); i++)
+      if(!half) groups[i % count].push_back(local[i]);
+      else if(local[i]->sender)
+        groups[half + (local[i]->id % (count - half))].push_back(local[i]);
+      else groups[local[i]->peer % half].push_back(local[i]);
+    std::vector<std::thread> threads;
+    for(uint16_t i = 0; i < count; i++)
+      threads.push_back(std::thread(loop, groups[i]));
+
+    while((uint32_t)(PJON_MICROS() - start) < duration) usleep(10000);
+    sending = false;
+    double elapsed = (uint32_t)(PJON_MICROS() - start) / 1000000.0;
+    usleep(DRAIN_TIME);
+    running = false;
+    for(std::thread &thread : threads) thread.join();
+    for(Node *node : local) node->stats = buses[node->id]->stats;
+    report(local, elapsed);
+    for(Node *node : local) delete buses[node->id];
+    return 0;
+  };
+
+  static void report(const std::vector<Node *> &local, double elapsed) {
+    uint64_t sent = 0, refused = 0, echoed = 0, received = 0, lost = 0;
+    uint64_t retries = 0, busy = 0, fails = 0;
+    std::vector<uint32_t> round_trips;
+    for(Node *node : local) {
+      if(node->sender) {
+        sent += node->sent;
+        refused += node->refused;
+        echoed += node->received;
+        round_trips.insert(
+          round_trips.end(), node->round_trips.begin(), node->round_trips.end()
+        );
+      } else received += node->received;
+      lost += node->stats.connection_lost;
+      retries += node->stats.retries;
+      busy += node->stats.busy;
+      fails += node->stats.fails;
+    }
+    std::sort(round_trips.begin(), round_trips.end());
+    double p[4] = {0, 0, 0, 0};
+    const double percentiles[3] = {50, 99, 99.9};
+    if(round_trips.size()) {
+      for(uint8_t i = 0; i < 3; i++)
+        p[i] = round_trips[
+          (size_t)(percentiles[i] / 100 * (round_trips.size() - 1) + 0.5)
+        ];
+      p[3] = round_trips.back();
+    }
+    bool tx = options.mode != "rx";
+    double loss = (tx && sent) ? 100.0 * (sent - echoed) / sent : 0;
+    if(options.json) {
+      printf(
+        "{\"strategy\":\"%s\",\"pairs\":%u,\"rate\":%u,\"length\":%u,"
+        "\"ack\":\"%s\",\"mode\":\"%s\",\"seconds\":%.3f,\"sent\":%llu,"
+        "\"refused\":%llu,\"received\":%llu,\"returned\":%llu,"
+        "\"loss_percent\":%.3f,\"throughput\":%.1f,\"connection_lost\":%llu,"
+        "\"retries\":%llu,\"busy\":%llu,\"fails\":%llu,\"rtt_p50_us\":%.0f,"
+        "\"rtt_p99_us\":%.0f,\"rtt_p999_us\":%.0f,\"rtt_max_us\":%.0f}\n",
+        options.strategy.c_str(), options.pairs, options.rate, options.length,
+        options.ack.c_str(), options.mode.c_str(), elapsed,
+        (unsigned long long)sent, (unsigned long long)refused,
+        (unsigned long long)received, (unsigned long long)echoed, loss,
+        (tx ? echoed : received) / elapsed, (unsigned long long)lost,
+        (unsigned long long)retries, (unsigned long long)busy,
+        (unsigned long long)fails, p[0], p[1], p[2], p[3]
+      );
+      return;
+    }
+    printf(
+      "Strategy %s, %u pairs, rate %u packets/s, payload %uB, ack %s, "
+      "mode %s, %.1fs\n",
+      options.strategy.c_str(), options.pairs, options.rate, options.length,
+      options.ack.c_str(), options.mode.c_str(), elapsed
+    );
+    if(tx)
+      printf(
+        "Sent:            %llu packets (%llu refused, send list full)\n"
+        "Returned:        %llu packets, %.1f packets/s, loss %.3f%%\n",
+        (unsigned long long)sent, (unsigned long long)refused,
+        (unsigned long long)echoed, echoed / elapsed, loss
+      );
+    if(options.mode != "tx")
+      printf(
+        "Received:        %llu packets, %.1f packets/s\n",
+        (unsigned long long)received, received / elapsed
+      );
+    printf(
+      "Connection lost: %llu, retries: %llu, busy: %llu, fails: %llu\n",
+      (unsigned long long)lost, (unsigned long long)retries,
+      (unsigned long long)busy, (unsigned long long)fails
+    );
+    if(round_trips.size())
+      printf(
+        "Round trip:      p50 %.0fus, p99 %.0fus, p99.9 %.0fus, max %.0fus\n",
+        p[0], p[1], p[2], p[3]
+      );
+  };
+};
+
+template<typename Strategy> PJON<Strategy> *Bench<Strategy>::buses[256];
+
+bool parse_address(const char *string, uint8_t *address) {
+  unsigned int a[4];
+  if(sscanf(string, "%u.%u.%u.%u", &a[0], &a[1], &a[2], &a[3]) != 4)
+    return false;
+  for(uint8_t i = 0; i < 4; i++) address[i] = a[i];
+  return true;
+};
+
+int main(int argc, char **argv) {
+  int option;
+  while((option = getopt(argc, argv, "s:n:r:w:l:a:cbit:m:p:T:j")) != -1) {
+    switch(option) {
+      case 's': options.strategy = optarg; break;
+      case 'n': options.pairs = atoi(optarg); break;
+      case 'r': options.rate = atoi(optarg); break;
+      case 'w': options.window = atoi(optarg); break;
+      case 'l': options.length = atoi(optarg); break;
+      case 'a': options.ack = optarg; break;
+      case 'c': options.crc32 = true; break;
+      case 'b': options.shared = true; break;
+      case 'i': options.no_info = true; break;
+      case 't': options.seconds = atof(optarg); break;
+      case 'm': options.mode = optarg; break;
+      case 'p':
+        if(!parse_address(optarg, options.address)) return 1;
+        break;
+      case 'T': options.threads = atoi(optarg); break;
+      case 'j': options.json = true; break;
+      default: return 1;
+    }
+  }
+  if(
+    options.pairs < 1 || options.pairs > MAX_PAIRS ||
+    options.length < 8 || options.length > 255 || !options.window ||
+    (options.ack != "none" && options.ack != "sync" &&
+      options.ack != "async") ||
+    (options.ack == "async" && options.no_info) ||
+    (options.mode != "both" && options.mode != "tx" && options.mode != "rx")
+  ) {
+    printf("Invalid options, see the description in Bench.cpp\n");
+    return 1;
+  }
+  for(uint16_t i = 1; i <= options.pairs; i++) {
+    nodes[i].id = i;
+    nodes[i].peer = RECEIVER_BASE + i;
+    nodes[i].sender = true;
+    nodes[RECEIVER_BASE + i].id = RECEIVER_BASE + i;
+    nodes[RECEIVER_BASE + i].peer = i;
+  }
+  if(options.strategy == "ludp") return Bench<LocalUDP>::run();
+  if(options.strategy == "gudp") return Bench<GlobalUDP>::run();
+  if(options.strategy == "etcp") return Bench<EthernetTCP>::run();
+  if(options.strategy == "lb") return Bench<Loopback>::run();
+  if(options.strategy == "shm") return Bench<SharedMemory>::run();
+  if(options.strategy == "uds") return Bench<UnixSocket>::run();
+  printf("Unknown strategy %s\n", options.strategy.c_str());
+  return 1;
+};
@@ -0,0 +1,50 @@
+/* Two PJON instances hosted in the same process communicate through the
+   Loopback strategy while all their frames are captured in capture.pcapng.
+   Open it with Wireshark after loading the pjon.lua dissector:
+   wireshark -X lua_script:pjon.lua capture.pcapng
+   Usage: ./Capture [seconds] */
+
+#define PJON_INCLUDE_LB
+#include <interfaces/LINUX/PJON_Capture_LINUX.h>
+#include <PJON.h>
+
+PJON<Loopback> transmitter(44);
+PJON<Loopback> receiver(45);
+
+uint32_t received = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+int main(int argc, char **argv) {
+  uint32_t seconds = (argc > 1) ? atoi(argv[1]) : 1;
+  if(!PJON_Capture::start("capture.pcapng")) {
+    printf("Unable to create capture.pcapng\n");
+    return 1;
+  }
+  receiver.set_receiver(receiver_function);
+  receiver.begin();
+  transmitter.begin();
+
+  uint32_t sent = 0;
+  uint32_t time = millis();
+  while((uint32_t)(millis() - time) < seconds * 1000) {
+    if(transmitter.send_packet(45, "Captured payload", 16) == PJON_ACK)
+      sent++;
+    receiver.receive();
+  }
+  PJON_Capture::stop();
+  printf(
+    "Sent: %u packets, received: %u, captured: %llu frames, dropped: %llu\n",
+    sent,
+    received,
+    (unsigned long long)PJON_Capture::get_captured(),
+    (unsigned long long)PJON_Capture::get_dropped()
+  );
+  return 0;
+};
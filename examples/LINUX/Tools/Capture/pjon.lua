@@ -0,0 +1,159 @@
+-- Wireshark dissector for the PJON frames captured by PJON_Capture_LINUX
+-- (link type LINKTYPE_USER0, 6 bytes capture header followed by the frame).
+-- Usage: wireshark -X lua_script:pjon.lua capture.pcapng
+-- or copy it in the Wireshark personal plugins directory.
+
+local pjon = Proto("pjon", "PJON")
+
+local directions = { [1] = "Received", [2] = "Transmitted" }
+local results = {
+  [6] = "ACK", [21] = "NAK", [666] = "BUSY", [65535] = "FAIL"
+}
+
+local f = pjon.fields
+f.version   = ProtoField.uint8("pjon.capture.version", "Capture version")
+f.direction = ProtoField.uint8("pjon.capture.direction", "Direction",
+  base.DEC, directions)
+f.result    = ProtoField.uint16("pjon.capture.result", "Result",
+  base.DEC, results)
+f.device    = ProtoField.uint8("pjon.capture.device_id", "Device id")
+
+f.id        = ProtoField.uint8("pjon.id", "Recipient id")
+f.header    = ProtoField.uint16("pjon.header", "Header", base.HEX)
+f.mode      = ProtoField.bool("pjon.header.mode", "Shared network", 16, nil,
+  0x0001)
+f.tx_info   = ProtoField.bool("pjon.header.tx_info", "Sender info", 16, nil,
+  0x0002)
+f.ack_req   = ProtoField.bool("pjon.header.ack_req",
+  "Synchronous acknowledgement", 16, nil, 0x0004)
+f.ack_mode  = ProtoField.bool("pjon.header.ack_mode",
+  "Asynchronous acknowledgement", 16, nil, 0x0008)
+f.address   = ProtoField.bool("pjon.header.address", "Addressing related",
+  16, nil, 0x0010)
+f.crc_bit   = ProtoField.bool("pjon.header.crc32", "CRC32", 16, nil, 0x0020)
+f.ext_len   = ProtoField.bool("pjon.header.ext_length", "Extended length",
+  16, nil, 0x0040)
+f.ext_head  = ProtoField.bool("pjon.header.ext_header", "Extended header",
+  16, nil, 0x0080)
+f.routing   = ProtoField.bool("pjon.header.routing", "Routing", 16, nil,
+  0x4000)
+f.segm      = ProtoField.bool("pjon.header.segmentation", "Segmentation", 16,
+  nil, 0x2000)
+f.session   = ProtoField.bool("pjon.header.session", "Session", 16, nil,
+  0x1000)
+f.parity    = ProtoField.bool("pjon.header.parity", "Parity", 16, nil,
+  0x0800)
+f.encoding  = ProtoField.bool("pjon.header.encoding", "Encoding", 16, nil,
+  0x0400)
+f.comp      = ProtoField.bool("pjon.header.compression", "Data compression",
+  16, nil, 0x0200)
+f.crypt     = ProtoField.bool("pjon.header.encryption", "Encryption", 16,
+  nil, 0x0100)
+f.length    = ProtoField.uint16("pjon.length", "Length")
+f.crc8_head = ProtoField.uint8("pjon.header_crc", "Header CRC8", base.HEX)
+f.rx_bus    = ProtoField.bytes("pjon.rx_bus_id", "Recipient bus id",
+  base.DOT)
+f.tx_bus    = ProtoField.bytes("pjon.tx_bus_id", "Sender bus id", base.DOT)
+f.sender    = ProtoField.uint8("pjon.sender_id", "Sender id")
+f.packet_id = ProtoField.uint16("pjon.packet_id", "Packet id")
+f.payload   = ProtoField.bytes("pjon.payload", "Payload")
+f.crc8      = ProtoField.uint8("pjon.crc8", "CRC8", base.HEX)
+f.crc32     = ProtoField.uint32("pjon.crc32", "CRC32", base.HEX)
+
+function pjon.dissector(buffer, pinfo, tree)
+  if buffer:len() < 6 then return 0 end
+  pinfo.cols.protocol = "PJON"
+  local root = tree:add(pjon, buffer(), "PJON")
+
+  local capture = root:add(buffer(0, 6), "Capture header")
+  capture:add(f.version, buffer(0, 1))
+  capture:add(f.direction, buffer(1, 1))
+  capture:add(f.result, buffer(2, 2))
+  capture:add(f.device, buffer(4, 1))
+  local direction = buffer(1, 1):uint()
+  local result = buffer(2, 2):uint()
+  local device = buffer(4, 1):uint()
+
+  local frame = buffer(6):tvb()
+  local available = frame:len()
+  if available < 4 then return buffer:len() end
+  local o = 0
+  root:add(f.id, frame(0, 1))
+  local header = frame(1, 1):uint()
+  local ext_head = bit.band(header, 0x80) ~= 0
+  local header_range = frame(1, 1)
+  if ext_head then
+    header = frame(1, 2):le_uint()
+    header_range = frame(1, 2)
+  end
+  local h = root:add(f.header, header_range, header)
+  for _, field in ipairs({ f.mode, f.tx_info, f.ack_req, f.ack_mode,
+    f.address, f.crc_bit, f.ext_len, f.ext_head }) do
+    h:add(field, header_range, header)
+  end
+  if ext_head then
+    for _, field in ipairs({ f.routing, f.segm, f.session, f.parity,
+      f.encoding, f.comp, f.crypt }) do
+      h:add(field, header_range, header)
+    end
+  end
+  o = ext_head and 3 or 2
+  local ext_len = bit.band(header, 0x40) ~= 0
+  local length
+  if ext_len then
+    length = frame(o, 2):uint()
+    root:add(f.length, frame(o, 2))
+    o = o + 2
+  else
+    length = frame(o, 1):uint()
+    root:add(f.length, frame(o, 1))
+    o = o + 1
+  end
+  root:add(f.crc8_head, frame(o, 1))
+  o = o + 1
+
+  local shared = bit.band(header, 0x01) ~= 0
+  local tx_info = bit.band(header, 0x02) ~= 0
+  local async_ack = tx_info and bit.band(header, 0x08) ~= 0
+  local crc32 = bit.band(header, 0x20) ~= 0
+  local crc_length = crc32 and 4 or 1
+  local sender = nil
+  if length > available then length = available end
+  if shared and o + 4 <= length then
+    root:add(f.rx_bus, frame(o, 4))
+    o = o + 4
+  end
+  if tx_info then
+    if shared and o + 4 <= length then
+      root:add(f.tx_bus, frame(o, 4))
+      o = o + 4
+    end
+    if o < length then
+      sender = frame(o, 1):uint()
+      root:add(f.sender, frame(o, 1))
+      o = o + 1
+    end
+    if async_ack and o + 2 <= length then
+      root:add(f.packet_id, frame(o, 2), frame(o, 2):le_uint())
+      o = o + 2
+    end
+  end
+  local payload = length - o - crc_length
+  if payload > 0 then root:add(f.payload, frame(o, payload)) end
+  if payload >= 0 then
+    if crc32 then root:add(f.crc32, frame(length - 4, 4))
+    else root:add(f.crc8, frame(length - 1, 1)) end
+  end
+
+  local from = sender and tostring(sender) or "?"
+  local to = frame(0, 1):uint()
+  pinfo.cols.src = (direction == 2) and tostring(device) or from
+  pinfo.cols.dst = tostring(to)
+  pinfo.cols.info = string.format("%s %s -> %u length %u %s",
+    directions[direction] or "?",
+    (direction == 2) and tostring(device) or from,
+    to, length, results[result] or tostring(result))
+  return buffer:len()
+end
+
+DissectorTable.get("wtap_encap"):add(wtap.USER0, pjon)
@@ -0,0 +1,157 @@
+/* Decode a PJDLS (AnalogSampling) or PJDLR (OverSampling) capture into PJON
+   frames, printing for each frame its timing and amplitude margins.
+   The capture can be a raw file of 8 or 16 bits unsigned samples (as saved
+   by most logic analyzers and SDR tools) or a text file with one sample per
+   line (the last number of each line is used, lines containing letters like
+   CSV headers are skipped).
+   Usage: ./WaveformDecoder [-c as|os] [-m mode] [-w bit width us]
+                            [-s bit spacer us] [-r sample rate Hz]
+                            [-f u8|u16|text] [-t threshold] [-v] capture */
+
+#include <utils/PJON_WaveformDecoder.h>
+
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// PJDLS communication modes (see the PJDLS specification)
+const uint16_t as_timing[5][2] = {
+  {750, 1050}, {572, 728}, {188, 428}, {128, 290}, {56, 128}
+};
+
+bool verbose = false;
+uint32_t responses = 0;
+
+void frame_handler(const PJON_Waveform_Frame &frame, void *custom_pointer) {
+  if(frame.response) responses++;
+  printf(
+    "%12.6f %-8s length %4u  crc %-3s  margin min %7.1fus mean %7.1fus  "
+    "pad error %6.1fus  amplitude min %d\n",
+    frame.time,
+    frame.response ? "response" : frame.complete ? "frame" : "partial",
+    frame.length,
+    (frame.crc == WD_NOT_CHECKED) ? "-" : frame.crc ? "ok" : "bad",
+    frame.min_margin,
+    frame.mean_margin,
+    frame.max_pad_error,
+    frame.min_amplitude
+  );
+  printf("             ");
+  for(uint16_t i = 0; i < frame.length; i++) printf(" %02X", frame.content[i]);
+  printf("\n");
+  if(!verbose) return;
+  for(uint16_t i = 0; i < frame.wire_length; i++) {
+    const PJON_Waveform_Byte &b = frame.wire[i];
+    printf("              %02X pad %7.1fus margins", b.value, b.pad);
+    for(uint8_t j = 0; j < 8; j++) printf(" %5.1f", b.margin[j]);
+    printf("  amplitudes");
+    for(uint8_t j = 0; j < 8; j++) printf(" %d", b.amplitude[j]);
+    printf("\n");
+  }
+};
+
+int main(int argc, char **argv) {
+  uint8_t line_code = WD_PJDLS;
+  uint8_t mode = 1;
+  uint16_t bit_width = 0, bit_spacer = 0;
+  double rate = 1000000;
+  int32_t threshold = WD_AUTO;
+  const char *format = "u16";
+  int option;
+  while((option = getopt(argc, argv, "c:m:w:s:r:f:t:v")) != -1) {
+    switch(option) {
+      case 'c': line_code = (optarg[0] == 'o') ? WD_PJDLR : WD_PJDLS; break;
+      case 'm': mode = atoi(optarg); break;
+      case 'w': bit_width = atoi(optarg); break;
+      case 's': bit_spacer = atoi(optarg); break;
+      case 'r': rate = atof(optarg); break;
+      case 'f': format = optarg; break;
+      case 't': threshold = atoi(optarg); break;
+      case 'v': verbose = true; break;
+      default: return 1;
+    }
+  }
+  if(optind >= argc || mode < 1 || mode > 5 || rate <= 0) {
+    printf(
+      "Usage: %s [-c as|os] [-m mode] [-w bit width us] [-s bit spacer us]\n"
+      "          [-r sample rate Hz] [-f u8|u16|text] [-t threshold] [-v] "
+      "capture\n", argv[0]
+    );
+    return 1;
+  }
+  if(!bit_width)
+    bit_width = (line_code == WD_PJDLR) ? 512 : as_timing[mode - 1][0];
+  if(!bit_spacer)
+    bit_spacer = (line_code == WD_PJDLR) ? 328 : as_timing[mode - 1][1];
+
+  int fd = open(argv[optind], O_RDONLY);
+  struct stat info;
+  if(fd < 0 || fstat(fd, &info) < 0 || !info.st_size) {
+    printf("Unable to open %s\n", argv[optind]);
+    return 1;
+  }
+  const uint8_t *file = (const uint8_t *)
+    mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(file == MAP_FAILED) return 1;
+
+  PJON_WaveformDecoder decoder(line_code, rate, bit_width, bit_spacer);
+  decoder.set_threshold(threshold);
+  decoder.set_handler(frame_handler);
+
+  uint64_t count;
+  std::vector<uint16_t> samples;
+  if(!strcmp(format, "text")) {
+    const uint8_t *p = file, *end = file + info.st_size;
+    while(p < end) {
+      const uint8_t *line = p;
+      int64_t value = -1;
+      bool text = false;
+      for(; (p < end) && (*p != '\n'); p++) {
+        if(((*p | 0x20) >= 'a') && ((*p | 0x20) <= 'z') && ((*p | 0x20) != 'e'))
+          text = true;
+        if((*p >= '0') && (*p <= '9')) {
+          value = ((p > line) && (p[-1] >= '0') && (p[-1] <= '9')) ?
+            (value * 10) + (*p - '0') : (*p - '0');
+          if(value > 65535) value = 65535;
+        }
+      }
+      p++;
+      if(!text && (value >= 0)) samples.push_back(value);
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  if(!strcmp(format, "u8")) {
+    count = info.st_size;
+    decoder.decode(file, count);
+  } else if(!strcmp(format, "u16")) {
+    count = info.st_size / 2;
+    decoder.decode((const uint16_t *)file, count);
+  } else {
+    count = samples.size();
+    decoder.decode(samples.data(), count);
+  }
+  double elapsed = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start
+  ).count();
+
+  printf(
+    "\n%u frames (%u responses), %u errors, threshold %d\n"
+    "%llu samples (%.3fs of capture) decoded in %.3fs, %.0fx real time\n",
+    decoder.get_frames(),
+    responses,
+    decoder.get_errors(),
+    decoder.get_threshold(),
+    (unsigned long long)count,
+    count / rate,
+    elapsed,
+    (elapsed > 0) ? (count / rate) / elapsed : 0
+  );
+  munmap((void *)file, info.st_size);
+  close(fd);
+  return 0;
+};
@@ -0,0 +1,324 @@
+/* PJON_Capture_LINUX is a capture sink for the PJON capture hook (see
+   PJON_CAPTURE in PJONDefines.h). Every frame transmitted or received by
+   the PJON instances of the process is saved in a pcap-ng file that can be
+   opened with Wireshark using the PJON dissector present in
+   examples/LINUX/Tools/Capture/pjon.lua.
+   Frames are copied in a lock-free queue and written to the file by a
+   background thread, so capturing does not block the caller: if the queue is
+   full the frame is dropped and counted by PJON_Capture::get_dropped().
+   Include it before PJON.h:
+
+   #include <interfaces/LINUX/PJON_Capture_LINUX.h>
+   #include <PJON.h>
+   ...
+   PJON_Capture::start("pjon.pcapng");
+   ...
+   PJON_Capture::stop();
+
+   Each PJON instance is saved as a pcap-ng interface named as its strategy,
+   link type LINKTYPE_USER0 (147). Each packet starts with a 6 bytes capture
+   header followed by the frame:
+   - version (1)
+   - direction (1: received, 2: transmitted)
+   - result (2 bytes big endian: PJON_ACK, PJON_NAK, PJON_BUSY or PJON_FAIL)
+   - device id of the instance
+   - reserved (0)
+   Received frames are captured with PJON_ACK if their CRC is correct or
+   PJON_NAK if not, transmitted frames when their response is known.
+   Timestamps are taken with CLOCK_REALTIME.
+   _____________________________________________________________________________
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cxxabi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <typeinfo>
+#include <vector>
+
+#define PJON_CAPTURE(BUS, DIRECTION, FRAME, LENGTH, RESULT) \
+  PJON_Capture::record(BUS, DIRECTION, FRAME, LENGTH, RESULT)
+
+#include <PJONDefines.h>
+
+/* Frames the queue can contain (must be a power of 2): */
+#ifndef PJON_CAPTURE_BUFFER
+  #define PJON_CAPTURE_BUFFER 1024
+#endif
+
+/* Maximum frame length saved, longer frames are truncated: */
+#ifndef PJON_CAPTURE_SNAPLEN
+  #define PJON_CAPTURE_SNAPLEN PJON_PACKET_MAX_LENGTH
+#endif
+
+#define PJON_CAPTURE_HEADER   6
+#define PJON_CAPTURE_LINKTYPE 147 // LINKTYPE_USER0
+
+struct PJON_Capture_Slot {
+  std::atomic<size_t> sequence;
+  const void         *bus;
+  const char         *strategy; // Mangled type name
+  uint64_t            time;     // Microseconds since epoch
+  uint16_t            length;
+  uint16_t            result;
+  uint8_t             direction;
+  uint8_t             device_id;
+  uint8_t             frame[PJON_CAPTURE_SNAPLEN];
+};
+
+class PJON_Capture {
+  public:
+    /* Create the pcap-ng file and start the writer thread: */
+
+    static bool start(const char *path) {
+      State &s = state();
+      if(s.running.load()) return false;
+      s.file = fopen(path, "wb");
+      if(!s.file) return false;
+      setvbuf(s.file, NULL, _IOFBF, 1 << 16);
+      if(!s.slots) s.slots = new PJON_Capture_Slot[PJON_CAPTURE_BUFFER];
+      for(size_t i = 0; i < PJON_CAPTURE_BUFFER; i++)
+        s.slots[i].sequence.store(i, std::memory_order_relaxed);
+      s.enqueue.store(0, std::memory_order_relaxed);
+      s.dequeue = 0;
+      s.captured.store(0);
+      s.dropped.store(0);
+      s.interfaces.clear();
+      write_section_header(s.file);
+      s.running.store(true, std::memory_order_release);
+      s.writer = std::thread(writer);
+      return true;
+    };
+
+
+    /* Write the frames still queued and close the file: */
+
+    static void stop() {
+      State &s = state();
+      if(!s.running.load()) return;
+      s.running.store(false, std::memory_order_release);
+      s.writer.join();
+      fclose(s.file);
+      s.file = NULL;
+    };
+
+
+    /* Called by the PJON_CAPTURE hook, never blocks: */
+
+    template<typename Bus>
+    static void record(
+      Bus *bus,
+      uint8_t direction,
+      const void *frame,
+      uint16_t length,
+      uint16_t result
+    ) {
+      State &s = state();
+      if(!s.running.load(std::memory_order_relaxed)) return;
+      size_t position = s.enqueue.load(std::memory_order_relaxed);
+      PJON_Capture_Slot *slot;
+      while(true) {
+        slot = &s.slots[position & (PJON_CAPTURE_BUFFER - 1)];
+        intptr_t difference = (intptr_t)
+          slot->sequence.load(std::memory_order_acquire) - (intptr_t)position;
+        if(!difference) {
+          if(s.enqueue.compare_exchange_weak(
+            position, position + 1, std::memory_order_relaxed
+          )) break;
+        } else if(difference < 0) {
+          s.dropped.fetch_add(1, std::memory_order_relaxed);
+          return;
+        } else position = s.enqueue.load(std::memory_order_relaxed);
+      }
+      struct timespec now;
+      clock_gettime(CLOCK_REALTIME, &now);
+      slot->bus = bus;
+      slot->strategy = typeid(bus->strategy).name();
+      slot->time = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+      slot->length = length;
+      slot->result = result;
+      slot->direction = direction;
+      slot->device_id = bus->device_id();
+      memcpy(
+        slot->frame,
+        frame,
+        (length < PJON_CAPTURE_SNAPLEN) ? length : PJON_CAPTURE_SNAPLEN
+      );
+      slot->sequence.store(position + 1, std::memory_order_release);
+    };
+
+
+    /* Frames written to the file: */
+
+    static uint64_t get_captured() {
+      return state().captured.load();
+    };
+
+
+    /* Frames lost because the queue was full: */
+
+    static uint64_t get_dropped() {
+      return state().dropped.load();
+    };
+
+  private:
+    struct State {
+      std::atomic<bool>        running;
+      std::atomic<size_t>      enqueue;
+      size_t                   dequeue;
+      std::atomic<uint64_t>    captured;
+      std::atomic<uint64_t>    dropped;
+      PJON_Capture_Slot       *slots;
+      FILE                    *file;
+      std::thread              writer;
+      std::vector<const void*> interfaces;
+      std::vector<uint8_t>     block;
+      State() :
+        running(false), enqueue(0), dequeue(0), captured(0), dropped(0),
+        slots(NULL), file(NULL) { };
+    };
+
+    static State &state() {
+      static State s;
+      return s;
+    };
+
+    static void writer() {
+      State &s = state();
+      while(true) {
+        bool running = s.running.load(std::memory_order_acquire);
+        uint32_t written = 0;
+        PJON_Capture_Slot *slot;
+        while(true) {
+          slot = &s.slots[s.dequeue & (PJON_CAPTURE_BUFFER - 1)];
+          if(slot->sequence.load(std::memory_order_acquire) != s.dequeue + 1)
+            break;
+          write_packet(s, *slot);
+          slot->sequence.store(
+            s.dequeue + PJON_CAPTURE_BUFFER, std::memory_order_release
+          );
+          s.dequeue++;
+          written++;
+        }
+        if(!running) break;
+        if(!written) {
+          fflush(s.file);
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+      fflush(s.file);
+    };
+
+    static void write_packet(State &s, const PJON_Capture_Slot &slot) {
+      uint32_t id = 0;
+      while(id < s.interfaces.size() && s.interfaces[id] != slot.bus) id++;
+      if(id == s.interfaces.size()) {
+        s.interfaces.push_back(slot.bus);
+        write_interface(s.file, slot);
+      }
+      uint16_t captured = (slot.length < PJON_CAPTURE_SNAPLEN) ?
+        slot.length : PJON_CAPTURE_SNAPLEN;
+      std::vector<uint8_t> &block = s.block;
+      block.clear();
+      append(block, id);
+      append(block, (uint32_t)(slot.time >> 32));
+      append(block, (uint32_t)slot.time);
+      append(block, (uint32_t)(PJON_CAPTURE_HEADER + captured));
+      append(block, (uint32_t)(PJON_CAPTURE_HEADER + slot.length));
+      uint8_t header[PJON_CAPTURE_HEADER] = {
+        1, slot.direction, (uint8_t)(slot.result >> 8), (uint8_t)slot.result,
+        slot.device_id, 0
+      };
+      block.insert(block.end(), header, header + PJON_CAPTURE_HEADER);
+      block.insert(block.end(), slot.frame, slot.frame + captured);
+      pad(block);
+      uint32_t flags = slot.direction; // epb_flags inbound / outbound
+      append_option(block, 2, &flags, 4);
+      append_option(block, 0, NULL, 0);
+      write_block(s.file, 6, block); // Enhanced packet block
+      s.captured.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    static void write_interface(FILE *file, const PJON_Capture_Slot &slot) {
+      int status;
+      char *demangled = abi::__cxa_demangle(slot.strategy, 0, 0, &status);
+      std::string name = status ? slot.strategy : demangled;
+      free(demangled);
+      char description[32];
+      snprintf(
+        description, sizeof(description), "PJON device id %u", slot.device_id
+      );
+      std::vector<uint8_t> block;
+      append(block, (uint16_t)PJON_CAPTURE_LINKTYPE);
+      append(block, (uint16_t)0);
+      append(block, (uint32_t)(PJON_CAPTURE_HEADER + PJON_CAPTURE_SNAPLEN));
+      append_option(block, 2, name.c_str(), name.size()); // if_name
+      append_option(block, 3, description, strlen(description));
+      append_option(block, 0, NULL, 0);
+      write_block(file, 1, block); // Interface description block
+    };
+
+    static void write_section_header(FILE *file) {
+      std::vector<uint8_t> block;
+      append(block, (uint32_t)0x1A2B3C4D); // Byte order magic
+      append(block, (uint16_t)1);
+      append(block, (uint16_t)0);
+      append(block, (uint32_t)0xFFFFFFFF); // Section length not specified
+      append(block, (uint32_t)0xFFFFFFFF);
+      write_block(file, 0x0A0D0D0A, block);
+    };
+
+    static void write_block(
+      FILE *file,
+      uint32_t type,
+      const std::vector<uint8_t> &body
+    ) {
+      uint32_t length = body.size() + 12;
+      fwrite(&type, 4, 1, file);
+      fwrite(&length, 4, 1, file);
+      fwrite(body.data(), 1, body.size(), file);
+      fwrite(&length, 4, 1, file);
+    };
+
+    template<typename T>
+    static void append(std::vector<uint8_t> &block, T value) {
+      const uint8_t *bytes = (const uint8_t *)&value;
+      block.insert(block.end(), bytes, bytes + sizeof(T));
+    };
+
+    static void append_option(
+      std::vector<uint8_t> &block,
+      uint16_t code,
+      const void *value,
+      uint16_t length
+    ) {
+      append(block, code);
+      append(block, length);
+      const uint8_t *bytes = (const uint8_t *)value;
+      if(length) block.insert(block.end(), bytes, bytes + length);
+      pad(block);
+    };
+
+    static void pad(std::vector<uint8_t> &block) {
+      while(block.size() % 4) block.push_back(0);
+    };
+};
@@ -0,0 +1,296 @@
+/* PJON_Registry_LINUX is a persistent device registry for PJONMaster (see
+   PJON_REGISTRY_LOAD in PJONDefines.h). The device table of the master
+   (rid, id, state and the time a packet of the device was last received) is
+   saved in a memory mapped file updated each time an entry changes, so when
+   the master restarts begin restores it without listing the ids. The ids
+   restored are then probed one at a time by update, those not acknowledged
+   are removed. Include it before PJONMaster.h and open the registry before
+   begin:
+
+   #include <interfaces/LINUX/PJON_Registry_LINUX.h>
+   #include <PJONMaster.h>
+   ...
+   PJON_Registry::open(&master, "devices.pjr");
+   master.begin();
+   ...
+   PJON_Registry::close(&master);
+
+   Updates are crash-consistent: each entry is stored in two slots with a
+   generation number and a CRC32, the older slot is overwritten so if the
+   write is interrupted the previous version of the entry is still valid.
+   Table changes are flushed with msync (if PJON_REGISTRY_SYNC is true),
+   last seen times are left to the kernel. A file created by a master with
+   a different bus id or PJON_MAX_DEVICES is reinitialized.
+   _____________________________________________________________________________
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#define PJON_INCLUDE_REGISTRY true
+#define PJON_REGISTRY_LOAD(MASTER) PJON_Registry::load(MASTER)
+#define PJON_REGISTRY_STORE(MASTER, ID) PJON_Registry::store(MASTER, ID)
+#define PJON_REGISTRY_SEEN(MASTER, ID) PJON_Registry::seen(MASTER, ID)
+
+#include <PJONDefines.h>
+
+/* Flush each table change to the storage device: */
+#ifndef PJON_REGISTRY_SYNC
+  #define PJON_REGISTRY_SYNC true
+#endif
+
+#define PJON_REGISTRY_VERSION 1
+
+struct PJON_Registry_Record {
+  uint32_t generation; // 0 if the slot was never written
+  uint32_t rid;
+  uint64_t last_seen;  // Seconds since epoch, 0 if never seen
+  uint8_t  id;
+  uint8_t  state;      // 0 free, 1 reserved, 2 active
+  uint8_t  padding[2];
+  uint32_t crc;        // CRC32 of the previous fields
+};
+
+struct PJON_Registry_File {
+  char                 magic[4]; // "PJRG"
+  uint8_t              version;
+  uint8_t              max_devices;
+  uint8_t              bus_id[4];
+  uint8_t              padding[6];
+  PJON_Registry_Record records[PJON_MAX_DEVICES][2];
+};
+
+class PJON_Registry {
+  public:
+    /* Map the file of the master's registry, it is created or
+       reinitialized if not valid: */
+
+    template<typename Master>
+    static bool open(Master *master, const char *path) {
+      if(find(master)) return false;
+      int fd = ::open(path, O_RDWR | O_CREAT, 0644);
+      if(fd < 0) return false;
+      if(ftruncate(fd, sizeof(PJON_Registry_File)) < 0) {
+        ::close(fd);
+        return false;
+      }
+      void *map = mmap(
+        NULL,
+        sizeof(PJON_Registry_File),
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        fd,
+        0
+      );
+      if(map == MAP_FAILED) {
+        ::close(fd);
+        return false;
+      }
+      Entry entry;
+      entry.master = master;
+      entry.file = (PJON_Registry_File *)map;
+      entry.fd = fd;
+      entry.attached = false;
+      if(
+        memcmp(entry.file->magic, "PJRG", 4) ||
+        (entry.file->version != PJON_REGISTRY_VERSION) ||
+        (entry.file->max_devices != PJON_MAX_DEVICES) ||
+        memcmp(entry.file->bus_id, master->bus_id, 4)
+      ) {
+        memset(entry.file, 0, sizeof(PJON_Registry_File));
+        memcpy(entry.file->magic, "PJRG", 4);
+        entry.file->version = PJON_REGISTRY_VERSION;
+        entry.file->max_devices = PJON_MAX_DEVICES;
+        memcpy(entry.file->bus_id, master->bus_id, 4);
+        sync_range(entry.file, sizeof(PJON_Registry_File));
+      }
+      entries().push_back(entry);
+      return true;
+    };
+
+
+    /* Unmap the file of the master's registry: */
+
+    static void close(const void *master) {
+      std::vector<Entry> &list = entries();
+      for(size_t i = 0; i < list.size(); i++)
+        if(list[i].master == master) {
+          msync(list[i].file, sizeof(PJON_Registry_File), MS_SYNC);
+          munmap(list[i].file, sizeof(PJON_Registry_File));
+          ::close(list[i].fd);
+          list.erase(list.begin() + i);
+          return;
+        }
+    };
+
+
+    /* Called by PJON_REGISTRY_LOAD, add the active ids saved to the device
+       table, returns true if at least one is restored. From then on the
+       changes of the table are saved: */
+
+    template<typename Master>
+    static bool load(Master *master) {
+      Entry *entry = find(master);
+      if(!entry) return false;
+      uint8_t restored = 0;
+      for(uint16_t id = 1; id <= PJON_MAX_DEVICES; id++) {
+        const PJON_Registry_Record *record = latest(*entry, id);
+        if(record && (record->state == 2))
+          if(master->add_id(id, record->rid, true)) restored++;
+      }
+      entry->attached = true;
+      return restored;
+    };
+
+
+    /* Called by PJON_REGISTRY_STORE, save the entry of the id or empty the
+       table if id is 0: */
+
+    template<typename Master>
+    static void store(Master *master, uint8_t id) {
+      Entry *entry = find(master);
+      if(!entry || !entry->attached) return;
+      if(!id) {
+        for(uint16_t i = 1; i <= PJON_MAX_DEVICES; i++)
+          if(latest(*entry, i)) write(*entry, i, 0, 0, 0, false);
+        if(PJON_REGISTRY_SYNC)
+          sync_range(entry->file, sizeof(PJON_Registry_File));
+        return;
+      }
+      if(id > PJON_MAX_DEVICES) return;
+      const PJON_Registry_Record *record = latest(*entry, id);
+      uint32_t rid = master->ids[id - 1].rid;
+      uint8_t state = master->ids[id - 1].state ? 2 : (rid ? 1 : 0);
+      uint64_t seen = (record && record->rid == rid) ? record->last_seen : 0;
+      if(state == 2 && !seen) seen = time(NULL);
+      write(*entry, id, rid, state, seen, PJON_REGISTRY_SYNC);
+    };
+
+
+    /* Called by PJON_REGISTRY_SEEN, save the time a packet of the id was
+       received (updated once per second at most): */
+
+    template<typename Master>
+    static void seen(Master *master, uint8_t id) {
+      Entry *entry = find(master);
+      if(!entry || !entry->attached) return;
+      const PJON_Registry_Record *record = latest(*entry, id);
+      uint64_t now = time(NULL);
+      if(!record || record->last_seen == now) return;
+      write(*entry, id, record->rid, record->state, now, false);
+    };
+
+
+    /* Time a packet of the id was last received (seconds since epoch),
+       0 if never received or not registered: */
+
+    static uint64_t get_last_seen(const void *master, uint8_t id) {
+      Entry *entry = find(master);
+      if(!entry || !id || id > PJON_MAX_DEVICES) return 0;
+      const PJON_Registry_Record *record = latest(*entry, id);
+      return record ? record->last_seen : 0;
+    };
+
+  private:
+    struct Entry {
+      const void         *master;
+      PJON_Registry_File *file;
+      int                 fd;
+      bool                attached; // Changes saved after load
+    };
+
+    static std::vector<Entry> &entries() {
+      static std::vector<Entry> list;
+      return list;
+    };
+
+    static Entry *find(const void *master) {
+      std::vector<Entry> &list = entries();
+      for(size_t i = 0; i < list.size(); i++)
+        if(list[i].master == master) return &list[i];
+      return NULL;
+    };
+
+    static uint32_t crc(const PJON_Registry_Record &record) {
+      return PJON_crc32::compute(
+        (const uint8_t *)&record,
+        offsetof(PJON_Registry_Record, crc)
+      );
+    };
+
+    /* Slot of the id with the highest generation and a valid CRC, NULL if
+       none or if the entry is free: */
+
+    static const PJON_Registry_Record *latest(Entry &entry, uint16_t id) {
+      const PJON_Registry_Record *slots = entry.file->records[id - 1];
+      const PJON_Registry_Record *result = NULL;
+      for(uint8_t i = 0; i < 2; i++) {
+        if(!slots[i].generation || slots[i].id != id) continue;
+        if(crc(slots[i]) != slots[i].crc) continue;
+        if(!result || (int32_t)(slots[i].generation - result->generation) > 0)
+          result = &slots[i];
+      }
+      return (result && result->state) ? result : NULL;
+    };
+
+    /* Overwrite the slot not holding the latest version of the entry: */
+
+    static void write(
+      Entry &entry,
+      uint16_t id,
+      uint32_t rid,
+      uint8_t state,
+      uint64_t last_seen,
+      bool flush
+    ) {
+      PJON_Registry_Record *slots = entry.file->records[id - 1];
+      uint32_t generation = 0;
+      uint8_t target = 0;
+      for(uint8_t i = 0; i < 2; i++)
+        if(
+          slots[i].generation && (slots[i].id == id) &&
+          (crc(slots[i]) == slots[i].crc) &&
+          (!generation || (int32_t)(slots[i].generation - generation) > 0)
+        ) {
+          generation = slots[i].generation;
+          target = !i;
+        }
+      PJON_Registry_Record record;
+      memset(&record, 0, sizeof(record));
+      record.generation = (generation + 1) ? (generation + 1) : 1;
+      record.rid = rid;
+      record.last_seen = last_seen;
+      record.id = id;
+      record.state = state;
+      record.crc = crc(record);
+      memcpy(&slots[target], &record, sizeof(record));
+      if(flush) sync_range(&slots[target], sizeof(record));
+    };
+
+    /* Flush the pages containing the range to the storage device: */
+
+    static void sync_range(const void *start, size_t length) {
+      uintptr_t page = sysconf(_SC_PAGESIZE);
+      uintptr_t begin = (uintptr_t)start & ~(page - 1);
+      msync((void *)begin, (uintptr_t)start + length - begin, MS_SYNC);
+    };
+};
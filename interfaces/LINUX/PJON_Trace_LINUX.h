@@ -0,0 +1,238 @@
+/* PJON_Trace_LINUX is a tracing sink for the PJON tracing hooks (see
+   PJON_TRACE in PJONDefines.h). Events are recorded in a lock-free ring
+   buffer shared by all the PJON instances and threads of the process (the
+   oldest events are overwritten when it is full) and can be saved as a
+   Chrome trace / Perfetto JSON file, open it with chrome://tracing or
+   https://ui.perfetto.dev to see each stage of the send and receive path,
+   acknowledgement waits and back-offs.
+   Include it before PJON.h:
+
+   #include <interfaces/LINUX/PJON_Trace_LINUX.h>
+   #include <PJON.h>
+   ...
+   PJON_Trace::save("pjon.json");
+
+   receive calls where nothing is received and update calls where no packet
+   is sent or scheduled are not recorded to avoid filling the buffer.
+   _____________________________________________________________________________
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/* Events kept in the ring buffer (must be a power of 2): */
+#ifndef PJON_TRACE_BUFFER
+  #define PJON_TRACE_BUFFER 65536
+#endif
+
+#define PJON_TRACE_START(T) uint32_t T = PJON_MICROS()
+#define PJON_TRACE(BUS, EVENT, START, END, RESULT) \
+  PJON_Trace::record(BUS, (BUS)->device_id(), EVENT, START, END, RESULT)
+
+#include <PJONDefines.h>
+
+struct PJON_Trace_Slot {
+  std::atomic<uint64_t>    sequence; // Index + 1 of the event, 0 if writing
+  std::atomic<const void*> bus;
+  std::atomic<uint64_t>    time;     // start << 32 | end
+  std::atomic<uint32_t>    info;     // result << 16 | event << 8 | device id
+};
+
+struct PJON_Trace_Event {
+  const void *bus;
+  uint32_t    start;
+  uint32_t    end;
+  uint16_t    result;
+  uint8_t     event;
+  uint8_t     device_id;
+};
+
+class PJON_Trace {
+  public:
+    static void record(
+      const void *bus,
+      uint8_t device_id,
+      uint8_t event,
+      uint32_t start,
+      uint32_t end,
+      uint16_t result
+    ) {
+      static thread_local const void *last_bus = NULL;
+      static thread_local uint32_t last_start = 0;
+      if(event == PJON_TRACE_RECEIVE && result == PJON_FAIL) return;
+      if( // Keep update only if it contains events
+        event == PJON_TRACE_UPDATE &&
+        (last_bus != bus || (int32_t)(last_start - start) < 0)
+      ) return;
+      if((int32_t)(end - start) < 0) end = start; // Back-off already elapsed
+      last_bus = bus;
+      last_start = start;
+      uint64_t i = head().fetch_add(1, std::memory_order_relaxed);
+      PJON_Trace_Slot &slot = slots()[i & (PJON_TRACE_BUFFER - 1)];
+      slot.sequence.store(0, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.bus.store(bus, std::memory_order_relaxed);
+      slot.time.store(((uint64_t)start << 32) | end, std::memory_order_relaxed);
+      slot.info.store(
+        ((uint32_t)result << 16) | ((uint32_t)event << 8) | device_id,
+        std::memory_order_relaxed
+      );
+      slot.sequence.store(i + 1, std::memory_order_release);
+    };
+
+
+    /* Copy the events present in the buffer, oldest first: */
+
+    static std::vector<PJON_Trace_Event> snapshot() {
+      std::vector<PJON_Trace_Event> events;
+      uint64_t end = head().load(std::memory_order_acquire);
+      uint64_t i = (end > PJON_TRACE_BUFFER) ? end - PJON_TRACE_BUFFER : 0;
+      events.reserve(end - i);
+      for(; i < end; i++) {
+        PJON_Trace_Slot &slot = slots()[i & (PJON_TRACE_BUFFER - 1)];
+        if(slot.sequence.load(std::memory_order_acquire) != i + 1) continue;
+        PJON_Trace_Event e;
+        e.bus = slot.bus.load(std::memory_order_relaxed);
+        uint64_t time = slot.time.load(std::memory_order_relaxed);
+        uint32_t info = slot.info.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(slot.sequence.load(std::memory_order_relaxed) != i + 1) continue;
+        e.start = time >> 32;
+        e.end = (uint32_t)time;
+        e.result = info >> 16;
+        e.event = info >> 8;
+        e.device_id = info;
+        events.push_back(e);
+      }
+      return events;
+    };
+
+
+    /* Events recorded since the last clear (also the overwritten ones): */
+
+    static uint64_t get_count() {
+      return head().load(std::memory_order_relaxed);
+    };
+
+
+    static void clear() {
+      for(uint32_t i = 0; i < PJON_TRACE_BUFFER; i++)
+        slots()[i].sequence.store(0, std::memory_order_relaxed);
+      head().store(0, std::memory_order_release);
+    };
+
+
+    /* Save the events present in the buffer in Chrome trace JSON format.
+       Each PJON instance is represented as a thread, back-offs as async
+       events. Returns the number of events saved or -1 on error: */
+
+    static int32_t save(const char *path) {
+      FILE *file = fopen(path, "w");
+      if(!file) return -1;
+      std::vector<PJON_Trace_Event> events = snapshot();
+      std::vector<const void *> buses;
+      fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+      fprintf(
+        file,
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+        "\"args\":{\"name\":\"PJON\"}}"
+      );
+      uint32_t last_end = events.size() ? events[0].end : 0;
+      uint64_t time = last_end;
+      for(uint32_t i = 0; i < events.size(); i++) {
+        const PJON_Trace_Event &e = events[i];
+        uint32_t tid = 0;
+        while(tid < buses.size() && buses[tid] != e.bus) tid++;
+        if(tid == buses.size()) {
+          buses.push_back(e.bus);
+          fprintf(
+            file,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"name\":\"Bus %u device id %u\"}}",
+            tid + 1, tid + 1, e.device_id
+          );
+        }
+        // Timestamps are 32 bits microseconds, unwrap them using end times
+        time += (int64_t)(int32_t)(e.end - last_end);
+        last_end = e.end;
+        uint32_t duration = e.end - e.start;
+        double start = (double)(int64_t)(time - duration);
+        if(e.event == PJON_TRACE_BACK_OFF) {
+          fprintf(
+            file,
+            ",\n{\"name\":\"back_off\",\"cat\":\"PJON\",\"ph\":\"b\","
+            "\"id\":%u,\"ts\":%.0f,\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"attempt\":%u}}"
+            ",\n{\"name\":\"back_off\",\"cat\":\"PJON\",\"ph\":\"e\","
+            "\"id\":%u,\"ts\":%.0f,\"pid\":1,\"tid\":%u}",
+            i, start, tid + 1, e.result, i, start + duration, tid + 1
+          );
+          continue;
+        }
+        fprintf(
+          file,
+          ",\n{\"name\":\"%s\",\"cat\":\"PJON\",\"ph\":\"X\",\"ts\":%.0f,"
+          "\"dur\":%u,\"pid\":1,\"tid\":%u,\"args\":{",
+          event_name(e.event), start, duration, tid + 1
+        );
+        if(
+          e.event == PJON_TRACE_COMPOSE || e.event == PJON_TRACE_SEND_STRING
+        ) fprintf(file, "\"length\":%u}}", e.result);
+        else if(e.event == PJON_TRACE_UPDATE)
+          fprintf(file, "\"packets\":%u}}", e.result);
+        else fprintf(file, "\"result\":\"%s\"}}", result_name(e.result));
+      }
+      fprintf(file, "\n]}\n");
+      fclose(file);
+      return events.size();
+    };
+
+  private:
+    static std::atomic<uint64_t> &head() {
+      static std::atomic<uint64_t> index(0);
+      return index;
+    };
+
+    static PJON_Trace_Slot *slots() {
+      static PJON_Trace_Slot buffer[PJON_TRACE_BUFFER];
+      return buffer;
+    };
+
+    static const char *event_name(uint8_t event) {
+      switch(event) {
+        case PJON_TRACE_COMPOSE: return "compose_packet";
+        case PJON_TRACE_SEND: return "send_packet";
+        case PJON_TRACE_SEND_STRING: return "send_string";
+        case PJON_TRACE_RESPONSE: return "receive_response";
+        case PJON_TRACE_RECEIVE: return "receive";
+        case PJON_TRACE_UPDATE: return "update";
+        default: return "unknown";
+      }
+    };
+
+    static const char *result_name(uint16_t result) {
+      static thread_local char number[6];
+      switch(result) {
+        case PJON_ACK: return "ACK";
+        case PJON_NAK: return "NAK";
+        case PJON_BUSY: return "BUSY";
+        case PJON_FAIL: return "FAIL";
+        default: snprintf(number, sizeof(number), "%u", result); return number;
+      }
+    };
+};
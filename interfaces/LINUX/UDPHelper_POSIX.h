@@ -13,8 +13,11 @@
 #include <string.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <time.h>
 #endif
 
 class UDPHelper {
@@ -22,6 +25,7 @@ class UDPHelper {
   uint32_t _magic_header;
   sockaddr_in _localaddr, _remote_receiver_addr, _remote_sender_addr;
   int _fd = -1;
+  uint32_t _receive_delay = 0;
 public:
   ~UDPHelper() {
     if (_fd != -1)
@@ -71,6 +75,12 @@ public:
 	#endif
 	setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&read_timeout, sizeof read_timeout);
 
+#ifdef SO_TIMESTAMPNS
+    // Let the kernel timestamp each datagram on arrival
+    int timestamp = 1;
+    setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPNS, &timestamp, sizeof(timestamp));
+#endif
+
     // Bind to specific local port
     memset(&_localaddr, 0, sizeof(_localaddr));
     _localaddr.sin_family = AF_INET;
@@ -100,7 +110,36 @@ public:
   uint16_t receive_string(uint8_t *string, uint16_t max_length) {
     struct sockaddr_storage src_addr;
     socklen_t src_addr_len=sizeof(src_addr);
+#ifdef SO_TIMESTAMPNS
+    struct iovec io;
+    io.iov_base = string;
+    io.iov_len = max_length;
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_name = &src_addr;
+    message.msg_namelen = src_addr_len;
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t count=recvmsg(_fd,&message,0);
+    _receive_delay = 0;
+    if (count != -1) {
+      // Time the datagram waited in the socket since its arrival
+      for (cmsghdr *c = CMSG_FIRSTHDR(&message); c; c = CMSG_NXTHDR(&message, c))
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+          struct timespec arrival, now;
+          memcpy(&arrival, CMSG_DATA(c), sizeof(arrival));
+          clock_gettime(CLOCK_REALTIME, &now);
+          int64_t delay = (int64_t)(now.tv_sec - arrival.tv_sec) * 1000000 +
+            (now.tv_nsec - arrival.tv_nsec) / 1000;
+          if (delay > 0) _receive_delay = delay;
+        }
+    }
+#else
     ssize_t count=recvfrom(_fd,(char*)string,max_length,0,(struct sockaddr*)&src_addr,&src_addr_len);
+#endif
     if (count==-1) {
 #ifdef _WIN32
 		//int error = WSAGetLastError();
@@ -165,6 +204,27 @@ public:
   }
 
   void set_magic_header(uint32_t magic_header) { _magic_header = magic_header; }
+
+  // Wait up to timeout microseconds for a datagram, returns true if available
+  bool wait(uint32_t timeout) {
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(_fd, &set);
+    struct timeval time;
+    time.tv_sec = timeout / 1000000;
+    time.tv_usec = timeout % 1000000;
+    return select(_fd + 1, &set, NULL, NULL, &time) > 0;
+  }
+
+  // Microseconds the last datagram received waited before being read
+  // (0 if the kernel does not timestamp datagrams)
+  uint32_t get_receive_delay() const { return _receive_delay; }
+
+  // Address of the transmitter of the last datagram received
+  const sockaddr_in &get_remote_sender() const { return _remote_sender_addr; }
+
+  // Set where send_response replies
+  void set_remote_sender(const sockaddr_in &address) { _remote_sender_addr = address; }
 };
 
 #undef close
@@ -4,4 +4,5 @@
 #include "ARDUINO/PJON_ARDUINO_Interface.h"
 #include "RPI/PJON_RPI_Interface.h"
 #include "WINX86/PJON_WINX86_Interface.h"
+#include "SIMULATOR/PJON_SIMULATOR_Interface.h"
 #include "LINUX/PJON_LINUX_Interface.h"
\ No newline at end of file
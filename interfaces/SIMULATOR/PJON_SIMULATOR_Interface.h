@@ -0,0 +1,564 @@
+/* PJON Simulator Interface
+   Discrete-event virtual time base used to run many PJON instances in a single
+   Linux process, far faster than real time.
+
+   Every simulated device owns a virtual clock and runs its code in a dedicated
+   execution context (ucontext coroutine) with its own stack. Only one device
+   is executed at a time: the scheduler always resumes the device with the
+   lowest virtual clock. PJON_MICROS and PJON_DELAY_MICROSECONDS act on the
+   clock of the device calling them, so blocking code (delays, busy waits,
+   synchronous acknowledgement exchange) runs unchanged while time advances
+   only on the virtual clock.
+
+   Digital and analog IO (PJON_IO_* and PJON_ANALOG_READ) act on simulated
+   wires, so the bit-banged strategies (SoftwareBitBang, OverSampling and
+   AnalogSampling) run unchanged. By default the pin of each device is
+   connected to the wire with the same number, wires can be configured with
+   rise and fall time, noise and interference, devices with clock skew.
+
+   Define PJON_SIMULATOR (on LINUX) before PJON.h inclusion to use it:
+
+   #define PJON_SIMULATOR
+   #define PJON_INCLUDE_SM
+   #include <PJON.h>
+   ___________________________________________________________________________
+
+    Copyright 2010-2017 Giovanni Blu Mitolo gioscarab@gmail.com
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#if defined(LINUX) && defined(PJON_SIMULATOR)
+  #include <stdint.h>
+  #include <stdlib.h>
+  #include <ucontext.h>
+  #include <functional>
+  #include <map>
+  #include <queue>
+  #include <utility>
+  #include <vector>
+
+  /* Virtual time consumed by each PJON_MICROS call, it lets busy waiting
+     loops progress without any real time passing (microseconds): */
+
+  #ifndef SIM_MICROS_COST
+    #define SIM_MICROS_COST      1
+  #endif
+
+  /* Maximum virtual time a device can run ahead of the slowest one before
+     yielding (lookahead). Keep it lower or equal to the propagation delay of
+     the simulated medium to avoid causality errors (microseconds): */
+
+  #ifndef SIM_QUANTUM
+    #define SIM_QUANTUM          1
+  #endif
+
+  /* Stack size of each simulated device in bytes: */
+
+  #ifndef SIM_STACK_SIZE
+    #define SIM_STACK_SIZE  131072
+  #endif
+
+  /* Default virtual time consumed by each PJON_IO_READ call, it approximates
+     the duration of the read and of the code around it on real hardware,
+     which the timing of the bit-banged strategies compensates (microseconds): */
+
+  #ifndef SIM_IO_READ_COST
+    #define SIM_IO_READ_COST     2
+  #endif
+
+  /* Default virtual time consumed by each PJON_ANALOG_READ call: */
+
+  #ifndef SIM_ANALOG_READ_COST
+    #define SIM_ANALOG_READ_COST 0
+  #endif
+
+  /* Transitions of each device output kept to evaluate the wire state in the
+     recent past (devices run up to SIM_QUANTUM ahead of each other): */
+
+  #ifndef SIM_WIRE_HISTORY
+    #define SIM_WIRE_HISTORY     8
+  #endif
+
+  /* Maximum value returned by PJON_ANALOG_READ (10 bits ADC): */
+
+  #ifndef SIM_ANALOG_MAX
+    #define SIM_ANALOG_MAX    1023
+  #endif
+
+  /* Output of a device connected to a wire, the level reached after each
+     transition is a linear ramp from the level at the time it occurred: */
+
+  struct PJON_Simulated_Driver {
+    uint64_t time[SIM_WIRE_HISTORY];
+    uint16_t start[SIM_WIRE_HISTORY];
+    uint16_t target[SIM_WIRE_HISTORY];
+    uint8_t  head = 0;
+    uint8_t  count = 0;
+  };
+
+  class PJON_Simulated_Wire {
+    public:
+      uint32_t rise_time = 0;        // Time to go from 0 to high (us)
+      uint32_t fall_time = 0;        // Time to go from high to 0 (us)
+      uint16_t high = SIM_ANALOG_MAX; // Level of a device writing HIGH
+      uint16_t noise = 0;            // Analog noise amplitude (+-)
+      double   flip_rate = 0;        // Probability of a wrong digital read
+      /* Interference: the wire is forced high for burst_length microseconds
+         every burst_period microseconds (0 disables it): */
+      uint32_t burst_period = 0;
+      uint32_t burst_length = 0;
+
+      /* Set the level driven by a device from time: */
+
+      void write(uint16_t device, uint64_t time, bool level) {
+        if(device >= _drivers.size()) _drivers.resize(device + 1);
+        PJON_Simulated_Driver &driver = _drivers[device];
+        uint16_t target = level ? high : 0;
+        uint16_t start = value(driver, time);
+        if(driver.count) {
+          uint8_t last = (driver.head + driver.count - 1) % SIM_WIRE_HISTORY;
+          if(driver.target[last] == target) return;
+        } else if(!target) return;
+        if(driver.count == SIM_WIRE_HISTORY) {
+          driver.head = (driver.head + 1) % SIM_WIRE_HISTORY;
+          driver.count--;
+        }
+        uint8_t index = (driver.head + driver.count++) % SIM_WIRE_HISTORY;
+        driver.time[index] = time;
+        driver.start[index] = start;
+        driver.target[index] = target;
+      };
+
+
+      /* Analog level at time (the highest driven, plus noise): */
+
+      uint16_t analog(uint64_t time) {
+        int32_t result = 0;
+        for(uint16_t i = 0; i < _drivers.size(); i++) {
+          uint16_t level = value(_drivers[i], time);
+          if(level > result) result = level;
+        }
+        if(
+          burst_period && burst_length &&
+          ((time % burst_period) < burst_length)
+        ) result = high;
+        if(noise)
+          result += (int32_t)(random() % (2 * noise + 1)) - noise;
+        if(result < 0) result = 0;
+        if(result > SIM_ANALOG_MAX) result = SIM_ANALOG_MAX;
+        return result;
+      };
+
+
+      /* Digital level at time (analog level over half of high): */
+
+      bool digital(uint64_t time) {
+        bool result = analog(time) > (high / 2);
+        if(flip_rate > 0 && ((random() / 4294967296.0) < flip_rate))
+          result = !result;
+        return result;
+      };
+
+
+      void set_random_seed(uint32_t seed) {
+        _random = seed ? seed : 1;
+      };
+
+    private:
+      std::vector<PJON_Simulated_Driver> _drivers;
+      uint32_t _random = 2463534242;
+
+      uint32_t random() {
+        _random ^= _random << 13;
+        _random ^= _random >> 17;
+        _random ^= _random << 5;
+        return _random;
+      };
+
+      uint16_t value(const PJON_Simulated_Driver &driver, uint64_t time) {
+        for(uint8_t n = driver.count; n > 0; n--) {
+          uint8_t i = (driver.head + n - 1) % SIM_WIRE_HISTORY;
+          if(driver.time[i] > time) continue;
+          uint32_t ramp =
+            (driver.target[i] > driver.start[i]) ? rise_time : fall_time;
+          uint32_t full = (driver.target[i] > driver.start[i]) ?
+            (driver.target[i] - driver.start[i]) :
+            (driver.start[i] - driver.target[i]);
+          uint64_t elapsed = time - driver.time[i];
+          if(!ramp || (elapsed >= ramp * (uint64_t)full / high))
+            return driver.target[i];
+          /* The ramp slope is high / ramp */
+          uint32_t delta = (uint32_t)(elapsed * high / ramp);
+          return (driver.target[i] > driver.start[i]) ?
+            driver.start[i] + delta : driver.start[i] - delta;
+        }
+        return 0;
+      };
+  };
+
+  struct PJON_Simulated_Pin {
+    int32_t wire = -1;  // -1 is the wire with the pin's number
+    uint8_t mode = 0;   // INPUT
+    uint8_t value = 0;  // LOW
+  };
+
+  struct PJON_Simulated_Node {
+    uint64_t              clock = 0;
+    bool                  finished = false;
+    bool                  started = false;
+    std::function<void()> setup;
+    std::function<void()> loop;
+    ucontext_t            context;
+    char                 *stack = NULL;
+    double                rate = 1;     // Local clock rate (skew)
+    double                residue = 0;  // Fraction of microsecond to consume
+    uint32_t              io_read_cost = SIM_IO_READ_COST;
+    uint32_t              analog_read_cost = SIM_ANALOG_READ_COST;
+    uint16_t              index = 0;
+    PJON_Simulated_Pin    pins[256];
+  };
+
+  class PJON_Simulator {
+    public:
+      ~PJON_Simulator() {
+        for(uint16_t i = 0; i < _nodes.size(); i++) {
+          free(_nodes[i]->stack);
+          delete _nodes[i];
+        }
+        for(auto &wire : _wires) delete wire.second;
+        if(active() == this) active() = NULL;
+      };
+
+
+      /* Add a simulated device, loop is called repeatedly until the end of
+         the simulation, setup once before the first loop call.
+         Returns the index of the device: */
+
+      uint16_t add_node(
+        std::function<void()> loop,
+        std::function<void()> setup = nullptr
+      ) {
+        PJON_Simulated_Node *node = new PJON_Simulated_Node;
+        node->clock = _time;
+        node->loop = loop;
+        node->setup = setup;
+        node->index = _nodes.size();
+        _nodes.push_back(node);
+        return _nodes.size() - 1;
+      };
+
+
+      /* Run the simulation for a certain virtual duration (microseconds).
+         It can be called more than once, the virtual time keeps going: */
+
+      void run(uint64_t duration) {
+        active() = this;
+        _end = _time + duration;
+        for(uint16_t i = 0; i < _nodes.size(); i++) {
+          PJON_Simulated_Node *node = _nodes[i];
+          node->finished = false;
+          if(node->clock < _time) node->clock = _time;
+          if(!node->stack) node->stack = (char *)malloc(SIM_STACK_SIZE);
+          getcontext(&node->context);
+          node->context.uc_stack.ss_sp = node->stack;
+          node->context.uc_stack.ss_size = SIM_STACK_SIZE;
+          node->context.uc_link = &_scheduler;
+          makecontext(&node->context, (void (*)())node_entry, 0);
+        }
+        for(uint16_t i = 0; i < _nodes.size(); i++)
+          _queue.push(std::make_pair(_nodes[i]->clock, i));
+        /* Always resume the device with the lowest virtual clock */
+        while(!_queue.empty()) {
+          PJON_Simulated_Node *node = _nodes[_queue.top().second];
+          uint16_t index = _queue.top().second;
+          _queue.pop();
+          _horizon =
+            _queue.empty() ? UINT64_MAX : _queue.top().first + SIM_QUANTUM;
+          current() = node;
+          _switches++;
+          swapcontext(&_scheduler, &node->context);
+          current() = NULL;
+          if(!node->finished) _queue.push(std::make_pair(node->clock, index));
+        }
+        _time = _end;
+      };
+
+
+      /* Virtual time of the calling device (or simulation time): */
+
+      uint64_t now() const {
+        PJON_Simulated_Node *node = current();
+        return node ? node->clock : _time;
+      };
+
+
+      /* Lowest virtual time among running devices: */
+
+      uint64_t min_clock() const {
+        PJON_Simulated_Node *node = current();
+        uint64_t result = node ? node->clock : _time;
+        if(!_queue.empty() && _queue.top().first < result)
+          result = _queue.top().first;
+        return result;
+      };
+
+
+      PJON_Simulated_Node *node(uint16_t index) {
+        return (index < _nodes.size()) ? _nodes[index] : NULL;
+      };
+
+
+      uint16_t node_count() const {
+        return _nodes.size();
+      };
+
+
+      /* Number of context switches executed (simulation cost): */
+
+      uint64_t switches() const {
+        return _switches;
+      };
+
+
+      /* Virtual time advance of the calling device, if it passes the
+         slowest of the other devices the execution is suspended: */
+
+      void advance(uint32_t duration) {
+        PJON_Simulated_Node *node = current();
+        if(!node) {
+          _time += duration;
+          return;
+        }
+        node->clock += duration;
+        if(node->clock > _horizon)
+          swapcontext(&node->context, &_scheduler);
+      };
+
+
+      /* Connect the pin of a device to a wire (by default each pin is
+         connected to the wire with the same number): */
+
+      void connect(uint16_t node_index, uint8_t pin, uint16_t wire_index) {
+        if(node_index < _nodes.size())
+          _nodes[node_index]->pins[pin].wire = wire_index;
+      };
+
+
+      /* Get a wire to configure it, it is created if not existing: */
+
+      PJON_Simulated_Wire *wire(uint16_t index) {
+        PJON_Simulated_Wire *&result = _wires[index];
+        if(!result) result = new PJON_Simulated_Wire;
+        return result;
+      };
+
+
+      /* Set the clock skew of a device in parts per million, positive values
+         make its clock run faster than the simulation time: */
+
+      void set_clock_skew(uint16_t node_index, double ppm) {
+        if(node_index < _nodes.size())
+          _nodes[node_index]->rate = 1 + (ppm / 1000000.0);
+      };
+
+
+      /* Set the duration of digital and analog reads of a device
+         (microseconds): */
+
+      void set_read_cost(
+        uint16_t node_index,
+        uint32_t io_read_cost,
+        uint32_t analog_read_cost = SIM_ANALOG_READ_COST
+      ) {
+        if(node_index >= _nodes.size()) return;
+        _nodes[node_index]->io_read_cost = io_read_cost;
+        _nodes[node_index]->analog_read_cost = analog_read_cost;
+      };
+
+
+      /* Simulator currently running (or last configured): */
+
+      static PJON_Simulator *&active() {
+        static PJON_Simulator *simulator = NULL;
+        return simulator;
+      };
+
+
+      /* Device currently executed (NULL outside simulation): */
+
+      static PJON_Simulated_Node *&current() {
+        static PJON_Simulated_Node *node = NULL;
+        return node;
+      };
+
+
+      /* Interface methods used by PJON_MICROS, PJON_MILLIS and
+         PJON_DELAY_MICROSECONDS: */
+
+      static uint32_t micros() {
+        PJON_Simulator *simulator = active();
+        if(!simulator) return 0;
+        simulator->advance(SIM_MICROS_COST);
+        PJON_Simulated_Node *node = current();
+        if(node && node->rate != 1)
+          return (uint32_t)(node->clock * node->rate);
+        return (uint32_t)simulator->now();
+      };
+
+      static uint32_t millis() {
+        return micros() / 1000;
+      };
+
+      /* Delays are expressed in the device's local time: */
+
+      static void delay_microseconds(uint32_t duration) {
+        PJON_Simulator *simulator = active();
+        if(!simulator) return;
+        PJON_Simulated_Node *node = current();
+        if(node && node->rate != 1) {
+          double global = (duration / node->rate) + node->residue;
+          duration = (uint32_t)global;
+          node->residue = global - duration;
+        }
+        simulator->advance(duration);
+      };
+
+      /* Interface methods used by PJON_IO_MODE, PJON_IO_WRITE, PJON_IO_READ,
+         PJON_IO_PULL_DOWN and PJON_ANALOG_READ: */
+
+      static void io_mode(uint8_t pin, uint8_t mode) {
+        PJON_Simulated_Node *node = current();
+        if(!node) return;
+        node->pins[pin].mode = mode;
+        update_pin(node, pin);
+      };
+
+      static void io_write(uint8_t pin, uint8_t value) {
+        PJON_Simulated_Node *node = current();
+        if(!node) return;
+        node->pins[pin].value = value ? 1 : 0;
+        update_pin(node, pin);
+      };
+
+      static uint8_t io_read(uint8_t pin) {
+        PJON_Simulated_Node *node = current();
+        if(!node) return 0;
+        uint8_t result = pin_wire(node, pin)->digital(node->clock);
+        if(node->io_read_cost) active()->advance(node->io_read_cost);
+        return result;
+      };
+
+      static void io_pull_down(uint8_t pin) {
+        PJON_Simulated_Node *node = current();
+        if(!node) return;
+        node->pins[pin].value = 0;
+        node->pins[pin].mode = 0;
+        update_pin(node, pin);
+      };
+
+      static uint16_t analog_read(uint8_t pin) {
+        PJON_Simulated_Node *node = current();
+        if(!node) return 0;
+        uint16_t result = pin_wire(node, pin)->analog(node->clock);
+        if(node->analog_read_cost) active()->advance(node->analog_read_cost);
+        return result;
+      };
+
+    private:
+      typedef std::pair<uint64_t, uint16_t> Entry;
+      std::vector<PJON_Simulated_Node *> _nodes;
+      /* Devices waiting to be resumed, ordered by clock and index */
+      std::priority_queue<
+        Entry, std::vector<Entry>, std::greater<Entry>
+      > _queue;
+      ucontext_t _scheduler;
+      uint64_t   _horizon = 0;
+      uint64_t   _time = 0;
+      uint64_t   _end = 0;
+      uint64_t   _switches = 0;
+      std::map<uint16_t, PJON_Simulated_Wire *> _wires;
+
+      static PJON_Simulated_Wire *pin_wire(
+        PJON_Simulated_Node *node,
+        uint8_t pin
+      ) {
+        int32_t index = node->pins[pin].wire;
+        return active()->wire((index < 0) ? pin : index);
+      };
+
+      /* A device drives the wire only if its pin is an output (mode 1): */
+
+      static void update_pin(PJON_Simulated_Node *node, uint8_t pin) {
+        PJON_Simulated_Pin &state = node->pins[pin];
+        pin_wire(node, pin)->write(
+          node->index, node->clock, (state.mode == 1) && state.value
+        );
+      };
+
+      /* Body of each device, returns to the scheduler when completed: */
+
+      static void node_entry() {
+        PJON_Simulator *simulator = active();
+        PJON_Simulated_Node *node = current();
+        if(!node->started) {
+          node->started = true;
+          if(node->setup) node->setup();
+        }
+        while(node->clock < simulator->_end) {
+          uint64_t time = node->clock;
+          node->loop();
+          /* Avoid an endless loop if the device does not consume time */
+          if(node->clock == time) simulator->advance(SIM_MICROS_COST);
+        }
+        node->finished = true;
+      };
+  };
+
+  /* Timing ----------------------------------------------------------------- */
+
+  #ifndef PJON_DELAY_MICROSECONDS
+    #define PJON_DELAY_MICROSECONDS PJON_Simulator::delay_microseconds
+  #endif
+
+  #ifndef PJON_MICROS
+    #define PJON_MICROS PJON_Simulator::micros
+  #endif
+
+  #ifndef PJON_MILLIS
+    #define PJON_MILLIS PJON_Simulator::millis
+  #endif
+
+  /* IO --------------------------------------------------------------------- */
+
+  #ifndef PJON_IO_MODE
+    #define PJON_IO_MODE PJON_Simulator::io_mode
+  #endif
+
+  #ifndef PJON_IO_WRITE
+    #define PJON_IO_WRITE PJON_Simulator::io_write
+  #endif
+
+  #ifndef PJON_IO_READ
+    #define PJON_IO_READ PJON_Simulator::io_read
+  #endif
+
+  #ifndef PJON_IO_PULL_DOWN
+    #define PJON_IO_PULL_DOWN PJON_Simulator::io_pull_down
+  #endif
+
+  #ifndef PJON_ANALOG_READ
+    #define PJON_ANALOG_READ PJON_Simulator::analog_read
+  #endif
+#endif
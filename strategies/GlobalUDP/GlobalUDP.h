@@ -53,6 +53,7 @@ class GlobalUDP {
     uint16_t _remote_port[GUDP_MAX_REMOTE_NODES];
 
     UDPHelper udp;
+    uint32_t _receive_time = 0;
 
     bool check_udp() {
       if(!_udp_initialized) {
@@ -124,9 +125,20 @@ public:
     /* Receive a string: */
 
     uint16_t receive_string(uint8_t *string, uint16_t max_length) {
-      return udp.receive_string(string, max_length);
+      uint16_t length = udp.receive_string(string, max_length);
+      #ifndef HAS_ETHERNETUDP
+        if(length && length != PJON_FAIL)
+          _receive_time = PJON_MICROS() - udp.get_receive_delay();
+      #endif
+      return length;
     }
 
+#ifndef HAS_ETHERNETUDP
+    /* PJON_MICROS time the last frame received arrived: */
+
+    uint32_t get_receive_time() const { return _receive_time; };
+#endif
+
 
     /* Receive byte response */
 
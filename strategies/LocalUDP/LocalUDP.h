@@ -32,11 +32,23 @@
 #define LUDP_RESPONSE_TIMEOUT  (uint32_t) 100000
 #define LUDP_MAGIC_HEADER      (uint32_t) 0x0DFAC3D0
 
+#ifndef HAS_ETHERNETUDP
+  #include "LocalUDPHost.h"
+#endif
+
 class LocalUDP {
     bool _udp_initialized = false;
     uint16_t _port = LUDP_DEFAULT_PORT;
     const uint32_t _magic_header = LUDP_MAGIC_HEADER;
     UDPHelper udp;
+#ifndef HAS_ETHERNETUDP
+    LocalUDPHost *_host = NULL;
+    bool _attached = false;
+    uint8_t _id = PJON_NOT_ASSIGNED;
+    bool _local = false; // Last frame received from an instance of the host
+    uint32_t _receive_time = 0;
+    uint16_t _last_result = PJON_FAIL;
+#endif
 
     bool check_udp() {
       if(!_udp_initialized) {
@@ -47,6 +59,13 @@ class LocalUDP {
     };
 
 public:
+#ifndef HAS_ETHERNETUDP
+    ~LocalUDP() {
+      if(_attached) _host->detach(_id);
+    };
+#endif
+
+
     /* Returns the suggested delay related to the attempts passed as parameter: */
 
     uint32_t back_off(uint8_t attempts) {
@@ -60,15 +79,31 @@ public:
     };
 
 
-    /* Begin method, to be called before transmission or reception:
-       (returns always true) */
+    /* Begin method, to be called before transmission or reception,
+       PJON passes its device id as parameter: */
 
-    bool begin(uint8_t additional_randomness = 0) { return check_udp(); };
+    bool begin(uint8_t device_id = 0) {
+#ifndef HAS_ETHERNETUDP
+      if(_host) {
+        if(_attached) _host->detach(_id);
+        _id = device_id;
+        _host->attach(_id);
+        _attached = true;
+        return _host->begin();
+      }
+#endif
+      return check_udp();
+    };
 
 
     /* Check if the channel is free for transmission */
 
-    bool can_start() { return check_udp(); };
+    bool can_start() {
+#ifndef HAS_ETHERNETUDP
+      if(_host) return _host->begin();
+#endif
+      return check_udp();
+    };
 
 
     /* Returns the maximum number of attempts for each transmission: */
@@ -84,9 +119,29 @@ public:
     /* Receive a string: */
 
     uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+#ifndef HAS_ETHERNETUDP
+      if(_host) {
+        uint16_t length =
+          _host->pop(_id, string, max_length, _local, _receive_time);
+        if(length != PJON_FAIL) return length;
+        _host->receive();
+        return _host->pop(_id, string, max_length, _local, _receive_time);
+      }
+      uint16_t length = udp.receive_string(string, max_length);
+      if(length && length != PJON_FAIL)
+        _receive_time = PJON_MICROS() - udp.get_receive_delay();
+      return length;
+#else
       return udp.receive_string(string, max_length);
+#endif
     }
 
+#ifndef HAS_ETHERNETUDP
+    /* PJON_MICROS time the last frame received arrived: */
+
+    uint32_t get_receive_time() const { return _receive_time; };
+#endif
+
 
     /* Receive byte response */
 
@@ -95,6 +150,16 @@ public:
          receiver (Perhaps not that important as long as ACK/NAK responses are
          directed, not broadcast) */
       uint32_t start = PJON_MICROS();
+#ifndef HAS_ETHERNETUDP
+      if(_host) {
+        if(_last_result) return _last_result; // Delivered in memory or not
+        do {
+          // Frames received meanwhile are queued for their recipients
+          if(_host->receive(1000)) return PJON_ACK;
+        } while((uint32_t)(PJON_MICROS() - start) < LUDP_RESPONSE_TIMEOUT);
+        return PJON_FAIL;
+      }
+#endif
       uint8_t result[6];
       uint16_t reply_length = 0;
       do {
@@ -114,6 +179,13 @@ public:
        We have the IP so we can skip broadcasting and reply directly. */
 
     void send_response(uint8_t response) { // Empty, PJON_ACK is always sent
+#ifndef HAS_ETHERNETUDP
+      if(_host) {
+        // Frames delivered in memory are acknowledged on delivery
+        if(!_local) _host->send_response(response);
+        return;
+      }
+#endif
       udp.send_response(response);
     };
 
@@ -121,6 +193,12 @@ public:
     /* Send a string: */
 
     void send_string(uint8_t *string, uint16_t length) {
+#ifndef HAS_ETHERNETUDP
+      if(_host) {
+        _last_result = _host->send_string(string, length);
+        return;
+      }
+#endif
       udp.send_string(string, length);
     };
 
@@ -130,4 +208,25 @@ public:
     void set_port(uint16_t port = LUDP_DEFAULT_PORT) {
       _port = port;
     };
+
+#ifndef HAS_ETHERNETUDP
+    /* Share the socket of a LocalUDPHost with the other instances of the
+       process (to be called before begin): */
+
+    void set_host(LocalUDPHost *host) {
+      _host = host;
+    };
+
+
+    /* Update the device id if changed after begin, the instance is moved to
+       the queue of the new id: */
+
+    void set_id(uint8_t id) {
+      if(_attached) {
+        _host->detach(_id);
+        _host->attach(id);
+      }
+      _id = id;
+    };
+#endif
 };
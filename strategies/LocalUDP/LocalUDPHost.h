@@ -0,0 +1,268 @@
+/* LocalUDPHost lets many LocalUDP instances hosted in the same process share
+   a single UDP socket. Incoming frames are read once and demultiplexed by
+   recipient id to the queue of the instance they are addressed to, so
+   broadcast traffic is processed once and not by every instance.
+   Acknowledgements are sent through the shared socket on behalf of the
+   instances, frames exchanged by instances of the same host are delivered
+   directly in memory. The address of each device heard is recorded, so an
+   acknowledgement is accepted only if sent by the recipient of the frame.
+   _____________________________________________________________________________
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <interfaces/LINUX/UDPHelper_POSIX.h>
+#include <PJONDefines.h>
+
+/* Frames each hosted instance can buffer: */
+#ifndef LUDP_HOST_QUEUE
+  #define LUDP_HOST_QUEUE 8
+#endif
+
+struct LocalUDPHostFrame {
+  uint16_t    length;
+  bool        local;   // Transmitted by an instance of the same host
+  uint32_t    time;    // PJON_MICROS time of arrival
+  sockaddr_in sender;
+  uint8_t     content[PJON_PACKET_MAX_LENGTH];
+};
+
+struct LocalUDPHostQueue {
+  uint16_t          users = 0;
+  uint8_t           head = 0;
+  uint8_t           count = 0;
+  uint32_t          dropped = 0;
+  LocalUDPHostFrame frames[LUDP_HOST_QUEUE];
+};
+
+class LocalUDPHost {
+  public:
+    ~LocalUDPHost() {
+      for(uint16_t i = 0; i < 256; i++) delete _queues[i];
+    };
+
+
+    /* Open the shared socket (called by the first hosted instance): */
+
+    bool begin() {
+      if(!_initialized) {
+        _udp.set_magic_header(_magic_header);
+        _initialized = _udp.begin(_port);
+      }
+      return _initialized;
+    };
+
+
+    /* Register an instance with its device id: */
+
+    void attach(uint8_t id) {
+      if(id == PJON_BROADCAST) return;
+      if(!_queues[id]) _queues[id] = new LocalUDPHostQueue;
+      _queues[id]->users++;
+    };
+
+
+    void detach(uint8_t id) {
+      if(!_queues[id] || --_queues[id]->users) return;
+      delete _queues[id];
+      _queues[id] = NULL;
+    };
+
+
+    /* Read all the datagrams available (waiting up to timeout microseconds
+       for the first one) and queue them for their recipients. Returns true
+       if the recipient of the last frame transmitted on the network
+       acknowledged it (any acknowledgement is accepted if its address is
+       not known yet): */
+
+    bool receive(uint32_t timeout = 0) {
+      bool ack = false;
+      uint8_t buffer[PJON_PACKET_MAX_LENGTH + 5];
+      while(_initialized && _udp.wait(timeout)) {
+        timeout = 0;
+        uint16_t length = _udp.receive_string(buffer, sizeof(buffer));
+        if(!length || (length == PJON_FAIL)) continue;
+        if(length == 1) {
+          if((buffer[0] == PJON_ACK) && acknowledges(_udp.get_remote_sender()))
+            ack = true;
+          continue;
+        }
+        record_sender(buffer, length, _udp.get_remote_sender());
+        deliver(
+          buffer,
+          length,
+          _udp.get_remote_sender(),
+          false,
+          PJON_MICROS() - _udp.get_receive_delay()
+        );
+      }
+      return ack;
+    };
+
+
+    /* Pop the oldest frame queued for id, setting the address the response
+       is sent to and its time of arrival. Returns its length or PJON_FAIL: */
+
+    uint16_t pop(
+      uint8_t id,
+      uint8_t *string,
+      uint16_t max_length,
+      bool &local,
+      uint32_t &time
+    ) {
+      LocalUDPHostQueue *queue = _queues[id];
+      if(!queue || !queue->count) return PJON_FAIL;
+      LocalUDPHostFrame &frame = queue->frames[queue->head];
+      queue->head = (queue->head + 1) % LUDP_HOST_QUEUE;
+      queue->count--;
+      if(frame.length > max_length) return PJON_FAIL;
+      memcpy(string, frame.content, frame.length);
+      local = frame.local;
+      time = frame.time;
+      if(!local) _udp.set_remote_sender(frame.sender);
+      return frame.length;
+    };
+
+
+    /* Transmit a frame: if the recipient is hosted it is delivered directly
+       returning PJON_ACK, or PJON_FAIL if its queue is full. Otherwise it is
+       broadcasted on the network and 0 is returned, the response is
+       received by receive: */
+
+    uint16_t send_string(const uint8_t *string, uint16_t length) {
+      if(!length) return PJON_FAIL;
+      if(string[0] != PJON_BROADCAST && _queues[string[0]]) {
+        sockaddr_in none;
+        memset(&none, 0, sizeof(none));
+        return
+          deliver(string, length, none, true, PJON_MICROS()) ?
+            PJON_ACK : PJON_FAIL;
+      }
+      _destination = string[0];
+      _udp.send_string(string, length);
+      return 0;
+    };
+
+
+    /* Send a response to the transmitter of the last frame popped: */
+
+    void send_response(uint8_t response) {
+      _udp.send_response(response);
+    };
+
+
+    /* Frames lost by the instance with the id passed because its queue was
+       full: */
+
+    uint32_t get_dropped(uint8_t id) const {
+      return _queues[id] ? _queues[id]->dropped : 0;
+    };
+
+
+    /* Set the UDP port (before the first begin): */
+
+    void set_port(uint16_t port = LUDP_DEFAULT_PORT) {
+      _port = port;
+    };
+
+  private:
+    UDPHelper          _udp;
+    bool               _initialized = false;
+    uint16_t           _port = LUDP_DEFAULT_PORT;
+    uint32_t           _magic_header = LUDP_MAGIC_HEADER;
+    LocalUDPHostQueue *_queues[256] = { NULL };
+    sockaddr_in        _addresses[256]; // Of the devices heard, by id
+    bool               _known[256] = { false };
+    uint8_t            _destination = PJON_NOT_ASSIGNED;
+
+
+    /* Check if an acknowledgement comes from the recipient of the last frame
+       transmitted on the network: */
+
+    bool acknowledges(const sockaddr_in &sender) const {
+      if(!_known[_destination]) return true;
+      const sockaddr_in &address = _addresses[_destination];
+      return
+        (address.sin_addr.s_addr == sender.sin_addr.s_addr) &&
+        (address.sin_port == sender.sin_port);
+    };
+
+
+    /* Record the address of the transmitter of a frame if its id is
+       included: */
+
+    void record_sender(
+      const uint8_t *string,
+      uint16_t length,
+      const sockaddr_in &sender
+    ) {
+      if(length < 2) return;
+      uint16_t header = string[1];
+      if(!(header & PJON_TX_INFO_BIT)) return;
+      uint16_t offset = 4 +
+        ((header & PJON_EXT_HEAD_BIT) ? 1 : 0) +
+        ((header & PJON_EXT_LEN_BIT) ? 1 : 0) +
+        ((header & PJON_MODE_BIT) ? 8 : 0);
+      if(offset >= length) return;
+      uint8_t id = string[offset];
+      if(id == PJON_BROADCAST || id == PJON_NOT_ASSIGNED) return;
+      _addresses[id] = sender;
+      _known[id] = true;
+    };
+
+    bool push(
+      LocalUDPHostQueue *queue,
+      const uint8_t *string,
+      uint16_t length,
+      const sockaddr_in &sender,
+      bool local,
+      uint32_t time
+    ) {
+      if(length > PJON_PACKET_MAX_LENGTH) return false;
+      if(queue->count == LUDP_HOST_QUEUE) {
+        queue->dropped++;
+        return false;
+      }
+      LocalUDPHostFrame &frame =
+        queue->frames[(queue->head + queue->count) % LUDP_HOST_QUEUE];
+      frame.length = length;
+      frame.local = local;
+      frame.sender = sender;
+      frame.time = time;
+      memcpy(frame.content, string, length);
+      queue->count++;
+      return true;
+    };
+
+
+    /* Demultiplex a frame by recipient id, broadcasts are queued for all the
+       hosted instances: */
+
+    bool deliver(
+      const uint8_t *string,
+      uint16_t length,
+      const sockaddr_in &sender,
+      bool local,
+      uint32_t time
+    ) {
+      if(string[0] != PJON_BROADCAST)
+        return _queues[string[0]] &&
+          push(_queues[string[0]], string, length, sender, local, time);
+      bool result = false;
+      for(uint16_t i = 0; i < 256; i++)
+        if(_queues[i] && push(_queues[i], string, length, sender, local, time))
+          result = true;
+      return result;
+    };
+};
@@ -0,0 +1,318 @@
+/* Loopback is a Strategy for the PJON framework.
+   It connects PJON instances hosted in the same process (also running in
+   different threads) attached to the same named bus. Each instance has a
+   lock-free multi-producer single-consumer ring buffer where frames addressed
+   to it are copied once by the transmitter, no system call is executed.
+   Synchronous acknowledgement is immediate: it is obtained when the frame is
+   accepted by the ring buffer of the recipient.
+   ___________________________________________________________________________
+
+    Copyright 2010-2017 Giovanni Blu Mitolo gioscarab@gmail.com
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <PJONDefines.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+/* Frames each instance can buffer (must be a power of 2): */
+#ifndef LB_RING_SIZE
+  #define LB_RING_SIZE        64
+#endif
+
+/* Maximum number of instances attached to the same bus: */
+#ifndef LB_MAX_DEVICES
+  #define LB_MAX_DEVICES      32
+#endif
+
+/* Maximum transmission attempts */
+#ifndef LB_MAX_ATTEMPTS
+  #define LB_MAX_ATTEMPTS     10
+#endif
+
+/* Back-off delay in microseconds (multiplied by the attempts), a frame is
+   retransmitted only if the recipient's ring buffer is full: */
+#ifndef LB_BACK_OFF_DELAY
+  #define LB_BACK_OFF_DELAY  100
+#endif
+
+#define LB_DEFAULT_BUS "PJON"
+
+struct LoopbackSlot {
+  std::atomic<uint32_t> sequence;
+  uint16_t              length;
+  uint8_t               content[PJON_PACKET_MAX_LENGTH];
+};
+
+/* Bounded multi-producer single-consumer queue (D. Vyukov's algorithm) */
+
+class LoopbackRing {
+  public:
+    LoopbackRing() {
+      for(uint32_t i = 0; i < LB_RING_SIZE; i++)
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    };
+
+
+    /* Copy a frame in the ring, returns false if full or too long: */
+
+    bool push(const uint8_t *string, uint16_t length) {
+      if(length > PJON_PACKET_MAX_LENGTH) return false;
+      uint32_t position = _tail.load(std::memory_order_relaxed);
+      LoopbackSlot *slot;
+      for(;;) {
+        slot = &_slots[position & (LB_RING_SIZE - 1)];
+        int32_t difference = (int32_t)(
+          slot->sequence.load(std::memory_order_acquire) - position
+        );
+        if(difference == 0) {
+          if(_tail.compare_exchange_weak(
+            position, position + 1, std::memory_order_relaxed
+          )) break;
+        } else if(difference < 0) return false;
+        else position = _tail.load(std::memory_order_relaxed);
+      }
+      memcpy(slot->content, string, length);
+      slot->length = length;
+      slot->sequence.store(position + 1, std::memory_order_release);
+      return true;
+    };
+
+
+    /* Copy the oldest frame in string (only the owner can call it).
+       Returns its length, 0 if empty or PJON_FAIL if longer than max_length: */
+
+    uint16_t pop(uint8_t *string, uint16_t max_length) {
+      LoopbackSlot *slot = &_slots[_head & (LB_RING_SIZE - 1)];
+      if((int32_t)(
+        slot->sequence.load(std::memory_order_acquire) - (_head + 1)
+      ) < 0) return 0;
+      uint16_t length = slot->length;
+      if(length <= max_length) memcpy(string, slot->content, length);
+      slot->sequence.store(_head + LB_RING_SIZE, std::memory_order_release);
+      _head++;
+      return (length <= max_length) ? length : PJON_FAIL;
+    };
+
+  private:
+    /* Producers and consumer indexes are kept on different cache lines */
+    std::atomic<uint32_t> _tail{0};
+    uint8_t               _padding[64];
+    uint32_t              _head = 0;
+    LoopbackSlot          _slots[LB_RING_SIZE];
+};
+
+struct LoopbackEndpoint {
+  std::atomic<bool>    attached{false};
+  std::atomic<uint8_t> id{PJON_NOT_ASSIGNED};
+  std::atomic<bool>    router{false};
+  std::atomic<uint32_t> dropped{0}; // Frames lost because the ring was full
+  LoopbackRing         ring;
+};
+
+class LoopbackBus {
+  public:
+    /* Attach an instance, returns NULL if LB_MAX_DEVICES are attached: */
+
+    LoopbackEndpoint *attach(uint8_t id) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      for(uint16_t i = 0; i < LB_MAX_DEVICES; i++)
+        if(!_endpoints[i].attached.load(std::memory_order_relaxed)) {
+          LoopbackEndpoint *endpoint = &_endpoints[i];
+          uint8_t buffer[PJON_PACKET_MAX_LENGTH];
+          // Discard what was addressed to the previous owner
+          while(endpoint->ring.pop(buffer, sizeof(buffer)));
+          endpoint->id.store(id, std::memory_order_relaxed);
+          endpoint->router.store(false, std::memory_order_relaxed);
+          endpoint->dropped.store(0, std::memory_order_relaxed);
+          endpoint->attached.store(true, std::memory_order_release);
+          if(i >= _count.load(std::memory_order_relaxed))
+            _count.store(i + 1, std::memory_order_release);
+          return endpoint;
+        }
+      return NULL;
+    };
+
+
+    void detach(LoopbackEndpoint *endpoint) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      endpoint->attached.store(false, std::memory_order_release);
+    };
+
+
+    /* Deliver a frame to the instances it is addressed to (and to routers),
+       returns true if accepted by at least one of its recipients: */
+
+    bool deliver(
+      const LoopbackEndpoint *sender,
+      const uint8_t *string,
+      uint16_t length
+    ) {
+      bool result = false;
+      uint16_t count = _count.load(std::memory_order_acquire);
+      for(uint16_t i = 0; i < count; i++) {
+        LoopbackEndpoint *endpoint = &_endpoints[i];
+        if(endpoint == sender) continue;
+        if(!endpoint->attached.load(std::memory_order_acquire)) continue;
+        bool recipient = (
+          (string[0] == PJON_BROADCAST) ||
+          (string[0] == endpoint->id.load(std::memory_order_relaxed))
+        );
+        if(!recipient && !endpoint->router.load(std::memory_order_relaxed))
+          continue;
+        if(endpoint->ring.push(string, length)) result |= recipient;
+        else endpoint->dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      return result;
+    };
+
+
+    /* Get a bus by name, it is created if not existing: */
+
+    static LoopbackBus *get(const char *name) {
+      static std::mutex mutex;
+      static std::map<std::string, LoopbackBus *> buses;
+      std::lock_guard<std::mutex> lock(mutex);
+      LoopbackBus *&bus = buses[name];
+      if(!bus) bus = new LoopbackBus;
+      return bus;
+    };
+
+  private:
+    std::mutex             _mutex;
+    std::atomic<uint16_t>  _count{0};
+    LoopbackEndpoint       _endpoints[LB_MAX_DEVICES];
+};
+
+class Loopback {
+  public:
+    Loopback() { };
+
+    Loopback(const Loopback &other) :
+      _bus(other._bus), _router(other._router) { };
+
+    ~Loopback() {
+      if(_endpoint) _bus->detach(_endpoint);
+    };
+
+
+    /* Returns the suggested delay related to the attempts passed as parameter: */
+
+    uint32_t back_off(uint8_t attempts) {
+      return LB_BACK_OFF_DELAY * attempts;
+    };
+
+
+    /* Begin method, to be called before transmission or reception,
+       PJON passes its device id as parameter: */
+
+    bool begin(uint8_t device_id = PJON_NOT_ASSIGNED) {
+      if(!_endpoint) _endpoint = _bus->attach(device_id);
+      else set_id(device_id);
+      if(_endpoint) _endpoint->router.store(_router);
+      return _endpoint != NULL;
+    };
+
+
+    /* Check if the channel is free for transmission */
+
+    bool can_start() {
+      return _endpoint != NULL;
+    };
+
+
+    /* Returns the maximum number of attempts for each transmission: */
+
+    static uint8_t get_max_attempts() {
+      return LB_MAX_ATTEMPTS;
+    };
+
+
+    /* Handle a collision (there are no collisions in memory): */
+
+    void handle_collision() { };
+
+
+    /* Receive a string (non blocking): */
+
+    uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+      if(!_endpoint) return PJON_FAIL;
+      uint16_t length = _endpoint->ring.pop(string, max_length);
+      return length ? length : PJON_FAIL;
+    };
+
+
+    /* Receive byte response, it is the result of the last delivery: */
+
+    uint16_t receive_response() {
+      return _last_result;
+    };
+
+
+    /* Send byte response to package transmitter
+       (empty, the acknowledgement is given on delivery) */
+
+    void send_response(uint8_t response) { };
+
+
+    /* Send a string: */
+
+    void send_string(uint8_t *string, uint16_t length) {
+      _last_result = (length && _endpoint &&
+        _bus->deliver(_endpoint, string, length)) ? PJON_ACK : PJON_FAIL;
+    };
+
+
+    /* Set the bus by name, instances attached to the same bus communicate
+       (to be called before begin): */
+
+    void set_bus(const char *name) {
+      if(_endpoint) {
+        _bus->detach(_endpoint);
+        _endpoint = NULL;
+      }
+      _bus = LoopbackBus::get(name);
+    };
+
+
+    /* Update the device id if changed after begin: */
+
+    void set_id(uint8_t id) {
+      if(_endpoint) _endpoint->id.store(id, std::memory_order_relaxed);
+    };
+
+
+    /* Receive also frames addressed to other devices (for routers): */
+
+    void set_router(bool state) {
+      _router = state;
+      if(_endpoint) _endpoint->router.store(state);
+    };
+
+
+    /* Frames addressed to this instance lost because its ring was full: */
+
+    uint32_t get_dropped() const {
+      return _endpoint ? _endpoint->dropped.load() : 0;
+    };
+
+  private:
+    LoopbackBus      *_bus = LoopbackBus::get(LB_DEFAULT_BUS);
+    LoopbackEndpoint *_endpoint = NULL;
+    uint16_t          _last_result = PJON_FAIL;
+    bool              _router = false;
+};
@@ -22,9 +22,15 @@
 #if defined(PJON_INCLUDE_AS)
   #include "AnalogSampling/AnalogSampling.h"
 #endif
+#if defined(PJON_INCLUDE_CAN)
+  #include "SocketCAN/SocketCAN.h"
+#endif
 #if defined(PJON_INCLUDE_ETCP)
   #include "EthernetTCP/EthernetTCP.h"
 #endif
+#if defined(PJON_INCLUDE_LB)
+  #include "Loopback/Loopback.h"
+#endif
 #if defined(PJON_INCLUDE_LUDP)
   #include "LocalUDP/LocalUDP.h"
 #endif
@@ -34,6 +40,15 @@
 #if defined(PJON_INCLUDE_OS)
   #include "OverSampling/OverSampling.h"
 #endif
+#if defined(PJON_INCLUDE_SHM)
+  #include "SharedMemory/SharedMemory.h"
+#endif
+#if defined(PJON_INCLUDE_SM)
+  #include "SimulatedMedium/SimulatedMedium.h"
+#endif
+#if defined(PJON_INCLUDE_UDS)
+  #include "UnixSocket/UnixSocket.h"
+#endif
 #if defined(PJON_INCLUDE_SWBB)
   #include "SoftwareBitBang/SoftwareBitBang.h"
 #endif
@@ -46,7 +61,10 @@
 #if !defined(PJON_INCLUDE_AS)   && !defined(PJON_INCLUDE_ETCP) && \
     !defined(PJON_INCLUDE_GUDP) && !defined(PJON_INCLUDE_LUDP) && \
     !defined(PJON_INCLUDE_OS)   && !defined(PJON_INCLUDE_SWBB) && \
-    !defined(PJON_INCLUDE_TS)   && !defined(PJON_INCLUDE_NONE)
+    !defined(PJON_INCLUDE_TS)   && !defined(PJON_INCLUDE_SM)   && \
+    !defined(PJON_INCLUDE_LB)   && !defined(PJON_INCLUDE_SHM)  && \
+    !defined(PJON_INCLUDE_UDS)  && !defined(PJON_INCLUDE_CAN)  && \
+    !defined(PJON_INCLUDE_NONE)
   #include "AnalogSampling/AnalogSampling.h"
   #include "OverSampling/OverSampling.h"
   #include "SoftwareBitBang/SoftwareBitBang.h"
@@ -59,3 +77,9 @@
     #include "GlobalUDP/GlobalUDP.h"
   #endif
 #endif
+
+/* SoftwareBitBang is the default strategy of PJONMaster and PJONSlave,
+   it is declared also if not included (it is defined only if used) */
+struct SWBB_Default_Timing;
+template<typename Timing> class SoftwareBitBangStrategy;
+typedef SoftwareBitBangStrategy<SWBB_Default_Timing> SoftwareBitBang;
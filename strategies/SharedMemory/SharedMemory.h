@@ -0,0 +1,522 @@
+/* SharedMemory is a Strategy for the PJON framework.
+   It connects PJON instances hosted in different processes of the same Linux
+   host through a POSIX shared memory segment (shm_open + mmap). Each bus is a
+   segment containing an endpoint for each attached instance, every endpoint
+   has a lock-free multi-producer multi-consumer ring buffer where frames
+   addressed to it are copied once by the transmitter. A futex is used to wake
+   up receivers waiting for frames, so neither polling nor sockets are needed.
+   Synchronous acknowledgement is immediate: it is obtained when the frame is
+   accepted by the ring buffer of the recipient.
+   ___________________________________________________________________________
+
+    Copyright 2010-2017 Giovanni Blu Mitolo gioscarab@gmail.com
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <PJONDefines.h>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Frames each instance can buffer (must be a power of 2): */
+#ifndef SHM_RING_SIZE
+  #define SHM_RING_SIZE        64
+#endif
+
+/* Maximum number of instances attached to the same bus: */
+#ifndef SHM_MAX_DEVICES
+  #define SHM_MAX_DEVICES      32
+#endif
+
+/* Maximum transmission attempts */
+#ifndef SHM_MAX_ATTEMPTS
+  #define SHM_MAX_ATTEMPTS     10
+#endif
+
+/* Back-off delay in microseconds (multiplied by the attempts), a frame is
+   retransmitted only if the recipient's ring buffer is full: */
+#ifndef SHM_BACK_OFF_DELAY
+  #define SHM_BACK_OFF_DELAY  100
+#endif
+
+/* Maximum time receive_string waits for a frame (microseconds): */
+#ifndef SHM_RECEIVE_TIMEOUT
+  #define SHM_RECEIVE_TIMEOUT 1000
+#endif
+
+/* Access permission of the shared memory segments: */
+#ifndef SHM_PERMISSIONS
+  #define SHM_PERMISSIONS    0666
+#endif
+
+/* Maximum time begin waits for another process to initialize the segment
+   (microseconds), a process terminated while initializing it is replaced: */
+#ifndef SHM_INIT_TIMEOUT
+  #define SHM_INIT_TIMEOUT 1000000
+#endif
+
+#define SHM_DEFAULT_BUS    "pjon"
+#define SHM_MAGIC          (uint32_t) 0x504A4F4E
+/* Layout version, segments created with different settings are refused */
+#define SHM_VERSION        (uint32_t) ( \
+  (SHM_RING_SIZE << 16) ^ (SHM_MAX_DEVICES << 8) ^ PJON_PACKET_MAX_LENGTH \
+)
+#define SHM_UNINITIALIZED  0
+#define SHM_READY          2
+
+/* Everything contained in the segment must be address free, atomics used
+   must be lock-free because they are shared among processes: */
+
+struct SharedMemorySlot {
+  std::atomic<uint32_t> sequence;
+  uint16_t              length;
+  uint8_t               content[PJON_PACKET_MAX_LENGTH];
+};
+
+/* Bounded multi-producer multi-consumer queue (D. Vyukov's algorithm) */
+
+struct SharedMemoryRing {
+  std::atomic<uint32_t> tail;
+  uint8_t               padding_tail[60];
+  std::atomic<uint32_t> head;
+  uint8_t               padding_head[60];
+  SharedMemorySlot      slots[SHM_RING_SIZE];
+
+  void initialize() {
+    tail.store(0, std::memory_order_relaxed);
+    head.store(0, std::memory_order_relaxed);
+    for(uint32_t i = 0; i < SHM_RING_SIZE; i++)
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+  };
+
+
+  /* Copy a frame in the ring, returns false if full or too long: */
+
+  bool push(const uint8_t *string, uint16_t length) {
+    if(length > PJON_PACKET_MAX_LENGTH) return false;
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    SharedMemorySlot *slot;
+    for(;;) {
+      slot = &slots[position & (SHM_RING_SIZE - 1)];
+      int32_t difference = (int32_t)(
+        slot->sequence.load(std::memory_order_acquire) - position
+      );
+      if(difference == 0) {
+        if(tail.compare_exchange_weak(
+          position, position + 1, std::memory_order_relaxed
+        )) break;
+      } else if(difference < 0) return false;
+      else position = tail.load(std::memory_order_relaxed);
+    }
+    memcpy(slot->content, string, length);
+    slot->length = length;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  };
+
+
+  /* Copy the oldest frame in string. Returns its length, 0 if empty or
+     PJON_FAIL if longer than max_length (the frame is discarded): */
+
+  uint16_t pop(uint8_t *string, uint16_t max_length) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    SharedMemorySlot *slot;
+    for(;;) {
+      slot = &slots[position & (SHM_RING_SIZE - 1)];
+      int32_t difference = (int32_t)(
+        slot->sequence.load(std::memory_order_acquire) - (position + 1)
+      );
+      if(difference == 0) {
+        if(head.compare_exchange_weak(
+          position, position + 1, std::memory_order_relaxed
+        )) break;
+      } else if(difference < 0) return 0;
+      else position = head.load(std::memory_order_relaxed);
+    }
+    uint16_t length = slot->length;
+    if(length <= max_length) memcpy(string, slot->content, length);
+    slot->sequence.store(position + SHM_RING_SIZE, std::memory_order_release);
+    return (length <= max_length) ? length : PJON_FAIL;
+  };
+};
+
+/* Processes are identified by their process id (upper 32 bits) and start
+   time (lower 32 bits), so that a process id reused by the system is not
+   confused with the process terminated: */
+
+struct SharedMemoryEndpoint {
+  std::atomic<uint64_t> owner;    // Identity of the owner, 0 if free
+  std::atomic<uint32_t> signal;   // Futex word, incremented at each push
+  std::atomic<uint32_t> waiting;  // Receivers sleeping on the futex
+  std::atomic<uint32_t> dropped;  // Frames lost because the ring was full
+  std::atomic<uint8_t>  id;
+  std::atomic<uint8_t>  router;
+  SharedMemoryRing      ring;
+};
+
+struct SharedMemoryBus {
+  std::atomic<uint32_t> state;
+  std::atomic<uint64_t> initializer; // Identity of the initializing process
+  uint32_t              magic;
+  uint32_t              version;
+  std::atomic<uint16_t> count;
+  SharedMemoryEndpoint  endpoints[SHM_MAX_DEVICES];
+};
+
+class SharedMemory {
+  public:
+    SharedMemory() { };
+
+    SharedMemory(const SharedMemory &other) :
+      _receive_timeout(other._receive_timeout), _router(other._router) {
+      strncpy(_name, other._name, sizeof(_name));
+    };
+
+    ~SharedMemory() {
+      close();
+    };
+
+
+    /* Returns the suggested delay related to the attempts passed as parameter: */
+
+    uint32_t back_off(uint8_t attempts) {
+      return SHM_BACK_OFF_DELAY * attempts;
+    };
+
+
+    /* Begin method, to be called before transmission or reception,
+       PJON passes its device id as parameter. Maps the bus segment (creating
+       it if necessary) and attaches an endpoint: */
+
+    bool begin(uint8_t device_id = PJON_NOT_ASSIGNED) {
+      if(!_bus && !open()) return false;
+      if(!_endpoint) _endpoint = attach(device_id);
+      else set_id(device_id);
+      if(_endpoint) _endpoint->router.store(_router);
+      return _endpoint != NULL;
+    };
+
+
+    /* Check if the channel is free for transmission */
+
+    bool can_start() {
+      return _endpoint != NULL;
+    };
+
+
+    /* Returns the maximum number of attempts for each transmission: */
+
+    static uint8_t get_max_attempts() {
+      return SHM_MAX_ATTEMPTS;
+    };
+
+
+    /* Handle a collision (there are no collisions in memory): */
+
+    void handle_collision() { };
+
+
+    /* Receive a string, if no frame is available waits up to the receive
+       timeout sleeping on the endpoint's futex: */
+
+    uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+      if(!_endpoint) return PJON_FAIL;
+      uint16_t length = _endpoint->ring.pop(string, max_length);
+      if(length || !_receive_timeout) return length ? length : PJON_FAIL;
+      uint32_t signal = _endpoint->signal.load(std::memory_order_acquire);
+      _endpoint->waiting.fetch_add(1);
+      /* A frame pushed after the signal was read changes its value,
+         in that case the futex returns immediately */
+      length = _endpoint->ring.pop(string, max_length);
+      if(!length) {
+        struct timespec timeout;
+        timeout.tv_sec = _receive_timeout / 1000000;
+        timeout.tv_nsec = (_receive_timeout % 1000000) * 1000;
+        futex(&_endpoint->signal, FUTEX_WAIT, signal, &timeout);
+        length = _endpoint->ring.pop(string, max_length);
+      }
+      _endpoint->waiting.fetch_sub(1);
+      return length ? length : PJON_FAIL;
+    };
+
+
+    /* Receive byte response, it is the result of the last delivery: */
+
+    uint16_t receive_response() {
+      return _last_result;
+    };
+
+
+    /* Send byte response to package transmitter
+       (empty, the acknowledgement is given on delivery) */
+
+    void send_response(uint8_t response) { };
+
+
+    /* Send a string: */
+
+    void send_string(uint8_t *string, uint16_t length) {
+      _last_result =
+        (length && _endpoint && deliver(string, length)) ? PJON_ACK : PJON_FAIL;
+    };
+
+
+    /* Set the bus name, instances attached to the same bus communicate
+       (to be called before begin). The segment is named /pjon_<name>: */
+
+    void set_bus(const char *name) {
+      close();
+      snprintf(_name, sizeof(_name), "/pjon_%s", name);
+    };
+
+
+    /* Update the device id if changed after begin: */
+
+    void set_id(uint8_t id) {
+      if(_endpoint) _endpoint->id.store(id, std::memory_order_relaxed);
+    };
+
+
+    /* Set how long receive_string waits for a frame (microseconds),
+       0 makes reception non blocking: */
+
+    void set_receive_timeout(uint32_t timeout) {
+      _receive_timeout = timeout;
+    };
+
+
+    /* Receive also frames addressed to other devices (for routers): */
+
+    void set_router(bool state) {
+      _router = state;
+      if(_endpoint) _endpoint->router.store(state);
+    };
+
+
+    /* Frames addressed to this instance lost because its ring was full: */
+
+    uint32_t get_dropped() const {
+      return _endpoint ? _endpoint->dropped.load() : 0;
+    };
+
+
+    /* Remove the segment of a bus from the system, processes which mapped it
+       keep using it, the ones starting later create a new one: */
+
+    static bool unlink(const char *name = SHM_DEFAULT_BUS) {
+      char path[NAME_MAX];
+      snprintf(path, sizeof(path), "/pjon_%s", name);
+      return shm_unlink(path) == 0;
+    };
+
+  private:
+    SharedMemoryBus      *_bus = NULL;
+    SharedMemoryEndpoint *_endpoint = NULL;
+    uint16_t              _last_result = PJON_FAIL;
+    uint32_t              _receive_timeout = SHM_RECEIVE_TIMEOUT;
+    bool                  _router = false;
+    char                  _name[NAME_MAX] = "/pjon_" SHM_DEFAULT_BUS;
+
+    static long futex(
+      std::atomic<uint32_t> *address,
+      int operation,
+      uint32_t value,
+      const struct timespec *timeout = NULL
+    ) {
+      return syscall(SYS_futex, address, operation, value, timeout, NULL, 0);
+    };
+
+
+    /* Map the segment of the bus, the first process initializes it: */
+
+    bool open() {
+      int fd = shm_open(_name, O_RDWR | O_CREAT, SHM_PERMISSIONS);
+      if(fd < 0) return false;
+      struct stat info;
+      if(
+        (fstat(fd, &info) < 0) ||
+        ((info.st_size < (off_t)sizeof(SharedMemoryBus)) &&
+          (ftruncate(fd, sizeof(SharedMemoryBus)) < 0))
+      ) {
+        ::close(fd);
+        return false;
+      }
+      void *address = mmap(
+        NULL, sizeof(SharedMemoryBus),
+        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+      );
+      ::close(fd);
+      if(address == MAP_FAILED) return false;
+      _bus = (SharedMemoryBus *)address;
+      /* A new segment is zero filled, the first process setting itself as
+         initializer initializes it, if it terminates before the segment is
+         ready another process takes its place */
+      uint64_t self = identity(getpid());
+      struct timespec start;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      while(_bus->state.load(std::memory_order_acquire) != SHM_READY) {
+        uint64_t initializer = _bus->initializer.load();
+        if(
+          (!initializer || !alive(initializer)) &&
+          _bus->initializer.compare_exchange_strong(initializer, self)
+        ) {
+          _bus->magic = SHM_MAGIC;
+          _bus->version = SHM_VERSION;
+          _bus->count.store(0);
+          for(uint16_t i = 0; i < SHM_MAX_DEVICES; i++) {
+            _bus->endpoints[i].owner.store(0);
+            _bus->endpoints[i].ring.initialize();
+          }
+          _bus->state.store(SHM_READY, std::memory_order_release);
+          break;
+        }
+        if(elapsed(start) >= SHM_INIT_TIMEOUT) {
+          close();
+          return false;
+        }
+        usleep(100);
+      }
+      if((_bus->magic != SHM_MAGIC) || (_bus->version != SHM_VERSION)) {
+        close();
+        return false;
+      }
+      return true;
+    };
+
+
+    void close() {
+      if(_endpoint) {
+        _endpoint->owner.store(0, std::memory_order_release);
+        _endpoint = NULL;
+      }
+      if(_bus) {
+        munmap(_bus, sizeof(SharedMemoryBus));
+        _bus = NULL;
+      }
+    };
+
+
+    /* Reserve a free endpoint, also the ones of terminated processes are
+       reclaimed. Returns NULL if SHM_MAX_DEVICES are attached: */
+
+    SharedMemoryEndpoint *attach(uint8_t id) {
+      uint64_t self = identity(getpid());
+      for(uint16_t i = 0; i < SHM_MAX_DEVICES; i++) {
+        SharedMemoryEndpoint *endpoint = &_bus->endpoints[i];
+        uint64_t owner = endpoint->owner.load(std::memory_order_acquire);
+        if(owner && alive(owner)) continue;
+        if(!endpoint->owner.compare_exchange_strong(owner, self)) continue;
+        uint8_t buffer[PJON_PACKET_MAX_LENGTH];
+        // Discard what was addressed to the previous owner
+        while(endpoint->ring.pop(buffer, sizeof(buffer)));
+        endpoint->id.store(id, std::memory_order_relaxed);
+        endpoint->router.store(false, std::memory_order_relaxed);
+        endpoint->dropped.store(0, std::memory_order_relaxed);
+        uint16_t count = _bus->count.load();
+        while(
+          (count < i + 1) && !_bus->count.compare_exchange_weak(count, i + 1)
+        );
+        return endpoint;
+      }
+      return NULL;
+    };
+
+
+    /* Identity of a process: process id and start time, the start time is 0
+       if not readable from /proc: */
+
+    static uint64_t identity(int32_t pid) {
+      return ((uint64_t)(uint32_t)pid << 32) | start_time(pid);
+    };
+
+
+    /* Check if the process identified is running, a process with the same
+       process id started at a different time is a different one: */
+
+    static bool alive(uint64_t owner) {
+      int32_t pid = (int32_t)(owner >> 32);
+      if(pid == getpid()) return true;
+      if((kill(pid, 0) != 0) && (errno == ESRCH)) return false;
+      return start_time(pid) == (uint32_t)owner;
+    };
+
+
+    /* Start time of a process in clock ticks since boot (22nd field of
+       /proc/<pid>/stat), 0 if not readable: */
+
+    static uint32_t start_time(int32_t pid) {
+      char path[32], content[1024];
+      snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+      int fd = ::open(path, O_RDONLY);
+      if(fd < 0) return 0;
+      ssize_t length = read(fd, content, sizeof(content) - 1);
+      ::close(fd);
+      if(length <= 0) return 0;
+      content[length] = 0;
+      /* The process name (2nd field) is in parentheses and may contain
+         spaces, the fields are counted after its end */
+      char *field = strrchr(content, ')');
+      for(uint8_t i = 2; field && (i < 22); i++)
+        field = strchr(field + 1, ' ');
+      return field ? (uint32_t)strtoull(field + 1, NULL, 10) : 0;
+    };
+
+
+    static uint32_t elapsed(const struct timespec &start) {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      return (now.tv_sec - start.tv_sec) * 1000000 +
+        (now.tv_nsec - start.tv_nsec) / 1000;
+    };
+
+
+    /* Deliver a frame to the instances it is addressed to (and to routers),
+       returns true if accepted by at least one of its recipients: */
+
+    bool deliver(const uint8_t *string, uint16_t length) {
+      bool result = false;
+      uint16_t count = _bus->count.load(std::memory_order_acquire);
+      for(uint16_t i = 0; i < count; i++) {
+        SharedMemoryEndpoint *endpoint = &_bus->endpoints[i];
+        if(endpoint == _endpoint) continue;
+        if(!endpoint->owner.load(std::memory_order_acquire)) continue;
+        bool recipient = (
+          (string[0] == PJON_BROADCAST) ||
+          (string[0] == endpoint->id.load(std::memory_order_relaxed))
+        );
+        if(!recipient && !endpoint->router.load(std::memory_order_relaxed))
+          continue;
+        if(endpoint->ring.push(string, length)) {
+          result |= recipient;
+          endpoint->signal.fetch_add(1);
+          /* The system call is executed only if someone is sleeping */
+          if(endpoint->waiting.load())
+            futex(&endpoint->signal, FUTEX_WAKE, INT_MAX);
+        } else endpoint->dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+      return result;
+    };
+};
@@ -0,0 +1,464 @@
+/* SimulatedMedium is a Strategy for the PJON framework.
+   It simulates a shared medium (a bus where every frame reaches every device)
+   with configurable transfer speed, propagation delay, bit error rate and
+   collision model. It must be used with the PJON simulator interface (see
+   interfaces/SIMULATOR) to run many PJON instances in a single Linux process
+   using a virtual time base. It is used to evaluate collision rate, back-off
+   and throughput of a bus with many devices without physical hardware.
+   ___________________________________________________________________________
+
+    Copyright 2010-2017 Giovanni Blu Mitolo gioscarab@gmail.com
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <PJONDefines.h>
+#include <deque>
+#include <vector>
+
+/* Transfer speed in bits per second (SoftwareBitBang mode 1 default): */
+#ifndef SM_BIT_RATE
+  #define SM_BIT_RATE          16949
+#endif
+
+/* Bits transmitted for each byte (data bits + synchronization/padding): */
+#ifndef SM_BITS_PER_BYTE
+  #define SM_BITS_PER_BYTE        10
+#endif
+
+/* Propagation delay in microseconds: */
+#ifndef SM_PROPAGATION_DELAY
+  #define SM_PROPAGATION_DELAY     1
+#endif
+
+/* Synchronous acknowledgement response timeout in microseconds: */
+#ifndef SM_RESPONSE_TIMEOUT
+  #define SM_RESPONSE_TIMEOUT   1500
+#endif
+
+/* Maximum delay in case of collision in microseconds: */
+#ifndef SM_COLLISION_DELAY
+  #define SM_COLLISION_DELAY      16
+#endif
+
+/* Maximum transmission attempts */
+#ifndef SM_MAX_ATTEMPTS
+  #define SM_MAX_ATTEMPTS         20
+#endif
+
+/* Back-off exponential degree */
+#ifndef SM_BACK_OFF_DEGREE
+  #define SM_BACK_OFF_DEGREE       4
+#endif
+
+/* Virtual time frames are kept in the medium's history (microseconds): */
+#ifndef SM_RETENTION
+  #define SM_RETENTION       1000000
+#endif
+
+/* Collision models: */
+/* Overlapping frames are all lost */
+#define SM_COLLISION_DESTRUCTIVE   0
+/* The frame started first is received, the others are lost */
+#define SM_COLLISION_CAPTURE       1
+/* Ideal medium, overlapping frames are all received */
+#define SM_COLLISION_NONE          2
+
+struct SimulatedFrame {
+  uint32_t             seq;
+  uint64_t             start;
+  uint64_t             end;
+  const void          *sender;
+  const void          *target; // Receiver of a response, NULL if a frame
+  bool                 collided;
+  std::vector<uint8_t> content;
+};
+
+class SimulatedBus {
+  public:
+    uint32_t bit_rate = SM_BIT_RATE;
+    uint8_t  bits_per_byte = SM_BITS_PER_BYTE;
+    uint32_t propagation_delay = SM_PROPAGATION_DELAY;
+    double   bit_error_rate = 0;
+    uint8_t  collision_model = SM_COLLISION_DESTRUCTIVE;
+
+    /* Statistics: */
+    uint64_t frames = 0;     // Frames transmitted (responses excluded)
+    uint64_t responses = 0;  // Responses transmitted
+    uint64_t bytes = 0;      // Bytes transmitted
+    uint64_t collisions = 0; // Frames or responses lost because of collision
+    uint64_t delivered = 0;  // Frames received by a device
+    uint64_t corrupted = 0;  // Frames received containing bit errors
+    uint64_t airtime = 0;    // Microseconds the medium has been in use
+
+
+    /* Duration of a transmission of a certain length in microseconds: */
+
+    uint32_t duration(uint16_t length) const {
+      return ((uint64_t)length * bits_per_byte * 1000000) / bit_rate;
+    };
+
+
+    /* Get a frame present in the history passing its sequence number: */
+
+    SimulatedFrame *frame(uint32_t seq) {
+      if(_log.empty() || seq < _log.front().seq || seq > _log.back().seq)
+        return NULL;
+      return &_log[seq - _log.front().seq];
+    };
+
+
+    /* Sequence number of the last frame transmitted: */
+
+    uint32_t last_seq() const {
+      return _seq;
+    };
+
+
+    /* Virtual time: */
+
+    uint64_t now() const {
+      PJON_Simulator *simulator = PJON_Simulator::active();
+      return simulator ? simulator->now() : 0;
+    };
+
+
+    /* Check if the medium is in use at the current time: */
+
+    bool busy() const {
+      uint64_t time = now();
+      for(uint32_t i = _log.size(); i > 0; i--) {
+        const SimulatedFrame &f = _log[i - 1];
+        if(f.end + propagation_delay + _longest < time) break;
+        if(
+          (f.start + propagation_delay <= time) &&
+          (f.end + propagation_delay > time)
+        ) return true;
+      }
+      return false;
+    };
+
+
+    /* Find the next frame to be received by a device. It returns its sequence
+       number or 0 if there is nothing to be received. last_seq is updated to
+       skip the frames the device will never receive: */
+
+    uint32_t next_frame(
+      const void *receiver,
+      uint32_t &last_seq,
+      uint64_t deaf_start,
+      uint64_t deaf_end
+    ) {
+      uint64_t time = now();
+      if(!_log.empty() && last_seq < _log.front().seq - 1)
+        last_seq = _log.front().seq - 1;
+      for(SimulatedFrame *f = frame(last_seq + 1); f; f = frame(f->seq + 1)) {
+        if(f->start + propagation_delay > time) break;
+        if(f->target || (f->sender == receiver)) {
+          last_seq = f->seq;
+          continue;
+        }
+        last_seq = f->seq;
+        // Half-duplex, the receiver was transmitting
+        if((f->start < deaf_end) && (deaf_start < f->end)) continue;
+        return f->seq;
+      }
+      return 0;
+    };
+
+
+    /* Find a response addressed to a device transmitted after a frame: */
+
+    uint32_t next_response(const void *receiver, uint32_t after_seq) {
+      uint64_t time = now();
+      for(SimulatedFrame *f = frame(after_seq + 1); f; f = frame(f->seq + 1))
+        if(
+          (f->target == receiver) &&
+          (f->start + propagation_delay <= time)
+        ) return f->seq;
+      return 0;
+    };
+
+
+    /* Copy a received frame applying bit errors if configured.
+       Returns its length, 0 if lost because of collision or PJON_FAIL if
+       longer than max_length: */
+
+    uint16_t read(uint32_t seq, uint8_t *string, uint16_t max_length) {
+      SimulatedFrame *f = frame(seq);
+      if(!f || f->collided) return 0;
+      if(f->content.size() > max_length) return PJON_FAIL;
+      bool errors = false;
+      for(uint16_t i = 0; i < f->content.size(); i++) {
+        string[i] = f->content[i];
+        if(bit_error_rate > 0)
+          for(uint8_t b = 0; b < 8; b++)
+            if(random_unit() < bit_error_rate) {
+              string[i] ^= (1 << b);
+              errors = true;
+            }
+      }
+      if(!f->target) delivered++;
+      if(errors) corrupted++;
+      return f->content.size();
+    };
+
+
+    /* Transmit a frame (or a response if target is not NULL) at the current
+       time, returns its sequence number: */
+
+    uint32_t transmit(
+      const void *sender,
+      const uint8_t *string,
+      uint16_t length,
+      const void *target = NULL
+    ) {
+      prune();
+      SimulatedFrame f;
+      f.seq = ++_seq;
+      f.start = now();
+      f.end = f.start + duration(length);
+      f.sender = sender;
+      f.target = target;
+      f.collided = false;
+      f.content.assign(string, string + length);
+      if((f.end - f.start) > _longest) _longest = f.end - f.start;
+      /* Check overlap with the frames transmitted by other devices */
+      if(collision_model != SM_COLLISION_NONE)
+        for(uint32_t i = _log.size(); i > 0; i--) {
+          SimulatedFrame &o = _log[i - 1];
+          if(o.end + (2 * propagation_delay) + _longest < f.start) break;
+          if(
+            (o.start < f.end + propagation_delay) &&
+            (f.start < o.end + propagation_delay)
+          ) {
+            if(!f.collided) collisions++;
+            f.collided = true;
+            if(collision_model == SM_COLLISION_CAPTURE) continue;
+            if(!o.collided) collisions++;
+            o.collided = true;
+          }
+        }
+      if(target) responses++;
+      else frames++;
+      bytes += length;
+      if(f.end > _busy_until) {
+        airtime += f.end - ((f.start > _busy_until) ? f.start : _busy_until);
+        _busy_until = f.end;
+      }
+      _log.push_back(f);
+      return f.seq;
+    };
+
+
+    /* Set the seed of the random generator used to simulate bit errors: */
+
+    void set_random_seed(uint32_t seed) {
+      _random = seed ? seed : 1;
+    };
+
+
+    /* Reset statistics: */
+
+    void reset_statistics() {
+      frames = responses = bytes = collisions = 0;
+      delivered = corrupted = airtime = 0;
+    };
+
+  private:
+    uint64_t                   _busy_until = 0;
+    std::deque<SimulatedFrame> _log;
+    uint64_t                   _longest = 0;
+    uint32_t                   _random = 2463534242;
+    uint32_t                   _seq = 0;
+
+    /* Remove frames older than SM_RETENTION from the slowest device: */
+
+    void prune() {
+      PJON_Simulator *simulator = PJON_Simulator::active();
+      if(!simulator) return;
+      uint64_t time = simulator->min_clock();
+      while(!_log.empty() && (_log.front().end + SM_RETENTION < time))
+        _log.pop_front();
+    };
+
+    /* Xorshift random generator, it does not alter PJON_RANDOM sequence: */
+
+    double random_unit() {
+      _random ^= _random << 13;
+      _random ^= _random >> 17;
+      _random ^= _random << 5;
+      return _random / 4294967296.0;
+    };
+};
+
+class SimulatedMedium {
+  public:
+    /* Returns the suggested delay related to the attempts passed as parameter: */
+
+    uint32_t back_off(uint8_t attempts) {
+      uint32_t result = attempts;
+      for(uint8_t d = 0; d < _back_off_degree; d++)
+        result *= (uint32_t)(attempts);
+      return result;
+    };
+
+
+    /* Begin method, to be called before transmission or reception:
+       (returns always true) */
+
+    bool begin(uint8_t additional_randomness = 0) {
+      _last_seq = _bus->last_seq();
+      return true;
+    };
+
+
+    /* Check if the channel is free for transmission */
+
+    bool can_start() {
+      if(_bus->busy()) return false;
+      PJON_DELAY_MICROSECONDS(PJON_RANDOM(SM_COLLISION_DELAY));
+      if(_bus->busy()) return false;
+      return true;
+    };
+
+
+    /* Returns the time in microseconds a byte occupies the medium: */
+
+    uint32_t get_byte_time() {
+      return _bus->duration(1);
+    };
+
+
+    /* Returns the maximum number of attempts for each transmission: */
+
+    uint8_t get_max_attempts() {
+      return _max_attempts;
+    };
+
+
+    /* Handle a collision: */
+
+    void handle_collision() {
+      PJON_DELAY_MICROSECONDS(PJON_RANDOM(SM_COLLISION_DELAY));
+    };
+
+
+    /* Receive a string, if a frame is being transmitted its end is awaited: */
+
+    uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+      uint32_t seq = _bus->next_frame(this, _last_seq, _tx_start, _tx_end);
+      if(!seq) {
+        PJON_DELAY_MICROSECONDS(_bus->duration(1));
+        return PJON_FAIL;
+      }
+      wait_end(seq);
+      uint16_t length = _bus->read(seq, string, max_length);
+      if(!length || length == PJON_FAIL) return PJON_FAIL;
+      _last_sender = _bus->frame(seq)->sender;
+      return length;
+    };
+
+
+    /* Receive byte response */
+
+    uint16_t receive_response() {
+      uint32_t time = PJON_MICROS();
+      uint8_t response;
+      while((uint32_t)(PJON_MICROS() - time) < SM_RESPONSE_TIMEOUT) {
+        uint32_t seq = _bus->next_response(this, _tx_seq);
+        if(seq) {
+          wait_end(seq);
+          if(_bus->read(seq, &response, 1) == 1) return response;
+          return PJON_FAIL;
+        }
+        PJON_DELAY_MICROSECONDS(_bus->duration(1) / 2);
+      }
+      return PJON_FAIL;
+    };
+
+
+    /* Send byte response to the transmitter of the last frame received: */
+
+    void send_response(uint8_t response) {
+      transmit(&response, 1, _last_sender);
+    };
+
+
+    /* Send a string: */
+
+    void send_string(uint8_t *string, uint16_t length) {
+      transmit(string, length, NULL);
+    };
+
+
+    /* Set the simulated medium used (by default all instances share one): */
+
+    void set_bus(SimulatedBus *bus) {
+      _bus = bus;
+    };
+
+
+    SimulatedBus *get_bus() {
+      return _bus;
+    };
+
+
+    /* Set back-off and attempts at runtime, to compare configurations: */
+
+    void set_back_off_degree(uint8_t degree) {
+      _back_off_degree = degree;
+    };
+
+    void set_max_attempts(uint8_t attempts) {
+      _max_attempts = attempts;
+    };
+
+
+    /* Medium shared by default: */
+
+    static SimulatedBus *default_bus() {
+      static SimulatedBus bus;
+      return &bus;
+    };
+
+  private:
+    SimulatedBus *_bus = default_bus();
+    uint8_t       _back_off_degree = SM_BACK_OFF_DEGREE;
+    const void   *_last_sender = NULL;
+    uint32_t      _last_seq = 0;
+    uint8_t       _max_attempts = SM_MAX_ATTEMPTS;
+    uint64_t      _tx_end = 0;
+    uint32_t      _tx_seq = 0;
+    uint64_t      _tx_start = 0;
+
+    /* Transmit occupying the medium for the whole frame duration: */
+
+    void transmit(const uint8_t *string, uint16_t length, const void *target) {
+      _tx_seq = _bus->transmit(this, string, length, target);
+      SimulatedFrame *f = _bus->frame(_tx_seq);
+      _tx_start = f->start;
+      _tx_end = f->end;
+      PJON_DELAY_MICROSECONDS(f->end - f->start);
+    };
+
+    /* Wait until the frame is completely received: */
+
+    void wait_end(uint32_t seq) {
+      SimulatedFrame *f = _bus->frame(seq);
+      uint64_t end = f->end + _bus->propagation_delay;
+      uint64_t time = _bus->now();
+      if(end > time) PJON_DELAY_MICROSECONDS(end - time);
+    };
+};
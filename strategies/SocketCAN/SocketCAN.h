@@ -0,0 +1,537 @@
+/* SocketCAN is a Strategy for the PJON framework.
+   It delivers PJON frames over CAN and CAN-FD buses using the Linux SocketCAN
+   raw socket interface (also on the vcan virtual interface). PJON frames are
+   segmented in CAN frames with an ISO-TP like protocol control information
+   (single, first and consecutive frames, without flow control). Each CAN
+   frame has a 29 bits identifier containing the PJON ids of the transmitter
+   and of the recipient, so concurrent transmissions are resolved by CAN
+   arbitration (lower ids win) and no software collision back-off is needed.
+   Devices without an id use a random tag in place of the id, so that their
+   identifiers differ.
+   The kernel filters frames not addressed to the device. CAN frames are
+   transmitted and received in batches with sendmmsg and recvmmsg.
+   ___________________________________________________________________________
+
+    Copyright 2010-2017 Giovanni Blu Mitolo gioscarab@gmail.com
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <PJONDefines.h>
+#include <errno.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Base of the CAN identifiers used by PJON (11 bits), it lets PJON share the
+   bus with other CAN traffic: */
+#ifndef CAN_BASE_ID
+  #define CAN_BASE_ID         0x504
+#endif
+
+/* CAN frames transmitted or received with a single system call: */
+#ifndef CAN_BATCH
+  #define CAN_BATCH              16
+#endif
+
+/* PJON frames from different transmitters reassembled at the same time: */
+#ifndef CAN_MAX_SENDERS
+  #define CAN_MAX_SENDERS         4
+#endif
+
+/* Complete PJON frames buffered while waiting for a response: */
+#ifndef CAN_RX_FRAMES
+  #define CAN_RX_FRAMES           4
+#endif
+
+/* Maximum transmission attempts */
+#ifndef CAN_MAX_ATTEMPTS
+  #define CAN_MAX_ATTEMPTS       10
+#endif
+
+/* Back-off delay in microseconds (multiplied by the attempts), collisions
+   are resolved by CAN arbitration, retransmission occurs only if the
+   recipient did not acknowledge: */
+#ifndef CAN_BACK_OFF_DELAY
+  #define CAN_BACK_OFF_DELAY   1000
+#endif
+
+/* Maximum time receive_string waits for a frame (microseconds): */
+#ifndef CAN_RECEIVE_TIMEOUT
+  #define CAN_RECEIVE_TIMEOUT  1000
+#endif
+
+/* Maximum time to wait for the recipient's response (microseconds): */
+#ifndef CAN_RESPONSE_TIMEOUT
+  #define CAN_RESPONSE_TIMEOUT 10000
+#endif
+
+#define CAN_DEFAULT_INTERFACE "vcan0"
+
+/* CAN identifier: base (bits 28-18), anonymous (bit 17), type (bit 16),
+   sender id (bits 15-8), recipient id (bits 7-0). Responses have type 0, so
+   they win arbitration against data frames. A device without an id
+   (PJON_NOT_ASSIGNED) uses a random tag in place of its id and sets the
+   anonymous bit: in data frames the sender is anonymous, in responses the
+   recipient. Addresses are passed with the anonymous bit in bit 8: */
+#define CAN_TYPE_RESPONSE     0
+#define CAN_TYPE_DATA         1
+#define CAN_ANONYMOUS         0x100
+#define CAN_ID(type, sender, receiver) (CAN_EFF_FLAG | \
+  ((uint32_t)CAN_BASE_ID << 18) | \
+  ((uint32_t)(((sender) | (receiver)) & CAN_ANONYMOUS) << 9) | \
+  ((uint32_t)(type) << 16) | ((uint32_t)((sender) & 0xFF) << 8) | \
+  ((receiver) & 0xFF))
+
+/* ISO-TP like protocol control information (high nibble of the first byte) */
+#define CAN_SINGLE_FRAME      0x00
+#define CAN_FIRST_FRAME       0x10
+#define CAN_CONSECUTIVE_FRAME 0x20
+#define CAN_MAX_FRAME_LENGTH  0xFFF
+
+struct SocketCANReassembly {
+  uint16_t sender = PJON_NOT_ASSIGNED;
+  bool     active = false;
+  uint8_t  sequence = 0;
+  uint16_t length = 0;
+  uint16_t received = 0;
+  uint32_t time = 0;
+  uint8_t  content[PJON_PACKET_MAX_LENGTH];
+};
+
+struct SocketCANFrame {
+  uint16_t sender;
+  uint16_t length;
+  uint8_t  content[PJON_PACKET_MAX_LENGTH];
+};
+
+class SocketCAN {
+  public:
+    SocketCAN() { };
+
+    SocketCAN(const SocketCAN &other) :
+      _fd_frames(other._fd_frames), _router(other._router) {
+      strncpy(_interface, other._interface, sizeof(_interface));
+    };
+
+    ~SocketCAN() {
+      if(_socket >= 0 && _owned) close(_socket);
+    };
+
+
+    /* Returns the suggested delay related to the attempts passed as parameter: */
+
+    uint32_t back_off(uint8_t attempts) {
+      return CAN_BACK_OFF_DELAY * attempts;
+    };
+
+
+    /* Begin method, to be called before transmission or reception,
+       PJON passes its device id as parameter. Opens the raw socket bound to
+       the interface and sets the kernel filters: */
+
+    bool begin(uint8_t device_id = PJON_NOT_ASSIGNED) {
+      _id = device_id;
+      _tag = PJON_RANDOM(255);
+      if(_socket < 0) {
+        _socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+        if(_socket < 0) return false;
+        _owned = true;
+        struct ifreq request;
+        memset(&request, 0, sizeof(request));
+        strncpy(request.ifr_name, _interface, IFNAMSIZ - 1);
+        struct sockaddr_can address;
+        memset(&address, 0, sizeof(address));
+        address.can_family = AF_CAN;
+        int fd_frames = _fd_frames;
+        if(
+          (ioctl(_socket, SIOCGIFINDEX, &request) < 0) ||
+          (_fd_frames && setsockopt(
+            _socket, SOL_CAN_RAW, CAN_RAW_FD_FRAMES,
+            &fd_frames, sizeof(fd_frames)
+          ) < 0)
+        ) return stop();
+        address.can_ifindex = request.ifr_ifindex;
+        if(bind(_socket, (struct sockaddr *)&address, sizeof(address)) < 0)
+          return stop();
+      }
+      set_filters();
+      return true;
+    };
+
+
+    /* Check if the channel is free for transmission
+       (the CAN controller waits for the bus and arbitrates): */
+
+    bool can_start() {
+      return _socket >= 0;
+    };
+
+
+    /* Returns the maximum number of attempts for each transmission: */
+
+    static uint8_t get_max_attempts() {
+      return CAN_MAX_ATTEMPTS;
+    };
+
+
+    /* Handle a collision (empty because resolved by CAN arbitration): */
+
+    void handle_collision() { };
+
+
+    /* Receive a string, waits up to the receive timeout: */
+
+    uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+      if(!_rx_count) read_frames(_receive_timeout);
+      if(!_rx_count) return PJON_FAIL;
+      SocketCANFrame &frame = _rx[_rx_head];
+      _rx_head = (_rx_head + 1) % CAN_RX_FRAMES;
+      _rx_count--;
+      if(frame.length > max_length) return PJON_FAIL;
+      memcpy(string, frame.content, frame.length);
+      _last_sender = frame.sender;
+      return frame.length;
+    };
+
+
+    /* Receive byte response sent by the last recipient: */
+
+    uint16_t receive_response() {
+      _response = PJON_FAIL;
+      uint32_t time = PJON_MICROS();
+      do {
+        read_frames(CAN_RECEIVE_TIMEOUT);
+        if(_response != PJON_FAIL) return _response;
+      } while((uint32_t)(PJON_MICROS() - time) < CAN_RESPONSE_TIMEOUT);
+      return PJON_FAIL;
+    };
+
+
+    /* Send byte response to the transmitter of the last frame received: */
+
+    void send_response(uint8_t response) {
+      struct canfd_frame frame;
+      memset(&frame, 0, sizeof(frame));
+      frame.can_id =
+        CAN_ID(CAN_TYPE_RESPONSE, address() & 0xFF, _last_sender);
+      frame.len = 1;
+      frame.data[0] = response;
+      write_frames(&frame, 1);
+    };
+
+
+    /* Send a string segmenting it in CAN frames (all transmitted with a
+       single system call): */
+
+    void send_string(uint8_t *string, uint16_t length) {
+      if(!length || (length > CAN_MAX_FRAME_LENGTH)) return;
+      _response = PJON_FAIL;
+      uint8_t payload = _fd_frames ? CANFD_MAX_DLEN : CAN_MAX_DLEN;
+      uint32_t id = CAN_ID(CAN_TYPE_DATA, address(), string[0]);
+      struct canfd_frame frames[CAN_BATCH];
+      uint16_t count = 0, done = 0;
+      uint8_t sequence = 1;
+      while(done < length) {
+        struct canfd_frame &frame = frames[count];
+        memset(&frame, 0, sizeof(frame));
+        frame.can_id = id;
+        uint8_t header;
+        if(!done && (length <= payload - 1 - (length > 7))) {
+          /* Single frame: lengths over 7 (CAN-FD) are in the second byte */
+          if(length <= 7) frame.data[0] = CAN_SINGLE_FRAME | length;
+          else frame.data[1] = length;
+          header = (length <= 7) ? 1 : 2;
+        } else if(!done) {
+          frame.data[0] = CAN_FIRST_FRAME | (length >> 8);
+          frame.data[1] = length & 0xFF;
+          header = 2;
+        } else {
+          frame.data[0] = CAN_CONSECUTIVE_FRAME | (sequence++ & 0x0F);
+          header = 1;
+        }
+        uint16_t chunk = length - done;
+        if(chunk > payload - header) chunk = payload - header;
+        memcpy(frame.data + header, string + done, chunk);
+        frame.len = data_length(header + chunk);
+        done += chunk;
+        if(++count == CAN_BATCH) {
+          if(!write_frames(frames, count)) return;
+          count = 0;
+        }
+      }
+      if(count) write_frames(frames, count);
+    };
+
+
+    /* Set the CAN interface (to be called before begin): */
+
+    void set_interface(const char *name) {
+      strncpy(_interface, name, sizeof(_interface) - 1);
+    };
+
+
+    /* Use CAN-FD frames (up to 64 bytes), all the devices of the bus must
+       use the same setting (to be called before begin): */
+
+    void set_fd_frames(bool state) {
+      _fd_frames = state;
+    };
+
+
+    /* Use an already opened and bound CAN raw socket: */
+
+    void set_socket(int socket) {
+      stop();
+      _socket = socket;
+      _owned = false;
+    };
+
+
+    /* Set how long receive_string waits for a frame (microseconds): */
+
+    void set_receive_timeout(uint32_t timeout) {
+      _receive_timeout = timeout;
+    };
+
+
+    /* Update the device id if changed after begin, the kernel filters are
+       replaced: */
+
+    void set_id(uint8_t id) {
+      _id = id;
+      if(_socket >= 0) set_filters();
+    };
+
+
+    /* Receive also frames addressed to other devices (for routers): */
+
+    void set_router(bool state) {
+      _router = state;
+      if(_socket >= 0) set_filters();
+    };
+
+
+    /* Close the socket, returns false: */
+
+    bool stop() {
+      if(_socket >= 0 && _owned) close(_socket);
+      _socket = -1;
+      return false;
+    };
+
+  private:
+    int                 _socket = -1;
+    bool                _owned = false;
+    bool                _fd_frames = false;
+    bool                _router = false;
+    char                _interface[IFNAMSIZ] = CAN_DEFAULT_INTERFACE;
+    uint8_t             _id = PJON_NOT_ASSIGNED;
+    uint8_t             _tag = 0;
+    uint16_t            _last_sender = PJON_NOT_ASSIGNED;
+    uint16_t            _response = PJON_FAIL;
+    uint32_t            _receive_timeout = CAN_RECEIVE_TIMEOUT;
+    SocketCANReassembly _reassembly[CAN_MAX_SENDERS];
+    SocketCANFrame      _rx[CAN_RX_FRAMES];
+    uint8_t             _rx_head = 0;
+    uint8_t             _rx_count = 0;
+
+    /* Address used in the CAN identifiers, the random tag with the
+       anonymous bit if the device has no id: */
+
+    uint16_t address() const {
+      return (_id == PJON_NOT_ASSIGNED) ? (CAN_ANONYMOUS | _tag) : _id;
+    };
+
+
+    /* Round up to a valid CAN-FD data length: */
+
+    static uint8_t data_length(uint8_t length) {
+      if(length <= 8) return length;
+      static const uint8_t lengths[] = { 12, 16, 20, 24, 32, 48, 64 };
+      for(uint8_t i = 0; i < sizeof(lengths); i++)
+        if(length <= lengths[i]) return lengths[i];
+      return CANFD_MAX_DLEN;
+    };
+
+
+    /* Accept data frames addressed to the device or broadcast (all frames if
+       router), from devices with or without an id, and responses addressed
+       to the device: */
+
+    void set_filters() {
+      uint32_t mask = CAN_EFF_FLAG | ((uint32_t)0x7FF << 18);
+      struct can_filter filters[3];
+      filters[0].can_id = CAN_ID(CAN_TYPE_DATA, 0, _id);
+      filters[0].can_mask = mask | (1 << 16) | 0xFF;
+      filters[1].can_id = CAN_ID(CAN_TYPE_DATA, 0, PJON_BROADCAST);
+      filters[1].can_mask = mask | (1 << 16) | 0xFF;
+      filters[2].can_id = CAN_ID(CAN_TYPE_RESPONSE, 0, address());
+      filters[2].can_mask = mask | (1 << 17) | (1 << 16) | 0xFF;
+      if(_router) {
+        filters[0].can_id = CAN_ID(CAN_TYPE_DATA, 0, 0);
+        filters[0].can_mask = mask | (1 << 16);
+      }
+      setsockopt(
+        _socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters, sizeof(filters)
+      );
+    };
+
+
+    bool write_frames(struct canfd_frame *frames, uint16_t count) {
+      if(_socket < 0) return false;
+      struct mmsghdr messages[CAN_BATCH];
+      struct iovec vectors[CAN_BATCH];
+      memset(messages, 0, sizeof(messages[0]) * count);
+      for(uint16_t i = 0; i < count; i++) {
+        vectors[i].iov_base = &frames[i];
+        vectors[i].iov_len = _fd_frames ? CANFD_MTU : CAN_MTU;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+      }
+      uint16_t done = 0;
+      while(done < count) {
+        int result = sendmmsg(_socket, messages + done, count - done, 0);
+        if(result > 0) {
+          done += result;
+          continue;
+        }
+        if((result < 0) && (errno != EAGAIN) && (errno != ENOBUFS) &&
+          (errno != EINTR)) return false;
+        /* The transmission queue is full, wait for it to be drained */
+        struct pollfd pfd = { _socket, POLLOUT, 0 };
+        if(poll(&pfd, 1, CAN_RESPONSE_TIMEOUT / 1000) <= 0) return false;
+      }
+      return true;
+    };
+
+
+    /* Read a batch of CAN frames waiting up to timeout microseconds,
+       reassembling PJON frames and collecting responses: */
+
+    void read_frames(uint32_t timeout) {
+      if(_socket < 0) return;
+      struct pollfd pfd = { _socket, POLLIN, 0 };
+      struct timespec time;
+      time.tv_sec = timeout / 1000000;
+      time.tv_nsec = (timeout % 1000000) * 1000;
+      if(ppoll(&pfd, 1, &time, NULL) <= 0) return;
+      struct canfd_frame frames[CAN_BATCH];
+      struct mmsghdr messages[CAN_BATCH];
+      struct iovec vectors[CAN_BATCH];
+      memset(messages, 0, sizeof(messages));
+      for(uint16_t i = 0; i < CAN_BATCH; i++) {
+        vectors[i].iov_base = &frames[i];
+        vectors[i].iov_len = sizeof(frames[i]);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+      }
+      int result = recvmmsg(_socket, messages, CAN_BATCH, MSG_DONTWAIT, NULL);
+      for(int i = 0; i < result; i++)
+        process_frame(frames[i], messages[i].msg_len);
+    };
+
+
+    void process_frame(const struct canfd_frame &frame, uint32_t size) {
+      if(
+        ((size != CAN_MTU) && (size != CANFD_MTU)) ||
+        !(frame.can_id & CAN_EFF_FLAG) ||
+        ((frame.can_id & CAN_EFF_MASK) >> 18) != CAN_BASE_ID ||
+        !frame.len
+      ) return;
+      uint16_t anonymous = (frame.can_id >> 9) & CAN_ANONYMOUS;
+      uint16_t sender = (frame.can_id >> 8) & 0xFF;
+      uint16_t receiver = frame.can_id & 0xFF;
+      if(!((frame.can_id >> 16) & 1)) {
+        if((receiver | anonymous) == address()) _response = frame.data[0];
+        return;
+      }
+      sender |= anonymous;
+      uint8_t type = frame.data[0] & 0xF0;
+      if(type == CAN_SINGLE_FRAME) {
+        uint8_t header = (frame.data[0] & 0x0F) ? 1 : 2;
+        uint16_t length = (header == 1) ? frame.data[0] : frame.data[1];
+        if(length + header <= frame.len)
+          complete(sender, frame.data + header, length);
+        return;
+      }
+      SocketCANReassembly *context =
+        find_context(sender, type == CAN_FIRST_FRAME);
+      if(!context) return;
+      if(type == CAN_FIRST_FRAME) {
+        context->length = ((frame.data[0] & 0x0F) << 8) | frame.data[1];
+        context->received = 0;
+        context->sequence = 1;
+        context->active = context->length <= PJON_PACKET_MAX_LENGTH;
+        append(context, frame.data + 2, frame.len - 2);
+      } else if(type == CAN_CONSECUTIVE_FRAME && context->active) {
+        /* A lost segment aborts the reassembly */
+        if((frame.data[0] & 0x0F) != (context->sequence++ & 0x0F))
+          context->active = false;
+        else append(context, frame.data + 1, frame.len - 1);
+      }
+    };
+
+
+    /* Find the reassembly context of sender, if create is true a new one is
+       assigned replacing the oldest one: */
+
+    SocketCANReassembly *find_context(uint16_t sender, bool create) {
+      SocketCANReassembly *oldest = &_reassembly[0];
+      for(uint8_t i = 0; i < CAN_MAX_SENDERS; i++) {
+        if(_reassembly[i].sender == sender) return &_reassembly[i];
+        if(
+          !_reassembly[i].active ||
+          (oldest->active && (_reassembly[i].time < oldest->time))
+        ) oldest = &_reassembly[i];
+      }
+      if(!create) return NULL;
+      oldest->sender = sender;
+      oldest->time = PJON_MICROS();
+      return oldest;
+    };
+
+
+    void append(
+      SocketCANReassembly *context,
+      const uint8_t *data,
+      uint8_t length
+    ) {
+      uint16_t missing = context->length - context->received;
+      if(length > missing) length = missing; // Remove CAN-FD padding
+      memcpy(context->content + context->received, data, length);
+      context->received += length;
+      if(context->received == context->length) {
+        context->active = false;
+        complete(context->sender, context->content, context->length);
+      }
+    };
+
+
+    void complete(uint16_t sender, const uint8_t *data, uint16_t length) {
+      if((_rx_count == CAN_RX_FRAMES) || (length > PJON_PACKET_MAX_LENGTH))
+        return;
+      SocketCANFrame &frame = _rx[(_rx_head + _rx_count) % CAN_RX_FRAMES];
+      frame.sender = sender;
+      frame.length = length;
+      memcpy(frame.content, data, length);
+      _rx_count++;
+    };
+};
@@ -43,7 +43,44 @@
 
 #include "Timing.h"
 
-class SoftwareBitBang {
+/* Timing policies: a SoftwareBitBang instance reads its mode dependent
+   timing from the policy passed as template parameter, the constants are
+   known at compile time as if they were macros. Instances using different
+   modes can coexist in the same program (i.e. a router between a mode 1
+   and a mode 3 bus): */
+
+struct SWBB_Default_Timing { // Selected with SWBB_MODE
+  static const uint16_t bit_width  = SWBB_BIT_WIDTH;
+  static const uint16_t bit_spacer = SWBB_BIT_SPACER;
+  static const uint16_t acceptance = SWBB_ACCEPTANCE;
+  static const int16_t  read_delay = SWBB_READ_DELAY;
+};
+
+template<uint8_t mode> struct SWBB_Mode_Timing;
+
+template<> struct SWBB_Mode_Timing<1> {
+  static const uint16_t bit_width  = SWBB_MODE1_BIT_WIDTH;
+  static const uint16_t bit_spacer = SWBB_MODE1_BIT_SPACER;
+  static const uint16_t acceptance = SWBB_MODE1_ACCEPTANCE;
+  static const int16_t  read_delay = SWBB_MODE1_READ_DELAY;
+};
+
+template<> struct SWBB_Mode_Timing<2> {
+  static const uint16_t bit_width  = SWBB_MODE2_BIT_WIDTH;
+  static const uint16_t bit_spacer = SWBB_MODE2_BIT_SPACER;
+  static const uint16_t acceptance = SWBB_MODE2_ACCEPTANCE;
+  static const int16_t  read_delay = SWBB_MODE2_READ_DELAY;
+};
+
+template<> struct SWBB_Mode_Timing<3> {
+  static const uint16_t bit_width  = SWBB_MODE3_BIT_WIDTH;
+  static const uint16_t bit_spacer = SWBB_MODE3_BIT_SPACER;
+  static const uint16_t acceptance = SWBB_MODE3_ACCEPTANCE;
+  static const int16_t  read_delay = SWBB_MODE3_READ_DELAY;
+};
+
+template<typename Timing = SWBB_Default_Timing>
+class SoftwareBitBangStrategy {
   public:
     /* Returns the delay related to the attempts passed as parameter: */
 
@@ -74,15 +111,15 @@ class SoftwareBitBang {
 
     bool can_start() {
       PJON_IO_MODE(_input_pin, INPUT);
-      PJON_DELAY_MICROSECONDS(SWBB_BIT_SPACER / 2);
+      PJON_DELAY_MICROSECONDS(Timing::bit_spacer / 2);
       if(PJON_IO_READ(_input_pin)) return false;
-      PJON_DELAY_MICROSECONDS((SWBB_BIT_SPACER / 2));
+      PJON_DELAY_MICROSECONDS((Timing::bit_spacer / 2));
       if(PJON_IO_READ(_input_pin)) return false;
-      PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH / 2);
+      PJON_DELAY_MICROSECONDS(Timing::bit_width / 2);
       for(uint8_t i = 0; i < 9; i++) {
         if(PJON_IO_READ(_input_pin))
           return false;
-        PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH);
+        PJON_DELAY_MICROSECONDS(Timing::bit_width);
       }
       if(PJON_IO_READ(_input_pin)) return false;
       PJON_DELAY_MICROSECONDS(PJON_RANDOM(SWBB_COLLISION_DELAY));
@@ -91,6 +128,22 @@ class SoftwareBitBang {
     };
 
 
+    /* Returns true if the transmission of the last frame was aborted
+       because of a collision: */
+
+    bool get_collision() const {
+      return _collision;
+    };
+
+
+    /* Returns the time in microseconds a byte occupies the medium
+       (synchronization pad and 8 bits): */
+
+    static uint32_t get_byte_time() {
+      return Timing::bit_spacer + ((uint32_t)Timing::bit_width * 9);
+    };
+
+
     /* Returns the maximum number of attempts for each transmission: */
 
     static uint8_t get_max_attempts() {
@@ -110,17 +163,17 @@ class SoftwareBitBang {
     uint8_t read_byte() {
       uint8_t byte_value = 0B00000000;
       /* Delay until the center of the first bit */
-      PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH / 2);
+      PJON_DELAY_MICROSECONDS(Timing::bit_width / 2);
       for(uint8_t i = 0; i < 7; i++) {
         /* Read in the center of the n one */
         byte_value += PJON_IO_READ(_input_pin) << i;
         /* Delay until the center of the next one */
-        PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH);
+        PJON_DELAY_MICROSECONDS(Timing::bit_width);
       }
       /* Read in the center of the last one */
       byte_value += PJON_IO_READ(_input_pin) << 7;
       /* Delay until the end of the bit */
-      PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH / 2);
+      PJON_DELAY_MICROSECONDS(Timing::bit_width / 2);
       return byte_value;
     };
 
@@ -139,6 +192,9 @@ class SoftwareBitBang {
       if(_output_pin != _input_pin && _output_pin != SWBB_NOT_ASSIGNED)
         PJON_IO_WRITE(_output_pin, LOW);
 
+      /* If the frame was aborted because of a collision return
+         immediately, PJON handles it and retries after the back-off */
+      if(_collision) return PJON_BUSY;
       uint16_t response = SWBB_FAIL;
       uint32_t time = PJON_MICROS();
       /* Transmitter emits a SWBB_BIT_WIDTH / 4 long bit and tries
@@ -154,7 +210,7 @@ class SoftwareBitBang {
         if(response == SWBB_FAIL) {
           PJON_IO_MODE(_output_pin, OUTPUT);
           PJON_IO_WRITE(_output_pin, HIGH);
-          PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH / 4);
+          PJON_DELAY_MICROSECONDS(Timing::bit_width / 4);
           PJON_IO_PULL_DOWN(_output_pin);
         }
       }
@@ -173,7 +229,10 @@ class SoftwareBitBang {
         // Check its timing consistency
         if(
           (uint32_t)(PJON_MICROS() - time) <
-          (((SWBB_BIT_WIDTH * 3) + (SWBB_BIT_SPACER * 3)) - SWBB_ACCEPTANCE)
+          (
+            ((Timing::bit_width * 3) + (Timing::bit_spacer * 3)) -
+            Timing::acceptance
+          )
         ) return SWBB_FAIL;
       }
       // Receive incoming bytes
@@ -201,17 +260,46 @@ class SoftwareBitBang {
     falling edge and checking if it is followed by a logic 0. If this
     pattern is recognised, reception starts, if not, interference,
     synchronization loss or simply absence of communication is
-    detected at byte level. */
+    detected at byte level. Returns false if a collision is detected. */
 
-    void send_byte(uint8_t b) {
+    bool send_byte(uint8_t b) {
       PJON_IO_WRITE(_output_pin, HIGH);
-      PJON_DELAY_MICROSECONDS(SWBB_BIT_SPACER);
+      PJON_DELAY_MICROSECONDS(Timing::bit_spacer);
       PJON_IO_WRITE(_output_pin, LOW);
-      PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH);
+      if(!send_low()) return false;
       for(uint8_t mask = 0x01; mask; mask <<= 1) {
         PJON_IO_WRITE(_output_pin, b & mask);
-        PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH);
+        if(!(b & mask)) {
+          if(!send_low()) return false;
+        } else PJON_DELAY_MICROSECONDS(Timing::bit_width);
+      }
+      return true;
+    };
+
+
+    /* Keep the line LOW for a bit, if collision detection is active the
+       line is released for a moment in the center of the bit: if someone is
+       driving it HIGH a collision occurred, the frame transmission is
+       aborted and false is returned: */
+
+    bool send_low() {
+      if(!_collision_detection || (_input_pin != _output_pin)) {
+        PJON_DELAY_MICROSECONDS(Timing::bit_width);
+        return true;
+      }
+      uint32_t time = PJON_MICROS();
+      PJON_DELAY_MICROSECONDS(Timing::bit_width / 2);
+      PJON_IO_MODE(_output_pin, INPUT);
+      if(PJON_IO_READ(_input_pin)) {
+        PJON_IO_PULL_DOWN(_output_pin);
+        _collision = true;
+        return false;
       }
+      PJON_IO_MODE(_output_pin, OUTPUT);
+      time = (uint32_t)(PJON_MICROS() - time);
+      if(time < Timing::bit_width)
+        PJON_DELAY_MICROSECONDS(Timing::bit_width - time);
+      return true;
     };
 
 
@@ -226,12 +314,12 @@ class SoftwareBitBang {
          bit and transmits response variable */
 
       while( // If initially low Wait for the next high
-        ((uint32_t)(PJON_MICROS() - time) < SWBB_BIT_WIDTH) &&
+        ((uint32_t)(PJON_MICROS() - time) < Timing::bit_width) &&
         !PJON_IO_READ(_input_pin)
       );
       time = PJON_MICROS();
       while( // If high Wait for low
-        ((uint32_t)(PJON_MICROS() - time) < (SWBB_BIT_WIDTH / 4)) &&
+        ((uint32_t)(PJON_MICROS() - time) < (Timing::bit_width / 4)) &&
         PJON_IO_READ(_input_pin)
       );
       PJON_IO_MODE(_output_pin, OUTPUT);
@@ -254,16 +342,17 @@ class SoftwareBitBang {
     Send a string: */
 
     void send_string(uint8_t *string, uint16_t length) {
+      _collision = false;
       PJON_IO_MODE(_output_pin, OUTPUT);
       // Send string init
       for(uint8_t i = 0; i < 3; i++) {
         PJON_IO_WRITE(_output_pin, HIGH);
-        PJON_DELAY_MICROSECONDS(SWBB_BIT_SPACER);
+        PJON_DELAY_MICROSECONDS(Timing::bit_spacer);
         PJON_IO_WRITE(_output_pin, LOW);
-        PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH);
+        if(!send_low()) return;
       } // Send data
       for(uint16_t b = 0; b < length; b++)
-        send_byte(string[b]);
+        if(!send_byte(string[b])) return;
       PJON_IO_PULL_DOWN(_output_pin);
     };
 
@@ -296,19 +385,19 @@ class SoftwareBitBang {
          SWBB_BIT_SPACER duration */
       while(
         PJON_IO_READ(_input_pin) &&
-        ((uint32_t)(PJON_MICROS() - time) <= SWBB_BIT_SPACER)
+        ((uint32_t)(PJON_MICROS() - time) <= Timing::bit_spacer)
       );
       /* Save how much time passed */
       time = PJON_MICROS() - time;
       /* it is for sure equal or less than SWBB_BIT_SPACER, if is more
          than ACCEPTANCE, or minimum HIGH duration, and what is coming after
          is a LOW bit probably a byte is coming so try to receive it. */
-      if(time < SWBB_ACCEPTANCE)
+      if(time < Timing::acceptance)
         return false;
       else {
-        PJON_DELAY_MICROSECONDS((SWBB_BIT_WIDTH / 2) - SWBB_READ_DELAY);
+        PJON_DELAY_MICROSECONDS((Timing::bit_width / 2) - Timing::read_delay);
         if(!PJON_IO_READ(_input_pin)) {
-          PJON_DELAY_MICROSECONDS(SWBB_BIT_WIDTH / 2);
+          PJON_DELAY_MICROSECONDS(Timing::bit_width / 2);
           return true;
         }
       }
@@ -316,6 +405,14 @@ class SoftwareBitBang {
     };
 
 
+    /* Enable or disable collision detection during transmission (only
+       available if a single pin is used): */
+
+    void set_collision_detection(bool state) {
+      _collision_detection = state;
+    };
+
+
     /* Set the communicaton pin: */
 
     void set_pin(uint8_t pin) {
@@ -335,6 +432,17 @@ class SoftwareBitBang {
     };
 
   private:
+    bool    _collision = false;
+    bool    _collision_detection = false;
     uint8_t _input_pin;
     uint8_t _output_pin;
 };
+
+/* SoftwareBitBang uses the mode selected with SWBB_MODE,
+   SoftwareBitBangMode<N> uses mode N regardless of SWBB_MODE:
+   PJON<SoftwareBitBangMode<3> > fast_bus; */
+
+typedef SoftwareBitBangStrategy<> SoftwareBitBang;
+
+template<uint8_t mode>
+using SoftwareBitBangMode = SoftwareBitBangStrategy<SWBB_Mode_Timing<mode> >;
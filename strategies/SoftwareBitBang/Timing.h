@@ -21,192 +21,170 @@
 /* ATmega88/168/328 - Arduino Duemilanove, Uno, Nano, Mini, Pro, Pro mini */
 #if defined(__AVR_ATmega88__)  || defined(__AVR_ATmega168__) || \
     defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__)
-  #if SWBB_MODE == 1
-    #if F_CPU == 16000000L
-      /* Working on pin: 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, A0, A1 */
-      #define SWBB_BIT_WIDTH   40
-      #define SWBB_BIT_SPACER 112
-      #define SWBB_ACCEPTANCE  56
-      #define SWBB_READ_DELAY   4
-    #endif
-  #endif
-  #if SWBB_MODE == 2
-    #if F_CPU == 16000000L
-      /* Working on pin: 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, A0, A1 */
-      #define SWBB_BIT_WIDTH   32
-      #define SWBB_BIT_SPACER  84
-      #define SWBB_ACCEPTANCE  52
-      #define SWBB_READ_DELAY   4
-    #endif
-  #endif
-  #if SWBB_MODE == 3
-    #if F_CPU == 16000000L
-      /* Speed: 33.472kBd or 4.184kB/s
-         Working on pin: 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, A0, A1 */
-      #define SWBB_BIT_WIDTH   19
-      #define SWBB_BIT_SPACER  68
-      #define SWBB_ACCEPTANCE  36
-      #define SWBB_READ_DELAY   8
-    #endif
+  #if F_CPU == 16000000L
+    /* Working on pin: 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, A0, A1 */
+    // Mode 1
+    #define SWBB_MODE1_BIT_WIDTH   40
+    #define SWBB_MODE1_BIT_SPACER 112
+    #define SWBB_MODE1_ACCEPTANCE  56
+    #define SWBB_MODE1_READ_DELAY   4
+    // Mode 2
+    #define SWBB_MODE2_BIT_WIDTH   32
+    #define SWBB_MODE2_BIT_SPACER  84
+    #define SWBB_MODE2_ACCEPTANCE  52
+    #define SWBB_MODE2_READ_DELAY   4
+    // Mode 3 - Speed: 33.472kBd or 4.184kB/s
+    #define SWBB_MODE3_BIT_WIDTH   19
+    #define SWBB_MODE3_BIT_SPACER  68
+    #define SWBB_MODE3_ACCEPTANCE  36
+    #define SWBB_MODE3_READ_DELAY   8
   #endif
 #endif
 
 /* ATmega16/32U4 - Arduino Leonardo/Micro --------------------------------- */
 #if defined(__AVR_ATmega16U4__) || defined(__AVR_ATmega32U4__)
-  #if SWBB_MODE == 1
-    /* Working on pin: 2, 4, 8, 12 */
-    #define SWBB_BIT_WIDTH   40
-    #define SWBB_BIT_SPACER 112
-    #define SWBB_ACCEPTANCE  56
-    #define SWBB_READ_DELAY   8
-  #endif
-  #if SWBB_MODE == 2
-    /* Working on pin: 2, 4, 8, 12 */
-    #define SWBB_BIT_WIDTH   32
-    #define SWBB_BIT_SPACER  84
-    #define SWBB_ACCEPTANCE  52
-    #define SWBB_READ_DELAY  12
-  #endif
+  /* Working on pin: 2, 4, 8, 12 */
+  // Mode 1
+  #define SWBB_MODE1_BIT_WIDTH   40
+  #define SWBB_MODE1_BIT_SPACER 112
+  #define SWBB_MODE1_ACCEPTANCE  56
+  #define SWBB_MODE1_READ_DELAY   8
+  // Mode 2
+  #define SWBB_MODE2_BIT_WIDTH   32
+  #define SWBB_MODE2_BIT_SPACER  84
+  #define SWBB_MODE2_ACCEPTANCE  52
+  #define SWBB_MODE2_READ_DELAY  12
 #endif
 
 /* ATmega1280/2560 - Arduino Mega/Mega-nano ------------------------------- */
 #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-  #if SWBB_MODE == 1
-    /* Working on pin: 3, 4, 7, 8, 9, 10, 12 */
-    #define SWBB_BIT_WIDTH   38
-    #define SWBB_BIT_SPACER 110
-    #define SWBB_ACCEPTANCE  62
-    #define SWBB_READ_DELAY  11
-  #endif
-  #if SWBB_MODE == 2
-    /* Working on pin: 3, 4, 7, 8, 9, 10, 12 */
-    #define SWBB_BIT_WIDTH   30
-    #define SWBB_BIT_SPACER  82
-    #define SWBB_ACCEPTANCE  54
-    #define SWBB_READ_DELAY  10
-  #endif
+  /* Working on pin: 3, 4, 7, 8, 9, 10, 12 */
+  // Mode 1
+  #define SWBB_MODE1_BIT_WIDTH   38
+  #define SWBB_MODE1_BIT_SPACER 110
+  #define SWBB_MODE1_ACCEPTANCE  62
+  #define SWBB_MODE1_READ_DELAY  11
+  // Mode 2
+  #define SWBB_MODE2_BIT_WIDTH   30
+  #define SWBB_MODE2_BIT_SPACER  82
+  #define SWBB_MODE2_ACCEPTANCE  54
+  #define SWBB_MODE2_READ_DELAY  10
 #endif
 
 /* ATtiny45/85 ------------------------------------------------------------ */
 #if defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
-  #if SWBB_MODE == 1
-    #if F_CPU == 16000000L
-      // Working on pin: 1, 2
-      // Fallback to default
-    #endif
-  #endif
-  #if SWBB_MODE == 2
-    #if F_CPU == 16000000L
-      // Working on pin: 1, 2
-      // Fallback to default
-    #endif
+  #if F_CPU == 16000000L
+    // Mode 1 and 2 working on pin: 1, 2
+    // Fallback to default
   #endif
 #endif
 
 /* ATtiny44/84/44A/84A ---------------------------------------------------- */
 #if defined(__AVR_ATtiny44__)  || defined(__AVR_ATtiny84__) || \
     defined(__AVR_ATtiny84A__) || defined(__AVR_ATtiny84A__)
-  #if SWBB_MODE == 1
-    #if F_CPU == 16000000L
-      // Working on pin: 0, 1, 2, 3, 4
-      // Fallback to default
-    #endif
-  #endif
-  #if SWBB_MODE == 2
-    #if F_CPU == 16000000L
-      // Working on pin: 0, 1, 2, 3, 4
-      // Fallback to default
-    #endif
+  #if F_CPU == 16000000L
+    // Mode 1 and 2 working on pin: 0, 1, 2, 3, 4
+    // Fallback to default
   #endif
 #endif
 
 /* Arduino Zero ----------------------------------------------------------- */
 #if defined(ARDUINO_SAMD_ZERO)
-  #if SWBB_MODE == 1
-  /* Added by Esben Soeltoft - 03/09/2016 */
-    #define SWBB_BIT_WIDTH   40
-    #define SWBB_BIT_SPACER 112
-    #define SWBB_ACCEPTANCE  40
-    #define SWBB_READ_DELAY   4
-  #endif
-  #if SWBB_MODE == 3
-  /* Added by Esben Soeltoft - 09/03/2016
+  /* Mode 1 added by Esben Soeltoft - 03/09/2016 */
+  #define SWBB_MODE1_BIT_WIDTH   40
+  #define SWBB_MODE1_BIT_SPACER 112
+  #define SWBB_MODE1_ACCEPTANCE  40
+  #define SWBB_MODE1_READ_DELAY   4
+  /* Mode 3 added by Esben Soeltoft - 09/03/2016
      Speed: 48000Bd or 6.00kB/s */
-    #define SWBB_BIT_WIDTH   12
-    #define SWBB_BIT_SPACER  36
-    #define SWBB_ACCEPTANCE  12
-    #define SWBB_READ_DELAY   1
-  #endif
+  #define SWBB_MODE3_BIT_WIDTH   12
+  #define SWBB_MODE3_BIT_SPACER  36
+  #define SWBB_MODE3_ACCEPTANCE  12
+  #define SWBB_MODE3_READ_DELAY   1
 #endif
 
 /* NodeMCU, generic ESP8266 ----------------------------------------------- */
 #if defined(ESP8266)
-  #if SWBB_MODE == 1
-  /* Added by github user 240974a - 09/03/2016  */
-    #if F_CPU == 80000000L
-      #define SWBB_BIT_WIDTH   44
-      #define SWBB_BIT_SPACER 110
-      #define SWBB_ACCEPTANCE  35
-      #define SWBB_READ_DELAY   4
-    #endif
+  /* Mode 1 added by github user 240974a - 09/03/2016  */
+  #if F_CPU == 80000000L
+    #define SWBB_MODE1_BIT_WIDTH   44
+    #define SWBB_MODE1_BIT_SPACER 110
+    #define SWBB_MODE1_ACCEPTANCE  35
+    #define SWBB_MODE1_READ_DELAY   4
   #endif
 #endif
 
 /* MK20DX256 - Teensy ----------------------------------------------------- */
 #if defined(__MK20DX256__)
-  #if SWBB_MODE == 1
-  /* Added by github user SticilFace - 25/04/2016  */
-    #if F_CPU == 96000000L
-      #define SWBB_BIT_WIDTH   46
-      #define SWBB_BIT_SPACER 112
-      #define SWBB_ACCEPTANCE  40
-      #define SWBB_READ_DELAY -10
-    #endif
+  /* Mode 1 added by github user SticilFace - 25/04/2016  */
+  #if F_CPU == 96000000L
+    #define SWBB_MODE1_BIT_WIDTH   46
+    #define SWBB_MODE1_BIT_SPACER 112
+    #define SWBB_MODE1_ACCEPTANCE  40
+    #define SWBB_MODE1_READ_DELAY -10
   #endif
 #endif
 
-/* Avoid error if any previous defined ------------------------------------ */
+/* Fallback to standard timing if not previously defined ----------------- */
+#ifndef SWBB_MODE1_BIT_WIDTH
+  #define SWBB_MODE1_BIT_WIDTH   40
+#endif
+#ifndef SWBB_MODE1_BIT_SPACER
+  #define SWBB_MODE1_BIT_SPACER 112
+#endif
+#ifndef SWBB_MODE1_ACCEPTANCE
+  #define SWBB_MODE1_ACCEPTANCE  56
+#endif
+#ifndef SWBB_MODE1_READ_DELAY
+  #define SWBB_MODE1_READ_DELAY   4
+#endif
+#ifndef SWBB_MODE2_BIT_WIDTH
+  #define SWBB_MODE2_BIT_WIDTH   32
+#endif
+#ifndef SWBB_MODE2_BIT_SPACER
+  #define SWBB_MODE2_BIT_SPACER  84
+#endif
+#ifndef SWBB_MODE2_ACCEPTANCE
+  #define SWBB_MODE2_ACCEPTANCE  52
+#endif
+#ifndef SWBB_MODE2_READ_DELAY
+  #define SWBB_MODE2_READ_DELAY   4
+#endif
+#ifndef SWBB_MODE3_BIT_WIDTH
+  #define SWBB_MODE3_BIT_WIDTH   19
+#endif
+#ifndef SWBB_MODE3_BIT_SPACER
+  #define SWBB_MODE3_BIT_SPACER  68
+#endif
+#ifndef SWBB_MODE3_ACCEPTANCE
+  #define SWBB_MODE3_ACCEPTANCE  36
+#endif
+#ifndef SWBB_MODE3_READ_DELAY
+  #define SWBB_MODE3_READ_DELAY   8
+#endif
+
+/* Timing of the mode selected with SWBB_MODE, used by SoftwareBitBang
+   (SWBB_BIT_WIDTH, SWBB_BIT_SPACER, SWBB_ACCEPTANCE and SWBB_READ_DELAY can
+   still be defined before inclusion to override it): */
+
 #if SWBB_MODE == 1
-  #ifndef SWBB_BIT_WIDTH
-    #define SWBB_BIT_WIDTH   40
-  #endif
-  #ifndef SWBB_BIT_SPACER
-    #define SWBB_BIT_SPACER 112
-  #endif
-  #ifndef SWBB_ACCEPTANCE
-    #define SWBB_ACCEPTANCE  56
-  #endif
-  #ifndef SWBB_READ_DELAY
-    #define SWBB_READ_DELAY   4
-  #endif
+  #define SWBB_MODE_TIMING(NAME) SWBB_MODE1_##NAME
+#elif SWBB_MODE == 2
+  #define SWBB_MODE_TIMING(NAME) SWBB_MODE2_##NAME
+#else
+  #define SWBB_MODE_TIMING(NAME) SWBB_MODE3_##NAME
 #endif
-#if SWBB_MODE == 2
-  #ifndef SWBB_BIT_WIDTH
-    #define SWBB_BIT_WIDTH   32
-  #endif
-  #ifndef SWBB_BIT_SPACER
-    #define SWBB_BIT_SPACER  84
-  #endif
-  #ifndef SWBB_ACCEPTANCE
-    #define SWBB_ACCEPTANCE  52
-  #endif
-  #ifndef SWBB_READ_DELAY
-    #define SWBB_READ_DELAY   4
-  #endif
+#ifndef SWBB_BIT_WIDTH
+  #define SWBB_BIT_WIDTH  SWBB_MODE_TIMING(BIT_WIDTH)
 #endif
-#if SWBB_MODE == 3
-  #ifndef SWBB_BIT_WIDTH
-    #define SWBB_BIT_WIDTH   19
-  #endif
-  #ifndef SWBB_BIT_SPACER
-    #define SWBB_BIT_SPACER  68
-  #endif
-  #ifndef SWBB_ACCEPTANCE
-    #define SWBB_ACCEPTANCE  36
-  #endif
-  #ifndef SWBB_READ_DELAY
-    #define SWBB_READ_DELAY   8
-  #endif
+#ifndef SWBB_BIT_SPACER
+  #define SWBB_BIT_SPACER SWBB_MODE_TIMING(BIT_SPACER)
+#endif
+#ifndef SWBB_ACCEPTANCE
+  #define SWBB_ACCEPTANCE SWBB_MODE_TIMING(ACCEPTANCE)
+#endif
+#ifndef SWBB_READ_DELAY
+  #define SWBB_READ_DELAY SWBB_MODE_TIMING(READ_DELAY)
 #endif
 
 /* Synchronous acknowledgement response timeout. (1.5 milliseconds default).
@@ -84,6 +84,15 @@ class ThroughSerial {
     };
 
 
+    /* Returns the time in microseconds a byte occupies the medium, 0 if the
+       baud rate is not set (start, 8 data and stop bits, doubled because
+       each byte may be escaped): */
+
+    uint32_t get_byte_time() {
+      return _bd ? (2 * 10 * 1000000UL) / _bd : 0;
+    };
+
+
     /* Returns the maximum number of attempts for each transmission: */
 
     static uint8_t get_max_attempts() {
@@ -239,15 +248,14 @@ class ThroughSerial {
       }
     };
 
-  #if defined(RPI)
     /* Pass baudrate to ThroughSerial
-       (needed only for RPI flush hack): */
+       (needed by get_byte_time and by the RPI flush hack): */
 
     void set_baud_rate(uint32_t baud) {
       _bd = baud;
     };
 
-
+  #if defined(RPI)
     /* Set flush timing offset in microseconds between expected and real
        serial byte transmission: */
 
@@ -275,8 +283,8 @@ class ThroughSerial {
   private:
   #if defined(RPI)
     uint16_t _flush_offset = TS_FLUSH_OFFSET;
-    uint32_t _bd;
   #endif
+    uint32_t _bd = 0;
     uint8_t  _last_byte;
     uint32_t _last_reception_time;
     uint8_t  _enable_RS485_rxe_pin = TS_NOT_ASSIGNED;
@@ -0,0 +1,414 @@
+/* UnixSocket is a Strategy for the PJON framework.
+   It delivers PJON frames between processes of the same host through AF_UNIX
+   SOCK_SEQPACKET sockets, which are reliable and preserve frame boundaries,
+   or through any pair of file descriptors (pipes, stdin / stdout), where each
+   frame is preceded by its length. The server side listens on a path and
+   accepts many local clients, acting as a hub: frames received from a client
+   are forwarded to the others, so all instances share the same bus.
+   Synchronous acknowledgement is given when the frame is accepted by the
+   operating system, no response is exchanged.
+   ___________________________________________________________________________
+
+    Copyright 2010-2017 Giovanni Blu Mitolo gioscarab@gmail.com
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License. */
+
+#pragma once
+
+#include <PJONDefines.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Maximum number of clients accepted by the server: */
+#ifndef UDS_MAX_CLIENTS
+  #define UDS_MAX_CLIENTS        16
+#endif
+
+/* Maximum transmission attempts */
+#ifndef UDS_MAX_ATTEMPTS
+  #define UDS_MAX_ATTEMPTS       10
+#endif
+
+/* Back-off delay in microseconds (multiplied by the attempts): */
+#ifndef UDS_BACK_OFF_DELAY
+  #define UDS_BACK_OFF_DELAY    100
+#endif
+
+/* Maximum time receive_string waits for a frame (microseconds): */
+#ifndef UDS_RECEIVE_TIMEOUT
+  #define UDS_RECEIVE_TIMEOUT  1000
+#endif
+
+/* Minimum delay between client connection attempts (microseconds): */
+#ifndef UDS_RECONNECT_DELAY
+  #define UDS_RECONNECT_DELAY  100000
+#endif
+
+#define UDS_DEFAULT_PATH "/tmp/pjon.sock"
+
+#define UDS_NONE   0
+#define UDS_SERVER 1
+#define UDS_CLIENT 2
+#define UDS_FDS    3
+
+struct UnixSocketLink {
+  int  read_fd = -1;
+  int  write_fd = -1;
+  bool stream = false; // Frames are preceded by their length
+};
+
+class UnixSocket {
+  public:
+    ~UnixSocket() {
+      stop();
+    };
+
+
+    /* Returns the suggested delay related to the attempts passed as parameter: */
+
+    uint32_t back_off(uint8_t attempts) {
+      return UDS_BACK_OFF_DELAY * attempts;
+    };
+
+
+    /* Begin method, to be called before transmission or reception
+       (connects to the server if set_client or no other mode is used): */
+
+    bool begin(uint8_t additional_randomness = 0) {
+      if(_mode == UDS_NONE) set_client(UDS_DEFAULT_PATH);
+      if(_mode == UDS_SERVER) return start_server();
+      if(_mode == UDS_CLIENT) return connect_client();
+      return _count > 0;
+    };
+
+
+    /* Check if the channel is free for transmission */
+
+    bool can_start() {
+      if(_mode == UDS_SERVER) accept_clients();
+      if((_mode == UDS_CLIENT) && !_count) connect_client();
+      return _count > 0;
+    };
+
+
+    /* Returns the maximum number of attempts for each transmission: */
+
+    static uint8_t get_max_attempts() {
+      return UDS_MAX_ATTEMPTS;
+    };
+
+
+    /* Handle a collision (empty because there are no collisions): */
+
+    void handle_collision() { };
+
+
+    /* Receive a string, waits up to the receive timeout. The server forwards
+       the frames received from a client to the other clients: */
+
+    uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+      if(_mode == UDS_SERVER) accept_clients();
+      if((_mode == UDS_CLIENT) && !_count) connect_client();
+      if(!_count) return PJON_FAIL;
+      struct pollfd fds[UDS_MAX_CLIENTS];
+      for(uint16_t i = 0; i < _count; i++) {
+        fds[i].fd = _links[i].read_fd;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+      }
+      struct timespec timeout;
+      timeout.tv_sec = _receive_timeout / 1000000;
+      timeout.tv_nsec = (_receive_timeout % 1000000) * 1000;
+      if(ppoll(fds, _count, &timeout, NULL) <= 0) return PJON_FAIL;
+      /* Links are served in turn to avoid starvation */
+      for(uint16_t n = 0; n < _count; n++) {
+        uint16_t i = (_next + n) % _count;
+        if(!fds[i].revents) continue;
+        _next = (i + 1) % _count;
+        int16_t length = read_frame(_links[i], string, max_length);
+        if(length < 0) {
+          close_link(i);
+          return PJON_FAIL;
+        }
+        if(!length || (length > max_length)) return PJON_FAIL;
+        if(_mode == UDS_SERVER)
+          for(uint16_t j = 0; j < _count; j++)
+            if(j != i) write_frame(_links[j], string, length);
+        return length;
+      }
+      return PJON_FAIL;
+    };
+
+
+    /* Receive byte response, it is the result of the last transmission: */
+
+    uint16_t receive_response() {
+      return _last_result;
+    };
+
+
+    /* Send byte response to package transmitter
+       (empty, the acknowledgement is given on transmission) */
+
+    void send_response(uint8_t response) { };
+
+
+    /* Send a string to all links: */
+
+    void send_string(uint8_t *string, uint16_t length) {
+      bool result = false;
+      for(uint16_t i = 0; i < _count; i++)
+        if(write_frame(_links[i], string, length)) result = true;
+      _last_result = result ? PJON_ACK : PJON_FAIL;
+    };
+
+
+    /* Listen on path accepting up to UDS_MAX_CLIENTS clients
+       (to be called before begin): */
+
+    void set_server(const char *path = UDS_DEFAULT_PATH) {
+      stop();
+      _mode = UDS_SERVER;
+      strncpy(_path, path, sizeof(_path) - 1);
+    };
+
+
+    /* Connect to the server listening on path (to be called before begin),
+       the connection is restored automatically if lost: */
+
+    void set_client(const char *path = UDS_DEFAULT_PATH) {
+      stop();
+      _mode = UDS_CLIENT;
+      strncpy(_path, path, sizeof(_path) - 1);
+    };
+
+
+    /* Use a pair of file descriptors, for example a pipe or stdin / stdout.
+       A SOCK_SEQPACKET socket keeps its frame boundaries, on other descriptors
+       each frame is preceded by its length (2 bytes, most significant first).
+       SIGPIPE is ignored to survive the termination of the other side: */
+
+    void set_fds(int read_fd, int write_fd) {
+      stop();
+      _mode = UDS_FDS;
+      signal(SIGPIPE, SIG_IGN);
+      _links[0].read_fd = read_fd;
+      _links[0].write_fd = write_fd;
+      _links[0].stream = !is_seqpacket(read_fd);
+      _count = 1;
+    };
+
+
+    /* Set how long receive_string waits for a frame (microseconds): */
+
+    void set_receive_timeout(uint32_t timeout) {
+      _receive_timeout = timeout;
+    };
+
+
+    /* Number of connected links (clients for the server), with set_fds it
+       becomes 0 if the other side closes its descriptor or an error occurs: */
+
+    uint16_t get_links() const {
+      return _count;
+    };
+
+
+    /* Close all connections (the file descriptors passed with set_fds are
+       left open): */
+
+    void stop() {
+      if(_mode != UDS_FDS)
+        while(_count) close_link(_count - 1);
+      _count = 0;
+      _stream_received = 0;
+      if(_listen_fd >= 0) {
+        close(_listen_fd);
+        _listen_fd = -1;
+        unlink(_path);
+      }
+    };
+
+  private:
+    UnixSocketLink _links[UDS_MAX_CLIENTS];
+    uint16_t       _count = 0;
+    uint16_t       _next = 0;
+    int            _listen_fd = -1;
+    uint8_t        _mode = UDS_NONE;
+    char           _path[sizeof(((struct sockaddr_un *)0)->sun_path)] = "";
+    uint16_t       _last_result = PJON_FAIL;
+    uint32_t       _receive_timeout = UDS_RECEIVE_TIMEOUT;
+    uint32_t       _last_connection = 0;
+    bool           _connected_once = false;
+    uint8_t        _stream_buffer[PJON_PACKET_MAX_LENGTH + 2];
+    uint16_t       _stream_received = 0; // Bytes of the frame read so far
+
+    static bool is_seqpacket(int fd) {
+      int type = 0;
+      socklen_t length = sizeof(type);
+      return
+        !getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) &&
+        (type == SOCK_SEQPACKET);
+    };
+
+
+    bool set_address(struct sockaddr_un &address) {
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      strncpy(address.sun_path, _path, sizeof(address.sun_path) - 1);
+      return _path[0] != 0;
+    };
+
+
+    bool start_server() {
+      if(_listen_fd >= 0) return true;
+      struct sockaddr_un address;
+      if(!set_address(address)) return false;
+      _listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+      if(_listen_fd < 0) return false;
+      unlink(_path); // Remove the socket left by a previous execution
+      if(
+        (bind(_listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0) ||
+        (listen(_listen_fd, UDS_MAX_CLIENTS) < 0)
+      ) {
+        close(_listen_fd);
+        _listen_fd = -1;
+        return false;
+      }
+      return true;
+    };
+
+
+    void accept_clients() {
+      if(_listen_fd < 0) return;
+      while(_count < UDS_MAX_CLIENTS) {
+        int fd = accept4(_listen_fd, NULL, NULL, SOCK_NONBLOCK);
+        if(fd < 0) return;
+        _links[_count].read_fd = fd;
+        _links[_count].write_fd = fd;
+        _links[_count].stream = false;
+        _count++;
+      }
+    };
+
+
+    bool connect_client() {
+      if(_count) return true;
+      if(
+        _connected_once &&
+        ((uint32_t)(PJON_MICROS() - _last_connection) < UDS_RECONNECT_DELAY)
+      ) return false;
+      _connected_once = true;
+      _last_connection = PJON_MICROS();
+      struct sockaddr_un address;
+      if(!set_address(address)) return false;
+      int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+      if(fd < 0) return false;
+      if(connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        close(fd);
+        return false;
+      }
+      _links[0].read_fd = fd;
+      _links[0].write_fd = fd;
+      _links[0].stream = false;
+      _count = 1;
+      return true;
+    };
+
+
+    void close_link(uint16_t index) {
+      if(_mode != UDS_FDS) {
+        close(_links[index].read_fd);
+        if(_links[index].write_fd != _links[index].read_fd)
+          close(_links[index].write_fd);
+      }
+      _links[index] = _links[--_count];
+      _links[_count] = UnixSocketLink();
+      _stream_received = 0;
+      if(_next >= _count) _next = 0;
+    };
+
+
+    /* Read from a stream up to length bytes of the frame in _stream_buffer,
+       waiting up to the receive timeout for each chunk. The part read is kept
+       if the timeout expires, the frame is completed by the next calls.
+       Returns false on error or end of file: */
+
+    bool read_stream(int fd, uint16_t length) {
+      while(_stream_received < length) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int ready = poll(&pfd, 1, _receive_timeout / 1000 + 1);
+        if(ready < 0) return errno == EINTR;
+        if(!ready) return true;
+        ssize_t result = read(
+          fd, _stream_buffer + _stream_received, length - _stream_received
+        );
+        if(!result) return false;
+        if(result < 0) {
+          if((errno == EAGAIN) || (errno == EINTR)) continue;
+          return false;
+        }
+        _stream_received += result;
+      }
+      return true;
+    };
+
+
+    /* Returns the frame length, a value higher than max_length if the frame
+       is discarded because too long, 0 if nothing or only a part of the frame
+       is read or -1 if the link is closed: */
+
+    int16_t read_frame(UnixSocketLink &link, uint8_t *string, uint16_t max) {
+      if(!link.stream) {
+        ssize_t result = recv(link.read_fd, string, max, MSG_TRUNC);
+        if(!result) return -1;
+        if(result < 0)
+          return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+        return (result > max) ? max + 1 : result;
+      }
+      if(!read_stream(link.read_fd, 2)) return -1;
+      if(_stream_received < 2) return 0;
+      uint16_t length = (_stream_buffer[0] << 8) | _stream_buffer[1];
+      if(length > PJON_PACKET_MAX_LENGTH) return -1; // Framing lost
+      if(!read_stream(link.read_fd, length + 2)) return -1;
+      if(_stream_received < length + 2) return 0;
+      _stream_received = 0;
+      if(length > max) return max + 1;
+      memcpy(string, _stream_buffer + 2, length);
+      return length;
+    };
+
+
+    /* Write a frame with a single system call (for pipes a write up to
+       PIPE_BUF bytes is atomic, so frames of concurrent writers do not mix): */
+
+    bool write_frame(UnixSocketLink &link, const uint8_t *string, uint16_t length) {
+      if(!link.stream)
+        return send(
+          link.write_fd, string, length, MSG_NOSIGNAL | MSG_DONTWAIT
+        ) == length;
+      uint8_t buffer[PJON_PACKET_MAX_LENGTH + 2];
+      if(length > PJON_PACKET_MAX_LENGTH) return false;
+      buffer[0] = length >> 8;
+      buffer[1] = length & 0xFF;
+      memcpy(buffer + 2, string, length);
+      return write(link.write_fd, buffer, length + 2) == length + 2;
+    };
+};
@@ -0,0 +1,54 @@
+/* A frame aborted by a collision detected while transmitting is reported as
+   PJON_BUSY and sent again, also if no response is expected. */
+
+#define PJON_INCLUDE_NONE
+#include <PJON.h>
+#include "PJON_Test.h"
+
+/* Strategy detecting a collision in the first transmissions */
+
+class Colliding {
+  public:
+    uint8_t collisions = 0;
+    uint8_t transmissions = 0;
+
+    uint32_t back_off(uint8_t attempts) { return 0; };
+    bool begin(uint8_t additional_randomness = 0) { return true; };
+    bool can_start() { return true; };
+    static uint8_t get_max_attempts() { return 5; };
+    bool get_collision() const { return _collision; };
+    void handle_collision() { };
+    uint16_t receive_string(uint8_t *string, uint16_t max_length) {
+      return PJON_FAIL;
+    };
+    uint16_t receive_response() { return _collision ? PJON_BUSY : PJON_ACK; };
+    void send_response(uint8_t response) { };
+    void send_string(uint8_t *string, uint16_t length) {
+      transmissions++;
+      _collision = collisions && collisions--;
+    };
+
+  private:
+    bool _collision = false;
+};
+
+int main() {
+  PJON<Colliding> bus(1);
+  bus.begin();
+
+  bus.strategy.collisions = 1;
+  CHECK(bus.send_packet(PJON_BROADCAST, (char *)"A", 1) == PJON_BUSY);
+  CHECK(bus.send_packet(PJON_BROADCAST, (char *)"A", 1) == PJON_ACK);
+
+  bus.strategy.collisions = 2;
+  bus.strategy.transmissions = 0;
+  CHECK(bus.send_packet_blocking(PJON_BROADCAST, "B", 1) == PJON_ACK);
+  CHECK(bus.strategy.transmissions == 3);
+
+  bus.strategy.collisions = 1;
+  bus.strategy.transmissions = 0;
+  bus.send(PJON_BROADCAST, "C", 1);
+  while(bus.update());
+  CHECK(bus.strategy.transmissions == 2);
+  return PJON_TEST_RESULT;
+};
@@ -0,0 +1,135 @@
+/* PJONMaster device table: random insertions, reservations and deletions
+   are compared with a linear scan of a reference table, the lookups of the
+   rid index must always agree with it. Rids are chosen to collide at the
+   end of the index, so clusters wrap around and deletions shift chains. */
+
+#define PJON_INCLUDE_LB
+#include <PJONMaster.h>
+#include "PJON_Test.h"
+
+PJONMaster<Loopback> master;
+uint32_t reference[PJON_MAX_DEVICES]; // Rid of each id, 0 if free
+bool used[PJON_MAX_DEVICES];          // Id in use, also without a rid
+bool active[PJON_MAX_DEVICES];        // Id added, not only reserved
+
+/* Home slot of a rid in the index, as computed by PJONMaster */
+uint16_t home(uint32_t rid) {
+  return ((uint32_t)(rid * 2654435761UL) >> 16) &
+    (PJON_RID_INDEX_LENGTH - 1);
+};
+
+uint8_t reference_lookup(uint32_t rid) {
+  if(!rid) return PJON_NOT_ASSIGNED;
+  for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
+    if(used[i] && reference[i] == rid) return i + 1;
+  return PJON_NOT_ASSIGNED;
+};
+
+uint8_t reference_first_free() {
+  for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
+    if(!used[i]) return i + 1;
+  return PJON_NOT_ASSIGNED;
+};
+
+/* Rids whose home is one of the last two or the first two slots */
+const uint8_t pool_length = 60;
+uint32_t pool[pool_length];
+
+void fill_pool() {
+  uint8_t count = 0;
+  for(uint32_t rid = 1; count < pool_length; rid++) {
+    uint16_t h = home(rid);
+    if(h >= PJON_RID_INDEX_LENGTH - 2 || h < 2) pool[count++] = rid;
+  }
+};
+
+bool check_table() {
+  uint8_t failures = pjon_test_failures;
+  for(uint8_t i = 0; i < pool_length; i++)
+    CHECK(master.get_id_from_rid(pool[i]) == reference_lookup(pool[i]));
+  for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
+    if(used[i] && reference[i])
+      CHECK(master.get_id_from_rid(reference[i]) == i + 1);
+  return failures == pjon_test_failures;
+};
+
+void add(uint8_t id, uint32_t rid) {
+  bool expected = id && (id <= PJON_MAX_DEVICES) && !used[id - 1] &&
+    (reference_lookup(rid) == PJON_NOT_ASSIGNED);
+  CHECK(master.add_id(id, rid, true) == expected);
+  if(!expected) return;
+  used[id - 1] = true;
+  active[id - 1] = true;
+  reference[id - 1] = rid;
+};
+
+void reserve(uint32_t rid) {
+  uint16_t expected = reference_first_free();
+  if(!rid || reference_lookup(rid) != PJON_NOT_ASSIGNED) expected = PJON_FAIL;
+  else if(expected == PJON_NOT_ASSIGNED) expected = PJON_DEVICES_BUFFER_FULL;
+  CHECK(master.reserve_id(rid) == expected);
+  if(expected > PJON_MAX_DEVICES) return;
+  used[expected - 1] = true;
+  reference[expected - 1] = rid;
+};
+
+void remove(uint8_t id) {
+  master.delete_id_reference(id);
+  used[id - 1] = false;
+  active[id - 1] = false;
+  reference[id - 1] = 0;
+};
+
+int main() {
+  fill_pool();
+
+  /* Deterministic chain: three rids home in the last slot occupy it and
+     wrap to the first two, a rid home in the first slot follows them.
+     Deleting the head of the chain moves the others back. */
+  uint32_t last[3], first = 0;
+  uint8_t count = 0;
+  for(uint32_t rid = 1; count < 3 || !first; rid++) {
+    if((home(rid) == PJON_RID_INDEX_LENGTH - 1) && (count < 3))
+      last[count++] = rid;
+    else if(!home(rid) && !first) first = rid;
+  }
+  add(1, last[0]);
+  add(2, last[1]);
+  add(3, last[2]);
+  add(4, first);
+  CHECK(check_table());
+  remove(1);
+  CHECK(check_table());
+  remove(3);
+  CHECK(check_table());
+  add(1, last[0]);
+  add(5, last[2]);
+  CHECK(check_table());
+  add(6, last[1]); // Duplicated rid
+  CHECK(check_table());
+  for(uint8_t id = 1; id <= PJON_MAX_DEVICES; id++) remove(id);
+  CHECK(check_table());
+
+  /* Random operations, the table is filled and emptied several times */
+  srand(1);
+  for(uint32_t step = 0; step < 200000; step++) {
+    uint32_t rid = (rand() % 8) ? pool[rand() % pool_length] : rand();
+    uint8_t id = (rand() % (PJON_MAX_DEVICES + 2));
+    switch(rand() % 4) {
+      case 0: add(id, rid); break;
+      case 1: reserve(rid); break;
+      case 2: if(id && id <= PJON_MAX_DEVICES) remove(id); break;
+      default: CHECK(master.get_id_from_rid(rid) == reference_lookup(rid));
+    }
+    if(!(step % 997) && !check_table()) {
+      printf("Mismatch at step %u\n", step);
+      break;
+    }
+  }
+
+  uint8_t count_active = 0;
+  for(uint8_t i = 0; i < PJON_MAX_DEVICES; i++)
+    if(active[i]) count_active++;
+  CHECK(master.count_active_ids() == count_active);
+  return PJON_TEST_RESULT;
+};
@@ -0,0 +1,55 @@
+/* LocalUDP instances sharing a LocalUDPHost: the device id can change after
+   begin, instances without an id are detached when destroyed and a frame
+   refused by a full queue fails without waiting for a response. */
+
+#define LUDP_HOST_QUEUE 2
+#define PJON_INCLUDE_LUDP
+#include <PJON.h>
+#include "PJON_Test.h"
+
+uint32_t received = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+int main() {
+  LocalUDPHost host;
+  host.set_port(7100 + getpid() % 1000);
+  PJON<LocalUDP> a(1), b(2);
+  a.strategy.set_host(&host);
+  b.strategy.set_host(&host);
+  b.set_receiver(receiver_function);
+  a.begin();
+  b.begin();
+
+  // Id changed after begin: the instance is moved to the new id's queue
+  CHECK(a.send_packet(2, (char *)"A", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  b.set_id(10);
+  CHECK(a.send_packet(10, (char *)"B", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 2);
+
+  // The queue of 10 is full: the frame fails without waiting a response
+  CHECK(a.send_packet(10, (char *)"C", 1) == PJON_ACK);
+  CHECK(a.send_packet(10, (char *)"D", 1) == PJON_ACK);
+  uint32_t time = PJON_MICROS();
+  CHECK(a.send_packet(10, (char *)"E", 1) == PJON_FAIL);
+  CHECK((uint32_t)(PJON_MICROS() - time) < LUDP_RESPONSE_TIMEOUT / 10);
+  CHECK(host.get_dropped(10) == 1);
+
+  // An instance without an id is attached and detached when destroyed
+  {
+    PJON<LocalUDP> c;
+    c.strategy.set_host(&host);
+    c.begin();
+    CHECK(a.send_packet(PJON_NOT_ASSIGNED, (char *)"F", 1) == PJON_ACK);
+  }
+  CHECK(a.send_packet(PJON_NOT_ASSIGNED, (char *)"G", 1) != PJON_ACK);
+  return PJON_TEST_RESULT;
+};
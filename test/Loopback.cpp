@@ -0,0 +1,62 @@
+/* Loopback delivers frames filtering them by the id and the router state of
+   the recipient: both must follow PJON::set_id and PJON::set_router also if
+   called after begin. */
+
+#define PJON_INCLUDE_LB
+#include <PJON.h>
+#include "PJON_Test.h"
+
+uint32_t received = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+int main() {
+  PJON<Loopback> a(1), b(2), c(3);
+  a.strategy.set_bus("set_id");
+  b.strategy.set_bus("set_id");
+  c.strategy.set_bus("set_id");
+  b.set_receiver(receiver_function);
+  a.begin();
+  b.begin();
+  c.begin();
+
+  // Sent to the id set at begin
+  CHECK(a.send_packet(2, (char *)"A", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 1);
+
+  // Id changed after begin: the old one is not received any more
+  b.set_id(10);
+  CHECK(a.send_packet(2, (char *)"B", 1) == PJON_FAIL);
+  CHECK(a.send_packet(10, (char *)"C", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 2);
+  CHECK(b.receive() == PJON_FAIL);
+
+  // Router mode set after begin: frames addressed to others are received
+  b.set_router(true);
+  CHECK(a.send_packet(3, (char *)"D", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 3);
+  CHECK(c.receive() == PJON_ACK);
+  b.set_router(false);
+  CHECK(a.send_packet(3, (char *)"E", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_FAIL);
+  CHECK(received == 3);
+
+  // send_from_id does not change the id of the transmitter
+  CHECK(a.send_from_id(7, a.bus_id, 10, a.bus_id, "F", 1) != PJON_FAIL);
+  CHECK(a.device_id() == 1);
+  while(a.update());
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 4);
+  CHECK(b.last_packet_info.sender_id == 7);
+  CHECK(b.send_packet(1, (char *)"G", 1) == PJON_ACK);
+  return PJON_TEST_RESULT;
+};
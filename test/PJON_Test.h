@@ -0,0 +1,17 @@
+/* Minimal checks for the tests run by ctest: a failed CHECK prints the
+   expression and its line, PJON_TEST_RESULT is returned by main. */
+
+#pragma once
+#include <stdio.h>
+
+static int pjon_test_failures = 0;
+
+#define CHECK(expression) \
+  do { \
+    if(!(expression)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expression); \
+      pjon_test_failures++; \
+    } \
+  } while(0)
+
+#define PJON_TEST_RESULT (pjon_test_failures ? 1 : 0)
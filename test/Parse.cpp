@@ -0,0 +1,36 @@
+/* parse fills PJON_Packet_Info from a composed packet: the length of the
+   whole packet also if extended, the recipient and the sender. */
+
+#define PJON_PACKET_MAX_LENGTH 400
+#define PJON_INCLUDE_LB
+#include <PJON.h>
+#include "PJON_Test.h"
+
+PJON<Loopback> bus(1);
+char packet[PJON_PACKET_MAX_LENGTH];
+char content[300];
+
+void check(uint16_t content_length, uint16_t header) {
+  uint8_t b_id[4] = {1, 2, 3, 4};
+  uint16_t length =
+    bus.compose_packet(2, b_id, packet, content, content_length, header);
+  CHECK(length == content_length + bus.packet_overhead(packet[1]));
+  PJON_Packet_Info info;
+  bus.parse((uint8_t *)packet, info);
+  CHECK(info.length == length);
+  CHECK(info.receiver_id == 2);
+  CHECK(info.sender_id == 1);
+  if(header & PJON_MODE_BIT)
+    CHECK(bus.bus_id_equality(info.receiver_bus_id, b_id));
+};
+
+int main() {
+  uint16_t local = PJON_TX_INFO_BIT | PJON_CRC_BIT;
+  uint16_t shared = local | PJON_MODE_BIT;
+  check(10, local);
+  check(10, shared);
+  check(300, local);  // PJON_EXT_LEN_BIT is set
+  check(300, shared);
+  CHECK(packet[1] & PJON_EXT_LEN_BIT);
+  return PJON_TEST_RESULT;
+};
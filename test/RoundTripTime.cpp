@@ -0,0 +1,58 @@
+/* Round trip time estimation of asynchronous acknowledgement: LocalUDP
+   suggests a back-off of 1 microsecond, the first packet sent to a recipient
+   without estimation must wait PJON_RTO_INITIAL before being transmitted
+   again, so its acknowledgement is sampled. */
+
+#define PJON_INCLUDE_ASYNC_ACK true
+#define PJON_INCLUDE_ASYNC_ACK_RTT true
+#define PJON_INCLUDE_LUDP
+#include <PJON.h>
+#include "PJON_Test.h"
+
+uint32_t received = 0;
+bool lost = false;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+void error_handler(uint8_t code, uint8_t data) {
+  if(code == PJON_CONNECTION_LOST) lost = true;
+};
+
+int main() {
+  LocalUDPHost host;
+  host.set_port(7100 + getpid() % 1000);
+  PJON<LocalUDP> a(1), b(2);
+  a.strategy.set_host(&host);
+  b.strategy.set_host(&host);
+  a.set_synchronous_acknowledge(false);
+  b.set_synchronous_acknowledge(false);
+  a.set_asynchronous_acknowledge(true);
+  b.set_asynchronous_acknowledge(true);
+  a.set_error(error_handler);
+  b.set_receiver(receiver_function);
+  a.begin();
+  b.begin();
+
+  CHECK(!a.rtt_estimates[0].srtt);
+  CHECK(a.send(2, "A", 1) != PJON_FAIL);
+  uint32_t time = PJON_MICROS();
+  while(a.update() && ((uint32_t)(PJON_MICROS() - time) < PJON_RTO_MAX)) {
+    b.receive();
+    b.update();
+    a.receive();
+  }
+
+  // Received once and acknowledged before being transmitted again
+  CHECK(!lost);
+  CHECK(received == 1);
+  CHECK(a.rtt_estimates[0].id == 2);
+  CHECK(a.rtt_estimates[0].srtt > 0);
+  CHECK(a.rtt_estimates[0].srtt < PJON_RTO_INITIAL);
+  return PJON_TEST_RESULT;
+};
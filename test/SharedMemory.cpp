@@ -0,0 +1,77 @@
+/* SharedMemory: the device id can change after begin, segments left
+   initializing and endpoints owned by terminated processes are recovered
+   also if their process id is reused. */
+
+#define PJON_INCLUDE_SHM
+#include <PJON.h>
+#include "PJON_Test.h"
+
+uint32_t received = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+};
+
+/* Map the segment of a bus as the strategy does */
+
+SharedMemoryBus *map(const char *name) {
+  char path[NAME_MAX];
+  snprintf(path, sizeof(path), "/pjon_%s", name);
+  int fd = shm_open(path, O_RDWR | O_CREAT, SHM_PERMISSIONS);
+  if(fd < 0) return NULL;
+  if(ftruncate(fd, sizeof(SharedMemoryBus)) < 0) return NULL;
+  void *address = mmap(
+    NULL, sizeof(SharedMemoryBus), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+  );
+  close(fd);
+  return (address == MAP_FAILED) ? NULL : (SharedMemoryBus *)address;
+};
+
+int main() {
+  char name[32];
+  snprintf(name, sizeof(name), "test_%d", getpid());
+  SharedMemory::unlink(name);
+  /* The parent process is running, with a different start time it is a
+     terminated process whose process id was reused */
+  uint64_t reused = ((uint64_t)(uint32_t)getppid() << 32) | 0x12345678;
+
+  // A segment left by a process terminated while initializing it
+  SharedMemoryBus *segment = map(name);
+  CHECK(segment != NULL);
+  if(!segment) return PJON_TEST_RESULT;
+  segment->initializer.store(reused);
+
+  PJON<SharedMemory> a(1), b(2);
+  a.strategy.set_bus(name);
+  b.strategy.set_bus(name);
+  a.strategy.set_receive_timeout(0);
+  b.strategy.set_receive_timeout(0);
+  b.set_receiver(receiver_function);
+  CHECK(a.strategy.begin(1));
+  CHECK(segment->state.load() == SHM_READY);
+
+  // An endpoint owned by a terminated process whose process id was reused
+  for(uint16_t i = 1; i < SHM_MAX_DEVICES; i++)
+    segment->endpoints[i].owner.store(reused);
+  CHECK(b.strategy.begin(2));
+  CHECK(segment->endpoints[1].owner.load() != reused);
+  a.begin();
+  b.begin();
+
+  // Id changed after begin: the old one is not received any more
+  CHECK(a.send_packet(2, (char *)"A", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  b.set_id(10);
+  CHECK(a.send_packet(2, (char *)"B", 1) == PJON_FAIL);
+  CHECK(a.send_packet(10, (char *)"C", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 2);
+
+  munmap(segment, sizeof(SharedMemoryBus));
+  SharedMemory::unlink(name);
+  return PJON_TEST_RESULT;
+};
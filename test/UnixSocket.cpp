@@ -0,0 +1,57 @@
+/* UnixSocket on a pair of pipes: a frame written in two parts is received
+   once completed, the receive timeout expiring in the middle of it does not
+   close the descriptors, the end of file does. */
+
+#define PJON_INCLUDE_UDS
+#include <PJON.h>
+#include "PJON_Test.h"
+
+uint32_t received = 0;
+uint16_t received_length = 0;
+
+void receiver_function(
+  uint8_t *payload,
+  uint16_t length,
+  const PJON_Packet_Info &packet_info
+) {
+  received++;
+  received_length = length;
+};
+
+int main() {
+  int a_to_b[2], b_to_a[2];
+  CHECK(!pipe(a_to_b) && !pipe(b_to_a));
+  PJON<UnixSocket> a(1), b(2);
+  a.strategy.set_fds(b_to_a[0], a_to_b[1]);
+  b.strategy.set_fds(a_to_b[0], b_to_a[1]);
+  b.strategy.set_receive_timeout(1000);
+  b.set_receiver(receiver_function);
+  a.begin();
+  b.begin();
+
+  // Frame preceded by its length, written in two parts
+  char frame[PJON_PACKET_MAX_LENGTH + 2];
+  uint16_t length = a.compose_packet(2, a.bus_id, frame + 2, "HELLO", 5);
+  frame[0] = length >> 8;
+  frame[1] = length & 0xFF;
+  CHECK(write(a_to_b[1], frame, 5) == 5);
+  CHECK(b.receive() == PJON_FAIL);
+  CHECK(b.strategy.get_links() == 1);
+  CHECK(write(a_to_b[1], frame + 5, length - 3) == length - 3);
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 1);
+  CHECK(received_length == 5);
+
+  // Nothing to read: the link is kept
+  CHECK(b.receive() == PJON_FAIL);
+  CHECK(b.strategy.get_links() == 1);
+  CHECK(a.send_packet(2, (char *)"B", 1) == PJON_ACK);
+  CHECK(b.receive() == PJON_ACK);
+  CHECK(received == 2);
+
+  // End of file: the link is closed
+  close(a_to_b[1]);
+  CHECK(b.receive() == PJON_FAIL);
+  CHECK(b.strategy.get_links() == 0);
+  return PJON_TEST_RESULT;
+};
@@ -0,0 +1,564 @@
+
+#pragma once
+
+/* Offline decoder of PJDLS (AnalogSampling) and PJDLR (OverSampling) captures
+   Decodes buffers of raw ADC or logic analyzer samples into PJON frames,
+   reporting for each bit how far its sampling instant is from the nearest
+   edge and how far its value is from the threshold, and for each byte the
+   duration of its synchronization pad. This shows how close a link is to
+   its timing and threshold limits without the devices involved.
+
+   Samples are compared with the threshold 16 or 64 at a time (SSE2 if
+   available) and packed in a bit mask, edges are then found scanning the
+   mask a word at a time, so idle periods cost a few instructions every 64
+   samples. Linux only, it is not meant to be used on microcontrollers. */
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+#include <PJONDefines.h>
+
+/* Maximum frame length (after byte stuffing is removed): */
+#ifndef WD_MAX_LENGTH
+  #define WD_MAX_LENGTH      1024
+#endif
+
+/* Maximum deviation of the synchronization pad from its nominal duration
+   (percentage), AnalogSampling accepts 25%: */
+#ifndef WD_PAD_TOLERANCE
+  #define WD_PAD_TOLERANCE     25
+#endif
+
+// Line codes
+#define WD_PJDLS                0 // AnalogSampling
+#define WD_PJDLR                1 // OverSampling
+
+// PJDLS frame flags
+#define WD_START              149
+#define WD_END                234
+#define WD_ESC                187
+
+#define WD_AUTO                -1 // Threshold computed from the capture
+#define WD_NOT_CHECKED         -1 // CRC not verified
+
+struct PJON_Waveform_Byte {
+  uint8_t value;        // As transmitted, flags and escapes included
+  float   pad;          // Synchronization pad duration in microseconds
+  float   margin[8];    // Microseconds from the sampling instant to an edge
+  int32_t amplitude[8]; // Distance of the sample from the threshold
+};
+
+struct PJON_Waveform_Frame {
+  double   time;     // Seconds from the start of the capture
+  double   duration; // Seconds
+  uint8_t  content[WD_MAX_LENGTH];
+  uint16_t length;
+  bool     response; // Single byte synchronous response
+  bool     complete; // Correctly initialized and terminated
+  int8_t   crc;      // 1 valid, 0 invalid or WD_NOT_CHECKED
+  float    min_margin;
+  float    mean_margin;
+  float    max_pad_error;
+  int32_t  min_amplitude;
+  const PJON_Waveform_Byte *wire;
+  uint16_t wire_length;
+};
+
+typedef void (* PJON_Waveform_Handler)(
+  const PJON_Waveform_Frame &frame,
+  void *custom_pointer
+);
+
+class PJON_WaveformDecoder {
+  public:
+    PJON_WaveformDecoder(
+      uint8_t line_code = WD_PJDLS,
+      double sample_rate = 1000000,
+      uint16_t bit_width = 750,
+      uint16_t bit_spacer = 1050
+    ) {
+      set_line_code(line_code);
+      set_sample_rate(sample_rate);
+      set_timing(bit_width, bit_spacer);
+    };
+
+    ~PJON_WaveformDecoder() {
+      delete[] _levels;
+    };
+
+
+    /* Decode a buffer of samples calling the handler for each frame found,
+       returns the number of frames: */
+
+    template<typename T>
+    uint32_t decode(const T *samples, uint64_t count) {
+      if(!count || !reserve(count)) return 0;
+      if(_threshold == WD_AUTO) {
+        T min, max;
+        range(samples, count, min, max);
+        _computed_threshold = ((int32_t)min + (int32_t)max) / 2;
+      } else _computed_threshold = _threshold;
+      threshold(samples, count, _computed_threshold, _levels);
+      _count = count;
+      return parse(samples);
+    };
+
+
+    /* Compare samples with a threshold setting a bit in levels for each
+       sample above it: */
+
+    static void threshold(
+      const uint16_t *samples,
+      uint64_t count,
+      int32_t value,
+      uint64_t *levels
+    ) {
+      uint16_t limit = (value < 0) ? 0 : (value > 65535) ? 65535 : value;
+      uint64_t i = 0;
+      if(value < 0) { // Everything is above
+        for(; i < count; i += 64)
+          levels[i / 64] = (count - i >= 64) ? ~0ULL : ((1ULL << (count - i)) - 1);
+        return;
+      }
+      #if defined(__SSE2__)
+        const __m128i bias = _mm_set1_epi16((short)0x8000);
+        const __m128i l = _mm_set1_epi16((short)(limit ^ 0x8000));
+        for(; i + 64 <= count; i += 64) {
+          uint64_t word = 0;
+          for(uint8_t j = 0; j < 64; j += 16) {
+            __m128i a = _mm_xor_si128(
+              _mm_loadu_si128((const __m128i *)(samples + i + j)), bias
+            );
+            __m128i b = _mm_xor_si128(
+              _mm_loadu_si128((const __m128i *)(samples + i + j + 8)), bias
+            );
+            word |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+              _mm_packs_epi16(_mm_cmpgt_epi16(a, l), _mm_cmpgt_epi16(b, l))
+            ) << j;
+          }
+          levels[i / 64] = word;
+        }
+      #endif
+      threshold_scalar(samples, i, count, limit, levels);
+    };
+
+    static void threshold(
+      const uint8_t *samples,
+      uint64_t count,
+      int32_t value,
+      uint64_t *levels
+    ) {
+      if(value > 255) value = 255;
+      uint64_t i = 0;
+      if(value < 0) {
+        for(; i < count; i += 64)
+          levels[i / 64] = (count - i >= 64) ? ~0ULL : ((1ULL << (count - i)) - 1);
+        return;
+      }
+      #if defined(__SSE2__)
+        const __m128i bias = _mm_set1_epi8((char)0x80);
+        const __m128i l = _mm_set1_epi8((char)(value ^ 0x80));
+        for(; i + 64 <= count; i += 64) {
+          uint64_t word = 0;
+          for(uint8_t j = 0; j < 64; j += 16) {
+            __m128i a = _mm_xor_si128(
+              _mm_loadu_si128((const __m128i *)(samples + i + j)), bias
+            );
+            word |= (uint64_t)(uint16_t)_mm_movemask_epi8(
+              _mm_cmpgt_epi8(a, l)
+            ) << j;
+          }
+          levels[i / 64] = word;
+        }
+      #endif
+      threshold_scalar(samples, i, count, (uint8_t)value, levels);
+    };
+
+
+    /* Minimum and maximum value of a buffer of samples: */
+
+    static void range(
+      const uint16_t *samples,
+      uint64_t count,
+      uint16_t &min,
+      uint16_t &max
+    ) {
+      uint64_t i = 0;
+      min = 65535;
+      max = 0;
+      #if defined(__SSE2__)
+        if(count >= 8) {
+          const __m128i bias = _mm_set1_epi16((short)0x8000);
+          __m128i lo = _mm_set1_epi16(0x7FFF), hi = _mm_set1_epi16(-32768);
+          for(; i + 8 <= count; i += 8) {
+            __m128i v = _mm_xor_si128(
+              _mm_loadu_si128((const __m128i *)(samples + i)), bias
+            );
+            lo = _mm_min_epi16(lo, v);
+            hi = _mm_max_epi16(hi, v);
+          }
+          int16_t l[8], h[8];
+          _mm_storeu_si128((__m128i *)l, lo);
+          _mm_storeu_si128((__m128i *)h, hi);
+          for(uint8_t j = 0; j < 8; j++) {
+            if((uint16_t)(l[j] ^ 0x8000) < min) min = l[j] ^ 0x8000;
+            if((uint16_t)(h[j] ^ 0x8000) > max) max = h[j] ^ 0x8000;
+          }
+        }
+      #endif
+      range_scalar(samples, i, count, min, max);
+    };
+
+    static void range(
+      const uint8_t *samples,
+      uint64_t count,
+      uint8_t &min,
+      uint8_t &max
+    ) {
+      uint64_t i = 0;
+      min = 255;
+      max = 0;
+      #if defined(__SSE2__)
+        if(count >= 16) {
+          __m128i lo = _mm_set1_epi8((char)0xFF), hi = _mm_setzero_si128();
+          for(; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+            lo = _mm_min_epu8(lo, v);
+            hi = _mm_max_epu8(hi, v);
+          }
+          uint8_t l[16], h[16];
+          _mm_storeu_si128((__m128i *)l, lo);
+          _mm_storeu_si128((__m128i *)h, hi);
+          for(uint8_t j = 0; j < 16; j++) {
+            if(l[j] < min) min = l[j];
+            if(h[j] > max) max = h[j];
+          }
+        }
+      #endif
+      range_scalar(samples, i, count, min, max);
+    };
+
+
+    /* Check header and CRC of a PJON packet: */
+
+    static bool check(const uint8_t *data, uint16_t length) {
+      if(length < 5) return false;
+      bool extended_header = data[1] & PJON_EXT_HEAD_BIT;
+      bool extended_length = data[1] & PJON_EXT_LEN_BIT;
+      uint8_t offset = 3 + extended_header + extended_length;
+      if(length <= offset + 1) return false;
+      if(PJON_crc8::compute(data, offset) != data[offset]) return false;
+      uint16_t expected = extended_length ?
+        (data[2 + extended_header] << 8) | data[3 + extended_header] :
+        data[2 + extended_header];
+      if(expected != length) return false;
+      if(data[1] & PJON_CRC_BIT)
+        return (length > offset + 4) && PJON_crc32::compare(
+          PJON_crc32::compute(data, length - 4), data + (length - 4)
+        );
+      return PJON_crc8::compute(data, length - 1) == data[length - 1];
+    };
+
+
+    /* Threshold used by the last decode: */
+
+    int32_t get_threshold() const {
+      return _computed_threshold;
+    };
+
+
+    /* Frames decoded since the instance was created: */
+
+    uint32_t get_frames() const {
+      return _frames;
+    };
+
+
+    /* Frames incomplete or with an invalid CRC: */
+
+    uint32_t get_errors() const {
+      return _errors;
+    };
+
+
+    /* Set the function called for each frame decoded: */
+
+    void set_handler(PJON_Waveform_Handler handler, void *custom_pointer = NULL) {
+      _handler = handler;
+      _custom_pointer = custom_pointer;
+    };
+
+
+    /* Set the line code (WD_PJDLS or WD_PJDLR): */
+
+    void set_line_code(uint8_t line_code) {
+      _line_code = line_code;
+    };
+
+
+    /* Set the number of samples per second of the capture: */
+
+    void set_sample_rate(double sample_rate) {
+      _samples_per_us = sample_rate / 1000000.0;
+    };
+
+
+    /* Set the threshold between LOW and HIGH (WD_AUTO to use the average of
+       the minimum and maximum value of the capture): */
+
+    void set_threshold(int32_t value = WD_AUTO) {
+      _threshold = value;
+    };
+
+
+    /* Set the bit and synchronization pad duration in microseconds: */
+
+    void set_timing(uint16_t bit_width, uint16_t bit_spacer) {
+      _bit_width = bit_width;
+      _bit_spacer = bit_spacer;
+    };
+
+  private:
+    PJON_Waveform_Byte    _wire[(WD_MAX_LENGTH * 2) + 2];
+    PJON_Waveform_Frame   _frame;
+    PJON_Waveform_Handler _handler = NULL;
+    void    *_custom_pointer = NULL;
+    uint64_t *_levels = NULL;
+    uint64_t _capacity = 0;
+    uint64_t _count = 0;
+    uint32_t _frames = 0;
+    uint32_t _errors = 0;
+    int32_t  _threshold = WD_AUTO;
+    int32_t  _computed_threshold = 0;
+    double   _samples_per_us = 1;
+    uint16_t _bit_width = 750;
+    uint16_t _bit_spacer = 1050;
+    uint8_t  _line_code = WD_PJDLS;
+
+    template<typename T>
+    static void threshold_scalar(
+      const T *samples,
+      uint64_t i,
+      uint64_t count,
+      T limit,
+      uint64_t *levels
+    ) {
+      for(; i < count; i += 64) {
+        uint64_t word = 0;
+        for(uint8_t j = 0; (j < 64) && (i + j < count); j++)
+          word |= (uint64_t)(samples[i + j] > limit) << j;
+        levels[i / 64] = word;
+      }
+    };
+
+    template<typename T>
+    static void range_scalar(
+      const T *samples,
+      uint64_t i,
+      uint64_t count,
+      T &min,
+      T &max
+    ) {
+      for(; i < count; i++) {
+        if(samples[i] < min) min = samples[i];
+        if(samples[i] > max) max = samples[i];
+      }
+    };
+
+    bool reserve(uint64_t count) {
+      uint64_t words = (count + 63) / 64;
+      if(words <= _capacity) return true;
+      delete[] _levels;
+      _levels = new uint64_t[words];
+      _capacity = _levels ? words : 0;
+      return _levels != NULL;
+    };
+
+    bool level(uint64_t i) const {
+      return (_levels[i >> 6] >> (i & 63)) & 1;
+    };
+
+    /* First sample from i on whose level is not value: */
+
+    uint64_t next_change(uint64_t i, bool value) const {
+      if(i >= _count) return _count;
+      uint64_t w = i >> 6, words = (_count + 63) / 64;
+      uint64_t word = (value ? ~_levels[w] : _levels[w]) & (~0ULL << (i & 63));
+      while(!word) {
+        if(++w >= words) return _count;
+        word = value ? ~_levels[w] : _levels[w];
+      }
+      uint64_t result = (w << 6) + __builtin_ctzll(word);
+      return (result < _count) ? result : _count;
+    };
+
+    /* First sample of the run of equal levels containing i: */
+
+    uint64_t run_start(uint64_t i) const {
+      bool value = level(i);
+      uint64_t w = i >> 6;
+      uint64_t mask = ((i & 63) == 63) ? ~0ULL : ((2ULL << (i & 63)) - 1);
+      uint64_t word = (value ? ~_levels[w] : _levels[w]) & mask;
+      while(!word) {
+        if(!w--) return 0;
+        word = value ? ~_levels[w] : _levels[w];
+      }
+      return (w << 6) + 64 - __builtin_clzll(word);
+    };
+
+    uint64_t at(double position) const {
+      return (uint64_t)(position + 0.5);
+    };
+
+    /* Look for a synchronization pad from sample i: a HIGH of bit_spacer
+       duration followed by a LOW. If anchored the pad has to start where
+       the previous byte ended, as the receiver starts to measure it there: */
+
+    bool sync(uint64_t i, bool anchored, uint64_t &fall, float &pad) const {
+      double width = _bit_width * _samples_per_us;
+      double tolerance = _bit_spacer * (WD_PAD_TOLERANCE / 100.0);
+      while(i < _count) {
+        uint64_t rise = level(i) ? i : next_change(i, false);
+        if(rise >= _count) return false;
+        if(anchored && ((rise - i) > (width / 2))) return false;
+        fall = next_change(rise, true);
+        if(fall >= _count) return false;
+        pad = (fall - rise) / _samples_per_us;
+        uint64_t check = at(fall + (width / 2));
+        if(
+          (pad >= (_bit_spacer - tolerance)) &&
+          (pad <= (_bit_spacer + tolerance)) &&
+          (check < _count) && !level(check)
+        ) return true;
+        if(anchored) return false;
+        i = fall;
+      }
+      return false;
+    };
+
+    /* Sample the 8 bits following the synchronization pad: */
+
+    template<typename T>
+    void read_byte(const T *samples, uint64_t fall, PJON_Waveform_Byte &b) {
+      double width = _bit_width * _samples_per_us;
+      b.value = 0;
+      for(uint8_t i = 0; i < 8; i++) {
+        uint64_t s = at(fall + (width * (1.5 + i)));
+        if(s >= _count) s = _count - 1;
+        bool value = level(s);
+        b.value |= value << i;
+        uint64_t before = s - run_start(s), after = next_change(s, value) - s;
+        float margin = ((before < after) ? before : after) / _samples_per_us;
+        b.margin[i] = (margin < (_bit_width / 2.0)) ? margin : _bit_width / 2.0;
+        b.amplitude[i] = value ?
+          (int32_t)samples[s] - _computed_threshold :
+          _computed_threshold - (int32_t)samples[s];
+      }
+    };
+
+    /* Decode consecutive bytes in bursts and interpret them as frames: */
+
+    template<typename T>
+    uint32_t parse(const T *samples) {
+      uint32_t frames = 0;
+      double width = _bit_width * _samples_per_us;
+      uint64_t cursor = 0, fall;
+      float pad;
+      while(sync(cursor, false, fall, pad)) {
+        uint64_t start = fall - (uint64_t)(pad * _samples_per_us);
+        uint8_t initializers = 0;
+        float max_pad_error = 0;
+        uint16_t length = 0;
+        if(_line_code == WD_PJDLR) {
+          // The string initializer is made of 3 pads followed by the first byte
+          uint64_t next;
+          float next_pad;
+          while(sync(at(fall + width), true, next, next_pad)) {
+            float error = (pad > _bit_spacer) ?
+              pad - _bit_spacer : _bit_spacer - pad;
+            if(error > max_pad_error) max_pad_error = error;
+            initializers++;
+            fall = next;
+            pad = next_pad;
+          }
+        }
+        do {
+          PJON_Waveform_Byte &b = _wire[length++];
+          b.pad = pad;
+          read_byte(samples, fall, b);
+          cursor = at(fall + (width * 9));
+        } while(
+          (length < ((WD_MAX_LENGTH * 2) + 2)) &&
+          sync(cursor, true, fall, pad)
+        );
+        _frame.time = start / (_samples_per_us * 1000000.0);
+        _frame.duration =
+          (cursor - start) / (_samples_per_us * 1000000.0);
+        _frame.max_pad_error = max_pad_error;
+        interpret(length, initializers);
+        frames++;
+        _frames++;
+        if(!_frame.complete || (_frame.crc == 0)) _errors++;
+        if(_handler) _handler(_frame, _custom_pointer);
+      }
+      return frames;
+    };
+
+    /* Remove byte stuffing (PJDLS) or the initializer (PJDLR) and compute
+       the frame statistics: */
+
+    void interpret(uint16_t length, uint8_t initializers) {
+      PJON_Waveform_Frame &f = _frame;
+      f.wire = _wire;
+      f.wire_length = length;
+      f.length = 0;
+      f.crc = WD_NOT_CHECKED;
+      f.min_margin = _bit_width;
+      f.mean_margin = 0;
+      f.min_amplitude = 0x7FFFFFFF;
+      for(uint16_t i = 0; i < length; i++) {
+        float error = (_wire[i].pad > _bit_spacer) ?
+          _wire[i].pad - _bit_spacer : _bit_spacer - _wire[i].pad;
+        if(error > f.max_pad_error) f.max_pad_error = error;
+        for(uint8_t b = 0; b < 8; b++) {
+          if(_wire[i].margin[b] < f.min_margin)
+            f.min_margin = _wire[i].margin[b];
+          if(_wire[i].amplitude[b] < f.min_amplitude)
+            f.min_amplitude = _wire[i].amplitude[b];
+          f.mean_margin += _wire[i].margin[b];
+        }
+      }
+      f.mean_margin /= length * 8;
+      if(_line_code == WD_PJDLR) {
+        f.response = !initializers && (length == 1);
+        f.complete = f.response || (initializers == 3);
+        for(uint16_t i = 0; (i < length) && (i < WD_MAX_LENGTH); i++)
+          f.content[f.length++] = _wire[i].value;
+        if(length > WD_MAX_LENGTH) f.complete = false;
+      } else {
+        f.response = (length == 1) && (_wire[0].value != WD_START);
+        f.complete = f.response;
+        if(f.response) f.content[f.length++] = _wire[0].value;
+        else if(_wire[0].value == WD_START) {
+          for(uint16_t i = 1; i < length; i++) {
+            uint8_t v = _wire[i].value;
+            if(v == WD_START) break;
+            if(v == WD_END) {
+              f.complete = (i == (length - 1));
+              break;
+            }
+            if(v == WD_ESC) {
+              if(++i == length) break;
+              v = _wire[i].value;
+              if((v != WD_START) && (v != WD_ESC) && (v != WD_END)) break;
+            }
+            if(f.length == WD_MAX_LENGTH) break;
+            f.content[f.length++] = v;
+          }
+        }
+      }
+      if(f.complete && !f.response) f.crc = check(f.content, f.length);
+    };
+};